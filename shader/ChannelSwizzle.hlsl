@@ -0,0 +1,33 @@
+struct ShaderData
+{
+    int4 Sources;
+};
+
+Texture2D BufferIn : register(t0);
+
+StructuredBuffer<ShaderData> Data : register(t1);
+
+RWTexture2D<float4> BufferOut : register(u0);
+
+// source ids of ImageTools::ChannelSwizzle::Source: R, G, B, A, Zero, One, NormalZ
+float Pick(const float4 pix, const int source)
+{
+    if (source < 4)
+        return pix[source];
+    return source == 5 ? 1. : 0.;
+}
+
+[numthreads(32, 32, 1)] void ChannelSwizzle(uint3 DTid
+                                            : SV_DispatchThreadID)
+{
+    const int4 src = Data[0].Sources;
+    const float4 pix = BufferIn[DTid.xy];
+
+    float4 res = float4(Pick(pix, src.x), Pick(pix, src.y), Pick(pix, src.z), Pick(pix, src.w));
+
+    const float2 xy = res.xy * 2. - 1.;
+    const float z = sqrt(saturate(1. - dot(xy, xy))) * .5 + .5;
+    res = src == 6 ? z : res;
+
+    BufferOut[DTid.xy] = res;
+}
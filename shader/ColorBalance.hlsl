@@ -1,29 +1,12 @@
-static const int Shadows = 0;
-static const int Midtones = 1;
-static const int Highlights = 2;
-
+// cyan-red, magenta-green, yellow-blue of each range
 struct ShaderData
 {
-    int Range;
-    precise float CyanRed;
-    precise float MagentaGreen;
-    precise float YellowBlue;
+    precise float3 Shadows;
+    precise float3 Midtones;
+    precise float3 Highlights;
     int PreserveLuminosity;
 };
 
-precise float Apply(precise const float v, precise const float l,
-                    precise float s, precise float m, precise float h)
-{
-    precise const float a = 0.25, b = 1. / 3., scale = 0.7;
-
-    s *= clamp((l - b) / -a + .5, 0., 1.) * scale;
-    m *= clamp((l - b) / a + .5, 0., 1.) * clamp((l + b - 1.) / -a + .5, 0., 1.) *
-         scale;
-    h *= clamp((l + b - 1.) / a + .5, 0., 1.) * scale;
-
-    return clamp(v + s + m + h, 0., 1.);
-}
-
 precise float Mod(precise const float lhs, precise const float rhs)
 {
     return fmod(rhs + fmod(lhs, rhs), rhs);
@@ -104,80 +87,71 @@ precise float3 HslToRgb(precise const float3 color)
 
 precise float Boole(const bool v) { return v ? 1. : 0.; }
 
+precise float3 ApplyMidtones(precise const float3 v, precise const float3 adj)
+{
+    static const float Delta = 0.0033944;
+
+    precise float3 gamma;
+    gamma[0] = exp(-Delta * adj.x + Delta * adj.y + Delta * adj.z);
+    gamma[1] = exp(+Delta * adj.x - Delta * adj.y + Delta * adj.z);
+    gamma[2] = exp(+Delta * adj.x + Delta * adj.y - Delta * adj.z);
+
+    return clamp(pow(clamp(v, 0., 1.), gamma), 0., 1.);
+}
+
+precise float3 ApplyShadows(precise const float3 v, precise const float3 adj)
+{
+    static const float Delta = 0.003923;
+
+    precise float3 gamma;
+    gamma[0] = -Delta * adj.x * Boole(adj.x < 0.) +
+               Delta * adj.y * Boole(adj.y > 0.) +
+               Delta * adj.z * Boole(adj.z > 0.);
+    gamma[1] = +Delta * adj.x * Boole(adj.x > 0.) -
+               Delta * adj.y * Boole(adj.y < 0.) +
+               Delta * adj.z * Boole(adj.z > 0.);
+    gamma[2] = +Delta * adj.x * Boole(adj.x > 0.) +
+               Delta * adj.y * Boole(adj.y > 0.) -
+               Delta * adj.z * Boole(adj.z < 0.);
+
+    return clamp((v - gamma) / (1. - gamma), 0., 1.);
+}
+
+precise float3 ApplyHighlights(precise const float3 v, precise const float3 adj)
+{
+    static const float Delta = 0.003923;
+
+    precise float3 gamma;
+    gamma[0] = +Delta * adj.x * Boole(adj.x > 0.) -
+               Delta * adj.y * Boole(adj.y < 0.) -
+               Delta * adj.z * Boole(adj.z < 0.);
+    gamma[1] = -Delta * adj.x * Boole(adj.x < 0.) +
+               Delta * adj.y * Boole(adj.y > 0.) -
+               Delta * adj.z * Boole(adj.z < 0.);
+    gamma[2] = -Delta * adj.x * Boole(adj.x < 0.) -
+               Delta * adj.y * Boole(adj.y < 0.) +
+               Delta * adj.z * Boole(adj.z > 0.);
+
+    return clamp(v / (1. - gamma), 0., 1.);
+}
+
 Texture2D BufferIn : register(t0);
 StructuredBuffer<ShaderData> Data : register(t1);
 
 RWTexture2D<float4> BufferOut : register(u0);
 
+// all three ranges in one pass, in the same order as ImageTools::ColorBalance
 [numthreads(32, 32, 1)] void ColorBalance(uint3 DTid
                                           : SV_DispatchThreadID)
 {
     precise const ShaderData data = Data[0];
-    const int range = data.Range;
-    const precise float cyanRed = data.CyanRed;
-    const precise float magentaGreen = data.MagentaGreen;
-    const precise float yellowBlue = data.YellowBlue;
 
     precise const float4 pix = BufferIn[DTid.xy].rgba;
-    precise const float r = pix.x;
-    precise const float g = pix.y;
-    precise const float b = pix.z;
-    precise const float a = pix.w;
 
-    precise float3 gamma;
-    precise float3 res = float3(0, 0, 0);
-
-    if (range == Midtones)
-    {
-        static const float Delta = 0.0033944;
-
-        gamma[0] =
-            exp(-Delta * cyanRed + Delta * magentaGreen + Delta * yellowBlue);
-        gamma[1] =
-            exp(+Delta * cyanRed - Delta * magentaGreen + Delta * yellowBlue);
-        gamma[2] =
-            exp(+Delta * cyanRed + Delta * magentaGreen - Delta * yellowBlue);
-
-        res.r = clamp(pow(clamp(r, 0., 1.), gamma[0]), 0., 1.);
-        res.g = clamp(pow(clamp(g, 0., 1.), gamma[1]), 0., 1.);
-        res.b = clamp(pow(clamp(b, 0., 1.), gamma[2]), 0., 1.);
-    }
-    else if (range == Shadows)
-    {
-        static const float Delta = 0.003923;
-
-        gamma[0] = -Delta * cyanRed * Boole(cyanRed < 0.) +
-                   Delta * magentaGreen * Boole(magentaGreen > 0.) +
-                   Delta * yellowBlue * Boole(yellowBlue > 0.);
-        gamma[1] = +Delta * cyanRed * Boole(cyanRed > 0.) -
-                   Delta * magentaGreen * Boole(magentaGreen < 0.) +
-                   Delta * yellowBlue * Boole(yellowBlue > 0.);
-        gamma[2] = +Delta * cyanRed * Boole(cyanRed > 0.) +
-                   Delta * magentaGreen * Boole(magentaGreen > 0.) -
-                   Delta * yellowBlue * Boole(yellowBlue < 0.);
-
-        res.r = clamp((r - gamma[0]) / (1. - gamma[0]), 0., 1.);
-        res.g = clamp((g - gamma[1]) / (1. - gamma[1]), 0., 1.);
-        res.b = clamp((b - gamma[2]) / (1. - gamma[2]), 0., 1.);
-    }
-    else if (range == Highlights)
-    {
-        static const float Delta = 0.003923;
-
-        gamma[0] = +Delta * cyanRed * Boole(cyanRed > 0.) -
-                   Delta * magentaGreen * Boole(magentaGreen < 0.) -
-                   Delta * yellowBlue * Boole(yellowBlue < 0.);
-        gamma[1] = -Delta * cyanRed * Boole(cyanRed < 0.) +
-                   Delta * magentaGreen * Boole(magentaGreen > 0.) -
-                   Delta * yellowBlue * Boole(yellowBlue < 0.);
-        gamma[2] = -Delta * cyanRed * Boole(cyanRed < 0.) -
-                   Delta * magentaGreen * Boole(magentaGreen < 0.) +
-                   Delta * yellowBlue * Boole(yellowBlue > 0.);
-
-        res.r = clamp(r / (1. - gamma[0]), 0., 1.);
-        res.g = clamp(g / (1. - gamma[1]), 0., 1.);
-        res.b = clamp(b / (1. - gamma[2]), 0., 1.);
-    }
+    precise float3 res = pix.rgb;
+    res = ApplyShadows(res, data.Shadows);
+    res = ApplyMidtones(res, data.Midtones);
+    res = ApplyHighlights(res, data.Highlights);
 
     if (data.PreserveLuminosity)
     {
@@ -186,5 +160,5 @@ RWTexture2D<float4> BufferOut : register(u0);
         res.xyz = HslToRgb(hsl).xyz;
     }
 
-    BufferOut[DTid.xy].rgba = float4(res.x, res.y, res.z, a);
+    BufferOut[DTid.xy].rgba = float4(res.x, res.y, res.z, pix.a);
 }
@@ -0,0 +1,87 @@
+struct ShaderData
+{
+    int Filter;
+    float Radius;
+    float2 InputSize;
+    float2 OutputSize;
+};
+
+Texture2D<float4> BufferIn : register(t0);
+StructuredBuffer<ShaderData> Data : register(t1);
+
+RWTexture2D<float4> BufferOut : register(u0);
+
+static const float Pi = 3.14159265358979;
+
+// modified Bessel function of the first kind, order 0
+float BesselI0(const float x)
+{
+    const float q = x * x / 4.;
+    float sum = 1., term = 1.;
+    [unroll] for (int k = 1; k < 16; ++k)
+    {
+        term *= q / (k * k);
+        sum += term;
+    }
+    return sum;
+}
+
+// ImageTools::Resample::Kernel
+float Kernel(const int filter, const float x)
+{
+    const float ax = abs(x);
+    if (filter == 0)
+        return x >= -.5 && x < .5 ? 1. : 0.;
+    if (filter == 1)
+        return max(0., 1. - ax);
+    if (filter == 2)
+    {
+        if (ax < 1.)
+            return (1.5 * ax - 2.5) * ax * ax + 1.;
+        if (ax < 2.)
+            return ((-.5 * ax + 2.5) * ax - 4.) * ax + 2.;
+        return 0.;
+    }
+    if (ax >= 3.)
+        return 0.;
+    if (filter == 3)
+        return ax < 1e-5 ? 1. : 3. * sin(Pi * x) * sin(Pi * x / 3.) / (Pi * Pi * x * x);
+    const float t = ax / 3.;
+    const float window = BesselI0(4. * sqrt(1. - t * t)) / BesselI0(4.);
+    return ax < 1e-5 ? window : window * sin(Pi * x) / (Pi * x);
+}
+
+// both axes at once: the weight of a tap is the product of the axis weights,
+// edge taps are clamped like the cpu tables fold them
+[numthreads(32, 32, 1)] void Resample(uint3 DTID
+                                      : SV_DispatchThreadID)
+{
+    const ShaderData d = Data[0];
+    if (any(DTID.xy >= (uint2)d.OutputSize))
+        return;
+
+    const float2 scale = d.OutputSize / d.InputSize;
+    const float2 stretch = max(1., 1. / scale);
+    const float2 support = d.Radius * stretch;
+    const float2 center = (DTID.xy + .5) / scale;
+    const int2 lo = (int2)floor(center - support - .5);
+    const int2 hi = (int2)ceil(center + support - .5);
+    const int2 last = (int2)d.InputSize - 1;
+
+    float4 acc = 0;
+    float sum = 0;
+    for (int y = lo.y; y <= hi.y; ++y)
+    {
+        const float wy = Kernel(d.Filter, (y + .5 - center.y) / stretch.y);
+        if (wy == 0.)
+            continue;
+        for (int x = lo.x; x <= hi.x; ++x)
+        {
+            const float w = wy * Kernel(d.Filter, (x + .5 - center.x) / stretch.x);
+            acc += w * BufferIn.Load(int3(clamp(int2(x, y), 0, last), 0));
+            sum += w;
+        }
+    }
+
+    BufferOut[DTID.xy] = sum != 0. ? acc / sum : BufferIn.Load(int3(clamp((int2)center, 0, last), 0));
+}
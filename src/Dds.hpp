@@ -0,0 +1,947 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <execution>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "Simd.hpp"
+
+// DDS textures with block-compressed (BCn) levels. The encoders work on 4x4
+// blocks of RGBA8, edge blocks repeat the last row and column, block rows of a
+// level are encoded in parallel and the per-block search runs on Simd kernels.
+namespace Dds
+{
+    class Exception : public std::runtime_error
+    {
+        using std::runtime_error::runtime_error;
+    };
+
+#define __Dds_Ex__(fmt, ...) Exception(                              \
+    std::format("[{}:{}] [{}] [{}] {}",                              \
+                std::filesystem::path(__FILE__).filename().string(), \
+                __LINE__,                                            \
+                __FUNCTION__,                                        \
+                "Dds::Exception",                                    \
+                std::format(fmt, __VA_ARGS__)))
+
+    // Bc1: RGB, 1 bit alpha | Bc3: RGBA | Bc4: R | Bc5: RG, two channel normals | Bc7: RGBA, best quality
+    enum class Format
+    {
+        Bc1,
+        Bc3,
+        Bc4,
+        Bc5,
+        Bc7
+    };
+
+    // how hard the encoders search: Fast takes the principal axis endpoints,
+    // Normal refines them by least squares, Best also tries more modes and partitions
+    enum class Quality
+    {
+        Fast,
+        Normal,
+        Best
+    };
+
+    struct Options
+    {
+        Dds::Format Format = Dds::Format::Bc7;
+        Dds::Quality Quality = Dds::Quality::Normal;
+        // embed the mip chain handed to Save
+        bool Mipmaps = false;
+    };
+
+    // one RGBA8 level
+    struct Surface
+    {
+        const uint8_t *Data = nullptr;
+        int Width = 0;
+        int Height = 0;
+    };
+
+    namespace __Detail
+    {
+        using Block = std::array<uint8_t, 64>;
+
+        inline Block LoadBlock(const Surface &s, const int bx, const int by)
+        {
+            Block px{};
+            for (int y = 0; y < 4; ++y)
+            {
+                const auto row = s.Data + static_cast<size_t>(std::min(by * 4 + y, s.Height - 1)) * s.Width * 4;
+                for (int x = 0; x < 4; ++x)
+                    std::copy_n(row + std::min(bx * 4 + x, s.Width - 1) * 4, 4, px.data() + (y * 4 + x) * 4);
+            }
+            return px;
+        }
+
+        // little endian bit stream of a 128 bit block, BC7 fields are packed lsb first
+        struct BitWriter
+        {
+            std::array<uint8_t, 16> Bytes{};
+            int Pos = 0;
+
+            void Put(const uint32_t v, const int bits)
+            {
+                for (int i = 0; i < bits; ++i, ++Pos)
+                    Bytes[Pos >> 3] |= static_cast<uint8_t>(((v >> i) & 1) << (Pos & 7));
+            }
+        };
+
+        using Point = std::array<float, 4>;
+
+        // Endpoints of the segment through n points along their principal axis,
+        // found by power iteration on the covariance of the first `channels` channels.
+        inline void PrincipalEndpoints(const Point *pts, const int n, const int channels, Point &lo, Point &hi)
+        {
+            Point mean{};
+            for (int i = 0; i < n; ++i)
+                for (int c = 0; c < channels; ++c)
+                    mean[c] += pts[i][c];
+            for (int c = 0; c < channels; ++c)
+                mean[c] /= static_cast<float>(n);
+
+            float cov[4][4]{};
+            for (int i = 0; i < n; ++i)
+                for (int a = 0; a < channels; ++a)
+                    for (int b = a; b < channels; ++b)
+                        cov[a][b] += (pts[i][a] - mean[a]) * (pts[i][b] - mean[b]);
+
+            Point axis{1, 1, 1, 1};
+            for (int iter = 0; iter < 8; ++iter)
+            {
+                Point next{};
+                for (int a = 0; a < channels; ++a)
+                    for (int b = 0; b < channels; ++b)
+                        next[a] += cov[std::min(a, b)][std::max(a, b)] * axis[b];
+                float len = 0;
+                for (int c = 0; c < channels; ++c)
+                    len = std::max(len, std::abs(next[c]));
+                if (len < 1e-6f)
+                    break;
+                for (int c = 0; c < channels; ++c)
+                    axis[c] = next[c] / len;
+            }
+
+            float tMin = 0, tMax = 0;
+            for (int i = 0; i < n; ++i)
+            {
+                float t = 0;
+                for (int c = 0; c < channels; ++c)
+                    t += (pts[i][c] - mean[c]) * axis[c];
+                tMin = std::min(tMin, t);
+                tMax = std::max(tMax, t);
+            }
+
+            float len2 = 0;
+            for (int c = 0; c < channels; ++c)
+                len2 += axis[c] * axis[c];
+            len2 = std::max(len2, 1e-12f);
+            for (int c = 0; c < 4; ++c)
+            {
+                lo[c] = c < channels ? std::clamp(mean[c] + tMin / len2 * axis[c], 0.f, 255.f) : 0.f;
+                hi[c] = c < channels ? std::clamp(mean[c] + tMax / len2 * axis[c], 0.f, 255.f) : 0.f;
+            }
+        }
+
+        // Least squares endpoints for fixed interpolation weights: minimizes the sum
+        // of |(1 - w) lo + w hi - p|^2, false when every point has the same weight.
+        inline bool RefineEndpoints(const Point *pts, const float *w, const int n, const int channels, Point &lo, Point &hi)
+        {
+            float aa = 0, ab = 0, bb = 0;
+            Point ax{}, bx{};
+            for (int i = 0; i < n; ++i)
+            {
+                const auto a = 1 - w[i], b = w[i];
+                aa += a * a;
+                ab += a * b;
+                bb += b * b;
+                for (int c = 0; c < channels; ++c)
+                {
+                    ax[c] += a * pts[i][c];
+                    bx[c] += b * pts[i][c];
+                }
+            }
+
+            const auto det = aa * bb - ab * ab;
+            if (std::abs(det) < 1e-6f)
+                return false;
+            for (int c = 0; c < channels; ++c)
+            {
+                lo[c] = std::clamp((bb * ax[c] - ab * bx[c]) / det, 0.f, 255.f);
+                hi[c] = std::clamp((aa * bx[c] - ab * ax[c]) / det, 0.f, 255.f);
+            }
+            return true;
+        }
+
+        inline void ToPoints(const uint8_t *px, Point *pts)
+        {
+            for (int i = 0; i < 16; ++i)
+                for (int c = 0; c < 4; ++c)
+                    pts[i][c] = px[i * 4 + c];
+        }
+
+#pragma region Bc1
+        inline uint16_t To565(const Point &p)
+        {
+            const auto r = static_cast<int>(std::lround(p[0] * 31.f / 255.f));
+            const auto g = static_cast<int>(std::lround(p[1] * 63.f / 255.f));
+            const auto b = static_cast<int>(std::lround(p[2] * 31.f / 255.f));
+            return static_cast<uint16_t>(r << 11 | g << 5 | b);
+        }
+
+        inline std::array<uint8_t, 4> From565(const uint16_t c)
+        {
+            const auto r = c >> 11 & 31, g = c >> 5 & 63, b = c & 31;
+            return {static_cast<uint8_t>(r << 3 | r >> 2), static_cast<uint8_t>(g << 2 | g >> 4),
+                    static_cast<uint8_t>(b << 3 | b >> 2), 0};
+        }
+
+        // the four color palette of c0, c1 with alpha left at 0 to match the search input
+        inline std::array<uint8_t, 16> Palette565(const uint16_t c0, const uint16_t c1, const bool threeColor)
+        {
+            const auto a = From565(c0), b = From565(c1);
+            std::array<uint8_t, 16> pal{};
+            for (int c = 0; c < 3; ++c)
+            {
+                pal[c] = a[c];
+                pal[4 + c] = b[c];
+                if (threeColor)
+                {
+                    pal[8 + c] = static_cast<uint8_t>((a[c] + b[c] + 1) / 2);
+                    pal[12 + c] = 0;
+                }
+                else
+                {
+                    pal[8 + c] = static_cast<uint8_t>((2 * a[c] + b[c] + 1) / 3);
+                    pal[12 + c] = static_cast<uint8_t>((a[c] + 2 * b[c] + 1) / 3);
+                }
+            }
+            return pal;
+        }
+
+        inline uint64_t PackBc1(const uint16_t c0, const uint16_t c1, const uint8_t idx[16])
+        {
+            uint64_t bits = 0;
+            for (int i = 0; i < 16; ++i)
+                bits |= static_cast<uint64_t>(idx[i] & 3) << (i * 2);
+            return c0 | static_cast<uint64_t>(c1) << 16 | bits << 32;
+        }
+
+        // weight of the second endpoint for each 4-color index
+        constexpr float Bc1Weights[4]{0.f, 1.f, 1.f / 3, 2.f / 3};
+
+        // The color half of BC1/BC3. With punchThrough, pixels with alpha below 128
+        // become the transparent entry of the 3-color mode.
+        inline uint64_t EncodeBc1(const uint8_t *px, const Quality quality, const bool punchThrough)
+        {
+            std::array<uint8_t, 64> rgb{};
+            bool transparent = false;
+            for (int i = 0; i < 16; ++i)
+            {
+                std::copy_n(px + i * 4, 3, rgb.data() + i * 4);
+                transparent |= punchThrough && px[i * 4 + 3] < 128;
+            }
+
+            if (transparent)
+            {
+                Point pts[16];
+                int n = 0;
+                for (int i = 0; i < 16; ++i)
+                    if (px[i * 4 + 3] >= 128)
+                        pts[n++] = {static_cast<float>(px[i * 4]), static_cast<float>(px[i * 4 + 1]),
+                                    static_cast<float>(px[i * 4 + 2]), 0.f};
+
+                Point lo{}, hi{};
+                if (n > 0)
+                    PrincipalEndpoints(pts, n, 3, lo, hi);
+                auto c0 = To565(lo), c1 = To565(hi);
+                // the 3-color mode needs c0 <= c1, swapping keeps the middle entry
+                if (c0 > c1)
+                    std::swap(c0, c1);
+
+                const auto pal = Palette565(c0, c1, true);
+                uint8_t idx[16];
+                Simd::NearestPalette(rgb.data(), pal.data(), 3, idx);
+                for (int i = 0; i < 16; ++i)
+                    if (px[i * 4 + 3] < 128)
+                        idx[i] = 3;
+                return PackBc1(c0, c1, idx);
+            }
+
+            Point pts[16];
+            ToPoints(rgb.data(), pts);
+            Point lo{}, hi{};
+            PrincipalEndpoints(pts, 16, 3, lo, hi);
+            if (quality == Quality::Fast)
+            {
+                // pull the ends in a little, the extremes rarely sit on the line
+                for (int c = 0; c < 3; ++c)
+                {
+                    const auto inset = (hi[c] - lo[c]) / 16;
+                    lo[c] += inset;
+                    hi[c] -= inset;
+                }
+            }
+
+            uint16_t best0 = To565(lo), best1 = To565(hi);
+            uint8_t bestIdx[16];
+            auto pal = Palette565(best0, best1, false);
+            auto bestErr = Simd::NearestPalette(rgb.data(), pal.data(), 4, bestIdx);
+
+            const auto iterations = quality == Quality::Fast ? 0 : quality == Quality::Normal ? 1 : 3;
+            uint8_t idx[16];
+            std::copy_n(bestIdx, 16, idx);
+            for (int it = 0; it < iterations && bestErr > 0; ++it)
+            {
+                float w[16];
+                for (int i = 0; i < 16; ++i)
+                    w[i] = Bc1Weights[idx[i]];
+                if (!RefineEndpoints(pts, w, 16, 3, lo, hi))
+                    break;
+
+                const auto c0 = To565(lo), c1 = To565(hi);
+                pal = Palette565(c0, c1, false);
+                const auto err = Simd::NearestPalette(rgb.data(), pal.data(), 4, idx);
+                if (err >= bestErr)
+                    break;
+                bestErr = err;
+                best0 = c0;
+                best1 = c1;
+                std::copy_n(idx, 16, bestIdx);
+            }
+
+            // the 4-color mode needs c0 > c1
+            if (best0 < best1)
+            {
+                std::swap(best0, best1);
+                for (auto &i : bestIdx)
+                    i = static_cast<uint8_t>(i ^ 1);
+            }
+            else if (best0 == best1)
+                std::fill_n(bestIdx, 16, uint8_t{0});
+            return PackBc1(best0, best1, bestIdx);
+        }
+#pragma endregion Bc1
+
+#pragma region Bc4
+        // the eight values of an r0, r1 pair: r0 > r1 interpolates six, otherwise four plus 0 and 255
+        inline std::array<uint8_t, 8> Bc4Levels(const int r0, const int r1)
+        {
+            std::array<uint8_t, 8> levels{static_cast<uint8_t>(r0), static_cast<uint8_t>(r1)};
+            if (r0 > r1)
+                for (int i = 2; i < 8; ++i)
+                    levels[i] = static_cast<uint8_t>(((8 - i) * r0 + (i - 1) * r1 + 3) / 7);
+            else
+            {
+                for (int i = 2; i < 6; ++i)
+                    levels[i] = static_cast<uint8_t>(((6 - i) * r0 + (i - 1) * r1 + 2) / 5);
+                levels[6] = 0;
+                levels[7] = 255;
+            }
+            return levels;
+        }
+
+        // One channel block: 8 bit r0, r1 and sixteen 3 bit indices. Normal also
+        // tries the mode with exact 0 and 255, Best searches around the extremes.
+        inline uint64_t EncodeBc4(const uint8_t *px, const int channel, const Quality quality)
+        {
+            uint8_t v[16];
+            for (int i = 0; i < 16; ++i)
+                v[i] = px[i * 4 + channel];
+
+            const auto [minIt, maxIt] = std::minmax_element(v, v + 16);
+            const int lo = *minIt, hi = *maxIt;
+
+            int best0 = hi, best1 = lo;
+            uint8_t bestIdx[16]{};
+            uint32_t bestErr = UINT32_MAX;
+            const auto trial = [&](const int r0, const int r1)
+            {
+                const auto levels = Bc4Levels(r0, r1);
+                uint8_t idx[16];
+                if (const auto err = Simd::NearestLevel(v, levels.data(), 8, idx); err < bestErr)
+                {
+                    bestErr = err;
+                    best0 = r0;
+                    best1 = r1;
+                    std::copy_n(idx, 16, bestIdx);
+                }
+            };
+
+            trial(hi, lo);
+            if (quality != Quality::Fast && bestErr > 0)
+            {
+                // extremes come for free in the other mode, fit the rest between r0 <= r1
+                int innerLo = 255, innerHi = 0;
+                for (const auto x : v)
+                    if (x != 0 && x != 255)
+                    {
+                        innerLo = std::min<int>(innerLo, x);
+                        innerHi = std::max<int>(innerHi, x);
+                    }
+                if (innerLo <= innerHi)
+                    trial(innerLo, innerHi);
+            }
+            if (quality == Quality::Best && bestErr > 0 && hi - lo > 2)
+            {
+                for (int d0 = -2; d0 <= 2; ++d0)
+                    for (int d1 = -2; d1 <= 2; ++d1)
+                    {
+                        const auto r0 = std::clamp(hi + d0, 0, 255), r1 = std::clamp(lo + d1, 0, 255);
+                        if (r0 > r1)
+                            trial(r0, r1);
+                    }
+            }
+
+            uint64_t bits = 0;
+            for (int i = 0; i < 16; ++i)
+                bits |= static_cast<uint64_t>(bestIdx[i]) << (i * 3);
+            return static_cast<uint64_t>(best0) | static_cast<uint64_t>(best1) << 8 | bits << 16;
+        }
+#pragma endregion Bc4
+
+#pragma region Bc7
+        constexpr uint8_t Weights3[8]{0, 9, 18, 27, 37, 46, 55, 64};
+        constexpr uint8_t Weights4[16]{0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+        // subset of each pixel for the 64 two-subset partitions, bit i is pixel i
+        constexpr uint16_t Partitions2[64]{
+            0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80,
+            0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+            0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce,
+            0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+            0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a,
+            0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+            0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c,
+            0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22};
+
+        // the pixel of the second subset whose index drops its top bit
+        constexpr uint8_t Anchors2[64]{
+            15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+            15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+            15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6,
+            6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15};
+
+        struct Bc7Block
+        {
+            std::array<uint8_t, 16> Bytes{};
+            uint32_t Err = UINT32_MAX;
+        };
+
+        inline std::array<uint8_t, 4> Interpolate(const std::array<uint8_t, 4> &a, const std::array<uint8_t, 4> &b, const int w)
+        {
+            std::array<uint8_t, 4> out{};
+            for (int c = 0; c < 4; ++c)
+                out[c] = static_cast<uint8_t>(((64 - w) * a[c] + w * b[c] + 32) >> 6);
+            return out;
+        }
+
+        // Mode 6: one subset, RGBA 7.7.7.7 endpoints with a p-bit each, 4 bit indices.
+        struct Mode6
+        {
+            std::array<uint8_t, 4> Q[2]{};
+            uint8_t P[2]{};
+
+            std::array<uint8_t, 4> Endpoint(const int e) const
+            {
+                std::array<uint8_t, 4> out{};
+                for (int c = 0; c < 4; ++c)
+                    out[c] = static_cast<uint8_t>(Q[e][c] << 1 | P[e]);
+                return out;
+            }
+
+            void Quantize(const int e, const Point &p)
+            {
+                float bestErr = 1e30f;
+                for (uint8_t bit = 0; bit < 2; ++bit)
+                {
+                    std::array<uint8_t, 4> q{};
+                    float err = 0;
+                    for (int c = 0; c < 4; ++c)
+                    {
+                        q[c] = static_cast<uint8_t>(std::clamp(std::lround((p[c] - bit) / 2), 0l, 127l));
+                        const auto d = static_cast<float>(q[c] << 1 | bit) - p[c];
+                        err += d * d;
+                    }
+                    if (err < bestErr)
+                    {
+                        bestErr = err;
+                        Q[e] = q;
+                        P[e] = bit;
+                    }
+                }
+            }
+
+            uint32_t Evaluate(const uint8_t *px, uint8_t idx[16]) const
+            {
+                const auto a = Endpoint(0), b = Endpoint(1);
+                std::array<uint8_t, 64> pal{};
+                for (int i = 0; i < 16; ++i)
+                {
+                    const auto c = Interpolate(a, b, Weights4[i]);
+                    std::copy_n(c.data(), 4, pal.data() + i * 4);
+                }
+                return Simd::NearestPalette(px, pal.data(), 16, idx);
+            }
+
+            std::array<uint8_t, 16> Pack(uint8_t idx[16])
+            {
+                if (idx[0] >= 8)
+                {
+                    std::swap(Q[0], Q[1]);
+                    std::swap(P[0], P[1]);
+                    for (int i = 0; i < 16; ++i)
+                        idx[i] = static_cast<uint8_t>(15 - idx[i]);
+                }
+
+                BitWriter bw{};
+                bw.Put(1 << 6, 7);
+                for (int c = 0; c < 4; ++c)
+                {
+                    bw.Put(Q[0][c], 7);
+                    bw.Put(Q[1][c], 7);
+                }
+                bw.Put(P[0], 1);
+                bw.Put(P[1], 1);
+                bw.Put(idx[0], 3);
+                for (int i = 1; i < 16; ++i)
+                    bw.Put(idx[i], 4);
+                return bw.Bytes;
+            }
+        };
+
+        inline Bc7Block EncodeMode6(const uint8_t *px, const Quality quality)
+        {
+            Point pts[16];
+            ToPoints(px, pts);
+            Point lo{}, hi{};
+            PrincipalEndpoints(pts, 16, 4, lo, hi);
+
+            Mode6 best{};
+            best.Quantize(0, lo);
+            best.Quantize(1, hi);
+            uint8_t bestIdx[16];
+            auto bestErr = best.Evaluate(px, bestIdx);
+
+            const auto iterations = quality == Quality::Fast ? 0 : quality == Quality::Normal ? 1 : 2;
+            uint8_t idx[16];
+            std::copy_n(bestIdx, 16, idx);
+            for (int it = 0; it < iterations && bestErr > 0; ++it)
+            {
+                float w[16];
+                for (int i = 0; i < 16; ++i)
+                    w[i] = Weights4[idx[i]] / 64.f;
+                if (!RefineEndpoints(pts, w, 16, 4, lo, hi))
+                    break;
+
+                Mode6 next{};
+                next.Quantize(0, lo);
+                next.Quantize(1, hi);
+                const auto err = next.Evaluate(px, idx);
+                if (err >= bestErr)
+                    break;
+                best = next;
+                bestErr = err;
+                std::copy_n(idx, 16, bestIdx);
+            }
+
+            return {best.Pack(bestIdx), bestErr};
+        }
+
+        // Mode 1: two subsets, RGB 6.6.6 endpoints with a p-bit shared per subset,
+        // 3 bit indices, alpha is 255.
+        struct Mode1
+        {
+            std::array<uint8_t, 3> Q[2][2]{};
+            uint8_t P[2]{};
+
+            std::array<uint8_t, 4> Endpoint(const int s, const int e) const
+            {
+                std::array<uint8_t, 4> out{0, 0, 0, 255};
+                for (int c = 0; c < 3; ++c)
+                {
+                    const auto v7 = Q[s][e][c] << 1 | P[s];
+                    out[c] = static_cast<uint8_t>(v7 << 1 | v7 >> 6);
+                }
+                return out;
+            }
+
+            void Quantize(const int s, const Point &lo, const Point &hi)
+            {
+                float bestErr = 1e30f;
+                for (uint8_t bit = 0; bit < 2; ++bit)
+                {
+                    std::array<uint8_t, 3> q[2]{};
+                    float err = 0;
+                    for (int e = 0; e < 2; ++e)
+                        for (int c = 0; c < 3; ++c)
+                        {
+                            const auto p = (e == 0 ? lo : hi)[c];
+                            q[e][c] = static_cast<uint8_t>(std::clamp(std::lround((p * 127.f / 255.f - bit) / 2), 0l, 63l));
+                            const auto v7 = q[e][c] << 1 | bit;
+                            const auto d = static_cast<float>(v7 << 1 | v7 >> 6) - p;
+                            err += d * d;
+                        }
+                    if (err < bestErr)
+                    {
+                        bestErr = err;
+                        Q[s][0] = q[0];
+                        Q[s][1] = q[1];
+                        P[s] = bit;
+                    }
+                }
+            }
+
+            // the pixels of subset s gathered in front, the rest padded with palette
+            // entry 0 so they cost nothing
+            uint32_t Evaluate(const int s, const uint8_t *gathered, uint8_t idx[16]) const
+            {
+                const auto a = Endpoint(s, 0), b = Endpoint(s, 1);
+                std::array<uint8_t, 32> pal{};
+                for (int i = 0; i < 8; ++i)
+                {
+                    const auto c = Interpolate(a, b, Weights3[i]);
+                    std::copy_n(c.data(), 4, pal.data() + i * 4);
+                }
+                return Simd::NearestPalette(gathered, pal.data(), 8, idx);
+            }
+        };
+
+        // squared distance of the pixels of each subset from their principal line,
+        // a cheap estimate of how well a partition can be encoded
+        inline float PartitionCost(const Point *pts, const uint16_t mask)
+        {
+            float cost = 0;
+            for (int s = 0; s < 2; ++s)
+            {
+                Point sub[16];
+                int n = 0;
+                for (int i = 0; i < 16; ++i)
+                    if ((mask >> i & 1) == s)
+                        sub[n++] = pts[i];
+
+                Point lo{}, hi{};
+                PrincipalEndpoints(sub, n, 3, lo, hi);
+                Point dir{};
+                float len2 = 0;
+                for (int c = 0; c < 3; ++c)
+                {
+                    dir[c] = hi[c] - lo[c];
+                    len2 += dir[c] * dir[c];
+                }
+                for (int i = 0; i < n; ++i)
+                {
+                    Point d{};
+                    float t = 0;
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        d[c] = sub[i][c] - lo[c];
+                        t += d[c] * dir[c];
+                    }
+                    t = len2 > 0 ? std::clamp(t / len2, 0.f, 1.f) : 0.f;
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        const auto r = d[c] - t * dir[c];
+                        cost += r * r;
+                    }
+                }
+            }
+            return cost;
+        }
+
+        inline Bc7Block EncodeMode1(const uint8_t *px, const int partition)
+        {
+            Point pts[16];
+            ToPoints(px, pts);
+            const auto mask = Partitions2[partition];
+
+            Mode1 m{};
+            uint8_t idx[16]{};
+            uint32_t total = 0;
+            for (int s = 0; s < 2; ++s)
+            {
+                Point sub[16];
+                int members[16];
+                int n = 0;
+                for (int i = 0; i < 16; ++i)
+                    if ((mask >> i & 1) == s)
+                    {
+                        members[n] = i;
+                        sub[n++] = pts[i];
+                    }
+
+                Point lo{}, hi{};
+                PrincipalEndpoints(sub, n, 3, lo, hi);
+                m.Quantize(s, lo, hi);
+
+                std::array<uint8_t, 64> gathered{};
+                const auto pad = m.Endpoint(s, 0);
+                for (int i = 0; i < 16; ++i)
+                    std::copy_n(i < n ? px + members[i] * 4 : pad.data(), 4, gathered.data() + i * 4);
+
+                uint8_t subIdx[16];
+                auto err = m.Evaluate(s, gathered.data(), subIdx);
+
+                // one least squares pass, kept only when it helps
+                float w[16];
+                for (int i = 0; i < n; ++i)
+                    w[i] = Weights3[subIdx[i]] / 64.f;
+                if (err > 0 && RefineEndpoints(sub, w, n, 3, lo, hi))
+                {
+                    auto next = m;
+                    next.Quantize(s, lo, hi);
+                    const auto nextPad = next.Endpoint(s, 0);
+                    for (int i = n; i < 16; ++i)
+                        std::copy_n(nextPad.data(), 4, gathered.data() + i * 4);
+                    uint8_t nextIdx[16];
+                    if (const auto nextErr = next.Evaluate(s, gathered.data(), nextIdx); nextErr < err)
+                    {
+                        m = next;
+                        err = nextErr;
+                        std::copy_n(nextIdx, 16, subIdx);
+                    }
+                }
+
+                // the anchor index must fit in one bit less
+                const auto anchor = s == 0 ? 0 : Anchors2[partition];
+                const auto anchorAt = static_cast<int>(std::find(members, members + n, anchor) - members);
+                if (subIdx[anchorAt] >= 4)
+                {
+                    std::swap(m.Q[s][0], m.Q[s][1]);
+                    for (int i = 0; i < n; ++i)
+                        subIdx[i] = static_cast<uint8_t>(7 - subIdx[i]);
+                }
+                for (int i = 0; i < n; ++i)
+                    idx[members[i]] = subIdx[i];
+                total += err;
+            }
+
+            BitWriter bw{};
+            bw.Put(1 << 1, 2);
+            bw.Put(static_cast<uint32_t>(partition), 6);
+            for (int c = 0; c < 3; ++c)
+                for (int s = 0; s < 2; ++s)
+                {
+                    bw.Put(m.Q[s][0][c], 6);
+                    bw.Put(m.Q[s][1][c], 6);
+                }
+            bw.Put(m.P[0], 1);
+            bw.Put(m.P[1], 1);
+            for (int i = 0; i < 16; ++i)
+                bw.Put(idx[i], i == 0 || i == Anchors2[partition] ? 2 : 3);
+            return {bw.Bytes, total};
+        }
+
+        // Mode 6 for every block; Best also tries mode 1 on opaque blocks with the
+        // partitions that estimate cheapest.
+        inline std::array<uint8_t, 16> EncodeBc7(const uint8_t *px, const Quality quality)
+        {
+            auto best = EncodeMode6(px, quality);
+            if (quality != Quality::Best || best.Err == 0)
+                return best.Bytes;
+
+            for (int i = 0; i < 16; ++i)
+                if (px[i * 4 + 3] != 255)
+                    return best.Bytes;
+
+            Point pts[16];
+            ToPoints(px, pts);
+            std::array<std::pair<float, int>, 64> costs{};
+            for (int p = 0; p < 64; ++p)
+                costs[p] = {PartitionCost(pts, Partitions2[p]), p};
+            constexpr int tries = 4;
+            std::partial_sort(costs.begin(), costs.begin() + tries, costs.end());
+
+            for (int t = 0; t < tries; ++t)
+                if (const auto block = EncodeMode1(px, costs[t].second); block.Err < best.Err)
+                    best = block;
+            return best.Bytes;
+        }
+#pragma endregion Bc7
+
+        inline void EncodeBlock(const uint8_t *px, const Format format, const Quality quality, uint8_t *out)
+        {
+            const auto put64 = [](uint64_t v, uint8_t *dst)
+            {
+                for (int i = 0; i < 8; ++i, v >>= 8)
+                    dst[i] = static_cast<uint8_t>(v);
+            };
+
+            switch (format)
+            {
+            case Format::Bc1:
+                return put64(EncodeBc1(px, quality, true), out);
+            case Format::Bc3:
+                put64(EncodeBc4(px, 3, quality), out);
+                return put64(EncodeBc1(px, quality, false), out + 8);
+            case Format::Bc4:
+                return put64(EncodeBc4(px, 0, quality), out);
+            case Format::Bc5:
+                put64(EncodeBc4(px, 0, quality), out);
+                return put64(EncodeBc4(px, 1, quality), out + 8);
+            case Format::Bc7:
+            {
+                const auto block = EncodeBc7(px, quality);
+                std::copy(block.begin(), block.end(), out);
+                return;
+            }
+            }
+        }
+
+        // DDS_HEADER and DDS_HEADER_DXT10
+        struct Header
+        {
+            uint32_t Size = 124;
+            uint32_t Flags = 0;
+            uint32_t Height = 0;
+            uint32_t Width = 0;
+            uint32_t PitchOrLinearSize = 0;
+            uint32_t Depth = 0;
+            uint32_t MipMapCount = 0;
+            uint32_t Reserved1[11]{};
+            uint32_t PfSize = 32;
+            uint32_t PfFlags = 0;
+            uint32_t PfFourCC = 0;
+            uint32_t PfRgbBitCount = 0;
+            uint32_t PfMasks[4]{};
+            uint32_t Caps = 0;
+            uint32_t Caps2 = 0;
+            uint32_t Caps3 = 0;
+            uint32_t Caps4 = 0;
+            uint32_t Reserved2 = 0;
+        };
+        static_assert(sizeof(Header) == 124);
+
+        struct HeaderDx10
+        {
+            uint32_t DxgiFormat = 0;
+            uint32_t ResourceDimension = 3; // D3D10_RESOURCE_DIMENSION_TEXTURE2D
+            uint32_t MiscFlag = 0;
+            uint32_t ArraySize = 1;
+            uint32_t MiscFlags2 = 0;
+        };
+
+        constexpr uint32_t FourCC(const char (&s)[5])
+        {
+            return static_cast<uint32_t>(s[0]) | static_cast<uint32_t>(s[1]) << 8 |
+                   static_cast<uint32_t>(s[2]) << 16 | static_cast<uint32_t>(s[3]) << 24;
+        }
+    }
+
+    inline size_t BlockBytes(const Format format)
+    {
+        return format == Format::Bc1 || format == Format::Bc4 ? 8 : 16;
+    }
+
+    // One level as block rows, top to bottom.
+    inline std::vector<uint8_t> Encode(const Surface &surface, const Format format, const Quality quality)
+    {
+        if (!surface.Data || surface.Width <= 0 || surface.Height <= 0)
+            throw __Dds_Ex__("invalid surface: {}x{}", surface.Width, surface.Height);
+
+        const auto bw = (surface.Width + 3) / 4, bh = (surface.Height + 3) / 4;
+        const auto blockBytes = BlockBytes(format);
+        std::vector<uint8_t> out(static_cast<size_t>(bw) * bh * blockBytes);
+
+        std::vector<int> rows(bh);
+        std::iota(rows.begin(), rows.end(), 0);
+        std::for_each(std::execution::par_unseq, rows.begin(), rows.end(), [&](const int by)
+                      {
+                          for (int bx = 0; bx < bw; ++bx)
+                          {
+                              const auto px = __Detail::LoadBlock(surface, bx, by);
+                              __Detail::EncodeBlock(px.data(), format, quality,
+                                                    out.data() + (static_cast<size_t>(by) * bw + bx) * blockBytes);
+                          } });
+        return out;
+    }
+
+    // Writes levels[0] and, when opt.Mipmaps is set, the following levels as its
+    // mip chain; each level must be half the size of the one before, rounded down.
+    // BC1 and BC3 use the legacy DXT1/DXT5 headers, the rest the DX10 extension.
+    inline void Save(const std::filesystem::path &path, const std::span<const Surface> levels, const Options &opt)
+    {
+        if (levels.empty())
+            throw __Dds_Ex__("no levels: {}", path.string());
+
+        const auto count = opt.Mipmaps ? levels.size() : size_t{1};
+        for (size_t i = 1; i < count; ++i)
+            if (levels[i].Width != std::max(1, levels[i - 1].Width / 2) ||
+                levels[i].Height != std::max(1, levels[i - 1].Height / 2))
+                throw __Dds_Ex__("level {} is {}x{}, not half of {}x{}", i, levels[i].Width, levels[i].Height,
+                                 levels[i - 1].Width, levels[i - 1].Height);
+
+        std::vector<std::vector<uint8_t>> encoded{};
+        for (size_t i = 0; i < count; ++i)
+            encoded.push_back(Encode(levels[i], opt.Format, opt.Quality));
+
+        constexpr uint32_t capsFlag = 0x1, heightFlag = 0x2, widthFlag = 0x4, pixelFormatFlag = 0x1000,
+                           mipMapCountFlag = 0x20000, linearSizeFlag = 0x80000;
+        constexpr uint32_t fourCCFlag = 0x4;
+        constexpr uint32_t complexCaps = 0x8, textureCaps = 0x1000, mipMapCaps = 0x400000;
+
+        __Detail::Header header{};
+        header.Flags = capsFlag | heightFlag | widthFlag | pixelFormatFlag | linearSizeFlag;
+        header.Width = static_cast<uint32_t>(levels[0].Width);
+        header.Height = static_cast<uint32_t>(levels[0].Height);
+        header.PitchOrLinearSize = static_cast<uint32_t>(encoded[0].size());
+        header.MipMapCount = static_cast<uint32_t>(count);
+        header.PfFlags = fourCCFlag;
+        header.Caps = textureCaps;
+        if (count > 1)
+        {
+            header.Flags |= mipMapCountFlag;
+            header.Caps |= complexCaps | mipMapCaps;
+        }
+
+        __Detail::HeaderDx10 dx10{};
+        bool useDx10 = false;
+        switch (opt.Format)
+        {
+        case Format::Bc1:
+            header.PfFourCC = __Detail::FourCC("DXT1");
+            break;
+        case Format::Bc3:
+            header.PfFourCC = __Detail::FourCC("DXT5");
+            break;
+        case Format::Bc4:
+            dx10.DxgiFormat = 80; // DXGI_FORMAT_BC4_UNORM
+            useDx10 = true;
+            break;
+        case Format::Bc5:
+            dx10.DxgiFormat = 83; // DXGI_FORMAT_BC5_UNORM
+            useDx10 = true;
+            break;
+        case Format::Bc7:
+            dx10.DxgiFormat = 98; // DXGI_FORMAT_BC7_UNORM
+            useDx10 = true;
+            break;
+        }
+        if (useDx10)
+            header.PfFourCC = __Detail::FourCC("DX10");
+
+        std::ofstream fs(path, std::ios::out | std::ios::binary);
+        if (!fs)
+            throw __Dds_Ex__("open file failed: {}", path.string());
+
+        fs.write("DDS ", 4);
+        fs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        if (useDx10)
+            fs.write(reinterpret_cast<const char *>(&dx10), sizeof(dx10));
+        for (const auto &level : encoded)
+            fs.write(reinterpret_cast<const char *>(level.data()), static_cast<std::streamsize>(level.size()));
+
+        if (!fs)
+            throw __Dds_Ex__("write file failed: {}", path.string());
+    }
+}
@@ -5,10 +5,21 @@
 
 #include <climits>
 #include <cassert>
+#include <cmath>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <algorithm>
+#include <bit>
+#include <execution>
 #include <filesystem>
+#include <fstream>
+#include <functional>
+#include <numeric>
+#include <optional>
+#include <span>
 #include <sstream>
+#include <vector>
 
 #ifdef UseOpenCV
 #include <opencv2/opencv.hpp>
@@ -20,6 +31,13 @@ extern "C"
 #include <stb_image_write.h>
 }
 
+#include "Dds.hpp"
+#include "Jpeg.hpp"
+#include "Netpbm.hpp"
+#include "Png.hpp"
+#include "Qoi.hpp"
+#include "Simd.hpp"
+
 namespace Image
 {
 #ifdef UseOpenCV
@@ -387,15 +405,226 @@ namespace Image
                 static_cast<uint8_t>(std::clamp(std::round(color.A * 255.f), 0.f, 255.f))};
     }
 
+    // how a sample is stored, F16 is IEEE binary16
+    enum class SampleType
+    {
+        U8,
+        U16,
+        F16,
+        F32
+    };
+
+    inline size_t SampleBytes(const SampleType type)
+    {
+        switch (type)
+        {
+        case SampleType::U16:
+        case SampleType::F16:
+            return 2;
+        case SampleType::F32:
+            return 4;
+        case SampleType::U8:
+        default:
+            return 1;
+        }
+    }
+
+    // interleaved gray, gray alpha, RGB or RGBA, by Channels
+    struct PixelFormat
+    {
+        int Channels = 4;
+        SampleType Sample = SampleType::U8;
+
+        [[nodiscard]] size_t PixelBytes() const { return static_cast<size_t>(Channels) * SampleBytes(Sample); }
+
+        bool operator==(const PixelFormat &) const = default;
+    };
+
+    // what the tools, the encoders and the GPU work on unless they say otherwise
+    constexpr PixelFormat Rgba8{};
+
+    namespace __Detail
+    {
+        inline float HalfToFloat(const uint16_t h)
+        {
+            const uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+            const uint32_t exp = h >> 10 & 0x1f;
+            const uint32_t man = h & 0x3ff;
+            if (exp == 0x1f)
+                return std::bit_cast<float>(sign | 0x7f800000u | man << 13);
+            if (exp != 0)
+                return std::bit_cast<float>(sign | (exp + 112) << 23 | man << 13);
+            // zero and subnormals
+            const auto v = static_cast<float>(man) * 0x1p-24f;
+            return sign ? -v : v;
+        }
+
+        // round to nearest even, out of range goes to infinity
+        inline uint16_t FloatToHalf(const float f)
+        {
+            const auto bits = std::bit_cast<uint32_t>(f);
+            const auto sign = static_cast<uint16_t>(bits >> 16 & 0x8000);
+            const auto abs = bits & 0x7fffffffu;
+            if (abs > 0x7f800000u)
+                return sign | 0x7e00;
+            if (abs >= 0x477ff000u)
+                return sign | 0x7c00;
+            if (abs < 0x38800000u)
+                return sign | static_cast<uint16_t>(std::nearbyint(std::bit_cast<float>(abs) * 0x1p24f));
+            const auto rounded = abs + 0xfff + (abs >> 13 & 1);
+            return sign | static_cast<uint16_t>((rounded - 0x38000000u) >> 13);
+        }
+
+        // integers are normalized to [0, 1], floats are taken as they are
+        template <SampleType S>
+        float ReadSample(const uint8_t *p, const size_t k)
+        {
+            if constexpr (S == SampleType::U8)
+                return static_cast<float>(p[k]) * (1.f / 255.f);
+            else if constexpr (S == SampleType::F32)
+            {
+                float v;
+                std::memcpy(&v, p + k * 4, 4);
+                return v;
+            }
+            else
+            {
+                uint16_t v;
+                std::memcpy(&v, p + k * 2, 2);
+                if constexpr (S == SampleType::U16)
+                    return static_cast<float>(v) * (1.f / 65535.f);
+                else
+                    return HalfToFloat(v);
+            }
+        }
+
+        template <SampleType S>
+        void WriteSample(uint8_t *p, const size_t k, const float v)
+        {
+            if constexpr (S == SampleType::U8)
+                p[k] = static_cast<uint8_t>(std::clamp(std::round(v * 255.f), 0.f, 255.f));
+            else if constexpr (S == SampleType::F32)
+                std::memcpy(p + k * 4, &v, 4);
+            else
+            {
+                const auto h = S == SampleType::U16
+                                   ? static_cast<uint16_t>(std::clamp(std::round(v * 65535.f), 0.f, 65535.f))
+                                   : FloatToHalf(v);
+                std::memcpy(p + k * 2, &h, 2);
+            }
+        }
+
+        template <SampleType S>
+        void LoadPixelsAs(const uint8_t *src, const int channels, const size_t n, float *rgba)
+        {
+            for (size_t i = 0; i < n; ++i, rgba += 4)
+            {
+                const auto k = i * channels;
+                if (channels >= 3)
+                {
+                    rgba[0] = ReadSample<S>(src, k);
+                    rgba[1] = ReadSample<S>(src, k + 1);
+                    rgba[2] = ReadSample<S>(src, k + 2);
+                }
+                else
+                    rgba[0] = rgba[1] = rgba[2] = ReadSample<S>(src, k);
+                rgba[3] = channels == 4 ? ReadSample<S>(src, k + 3) : channels == 2 ? ReadSample<S>(src, k + 1) : 1.f;
+            }
+        }
+
+        template <SampleType S>
+        void StorePixelsAs(const float *rgba, const size_t n, const int channels, uint8_t *dst)
+        {
+            for (size_t i = 0; i < n; ++i, rgba += 4)
+            {
+                const auto k = i * channels;
+                if (channels >= 3)
+                {
+                    WriteSample<S>(dst, k, rgba[0]);
+                    WriteSample<S>(dst, k + 1, rgba[1]);
+                    WriteSample<S>(dst, k + 2, rgba[2]);
+                    if (channels == 4)
+                        WriteSample<S>(dst, k + 3, rgba[3]);
+                }
+                else
+                {
+                    // the weights stb uses, a gray pixel stays as it is
+                    WriteSample<S>(dst, k, (77.f * rgba[0] + 150.f * rgba[1] + 29.f * rgba[2]) / 256.f);
+                    if (channels == 2)
+                        WriteSample<S>(dst, k + 1, rgba[3]);
+                }
+            }
+        }
+
+        // n pixels of format to RGBA floats: gray fills RGB and no alpha is opaque
+        inline void LoadPixels(const uint8_t *src, const PixelFormat &format, const size_t n, float *rgba)
+        {
+            switch (format.Sample)
+            {
+            case SampleType::U16:
+                return LoadPixelsAs<SampleType::U16>(src, format.Channels, n, rgba);
+            case SampleType::F16:
+                return LoadPixelsAs<SampleType::F16>(src, format.Channels, n, rgba);
+            case SampleType::F32:
+                return LoadPixelsAs<SampleType::F32>(src, format.Channels, n, rgba);
+            case SampleType::U8:
+            default:
+                return LoadPixelsAs<SampleType::U8>(src, format.Channels, n, rgba);
+            }
+        }
+
+        // n RGBA float pixels to format, fewer channels keep luma and alpha
+        inline void StorePixels(const float *rgba, const size_t n, const PixelFormat &format, uint8_t *dst)
+        {
+            switch (format.Sample)
+            {
+            case SampleType::U16:
+                return StorePixelsAs<SampleType::U16>(rgba, n, format.Channels, dst);
+            case SampleType::F16:
+                return StorePixelsAs<SampleType::F16>(rgba, n, format.Channels, dst);
+            case SampleType::F32:
+                return StorePixelsAs<SampleType::F32>(rgba, n, format.Channels, dst);
+            case SampleType::U8:
+            default:
+                return StorePixelsAs<SampleType::U8>(rgba, n, format.Channels, dst);
+            }
+        }
+    }
+
 #ifdef UseStb
+    // per format encoder settings for ImageFile::Save
+    struct SaveOptions
+    {
+        Dds::Options Dds{};
+        Png::Options Png{};
+        Jpeg::Options Jpeg{};
+    };
+
+    // what ImageFile::Probe reads from a file header
+    struct ImageInfo
+    {
+        int Width = 0;
+        int Height = 0;
+        int Channels = 0;
+        int Depth = 8; // bits per sample
+
+        bool operator==(const ImageInfo &) const = default;
+    };
+
+    // Pixels are Rgba8 unless a loader is told the caller takes the file's own
+    // channel count and sample type, see LoadMemory.
     class ImageFile
     {
         uint8_t *data = nullptr;
         int width = 0;
         int height = 0;
+        PixelFormat format{};
         bool autoFree = true;
 
     public:
+        // the formats a caller takes as decoded, anything else is loaded as Rgba8
+        using FormatFilter = std::function<bool(const PixelFormat &)>;
+
         ImageFile() = default;
 
         ImageFile(const std::filesystem::path &file)
@@ -403,22 +632,23 @@ namespace Image
             LoadFile(file);
         }
 
-        ImageFile(const uint8_t *fileData, const int size)
+        ImageFile(const uint8_t *fileData, const size_t size, const FormatFilter &accepts = {})
         {
-            data = stbi_load_from_memory(fileData, size, &width, &height, nullptr, 4);
+            LoadMemory(fileData, size, accepts);
         }
 
         ImageFile(uint8_t *data, const int width, const int height, const bool autoFree = true) : data(data), width(width), height(height), autoFree(autoFree) {}
 
-        ImageFile(const int width, const int height) : width(width), height(height)
+        ImageFile(const int width, const int height, const PixelFormat &format = Rgba8) : width(width), height(height), format(format)
         {
-            data = new uint8_t[static_cast<size_t>(width) * height * 4];
+            data = new uint8_t[static_cast<size_t>(width) * height * format.PixelBytes()];
         }
 
         ImageFile(const ImageFile &img)
         {
             width = img.width;
             height = img.height;
+            format = img.format;
             autoFree = true;
             data = new uint8_t[img.Size()];
             std::copy_n(img.data, img.Size(), data);
@@ -428,6 +658,7 @@ namespace Image
         {
             width = img.width;
             height = img.height;
+            format = img.format;
             data = img.data;
             autoFree = img.autoFree;
             img.width = 0;
@@ -440,6 +671,7 @@ namespace Image
             this->Clear();
             this->width = img.width;
             this->height = img.height;
+            this->format = img.format;
             this->autoFree = true;
             this->data = new uint8_t[img.Size()];
             std::copy_n(img.data, img.Size(), this->data);
@@ -451,6 +683,7 @@ namespace Image
             Clear();
             width = img.width;
             height = img.height;
+            format = img.format;
             data = img.data;
             autoFree = img.autoFree;
             img.width = 0;
@@ -466,11 +699,95 @@ namespace Image
 
         ImageFile Clone() const
         {
-            ImageFile buf(width, height);
+            ImageFile buf(width, height, format);
             std::copy_n(data, Size(), buf.Data());
             return buf;
         }
 
+        // A copy in another pixel format. Integer samples are normalized, floats are
+        // clamped only when stored as integers; gray fills RGB, RGB to gray keeps luma
+        // and a missing alpha is opaque.
+        ImageFile Converted(const PixelFormat &to) const
+        {
+            if (to == format)
+                return Clone();
+
+            ImageFile buf(width, height, to);
+            const auto srcStride = static_cast<size_t>(width) * format.PixelBytes();
+            const auto dstStride = static_cast<size_t>(width) * to.PixelBytes();
+            std::vector<int> rows(height);
+            std::iota(rows.begin(), rows.end(), 0);
+            std::for_each(std::execution::par, rows.begin(), rows.end(), [&](const int y)
+                          {
+                              std::vector<float> rgba(static_cast<size_t>(width) * 4);
+                              __Detail::LoadPixels(data + y * srcStride, format, width, rgba.data());
+                              __Detail::StorePixels(rgba.data(), width, to, buf.data + y * dstStride); });
+            return buf;
+        }
+
+        // 2x2 box reduction, an odd last row or column is dropped
+        ImageFile Halved() const
+        {
+            if (width < 2 || height < 2)
+                throw __Image_Ex__("can not halve ", width, "x", height);
+            if (format != Rgba8)
+                return Converted(Rgba8).Halved();
+            ImageFile buf(width / 2, height / 2);
+            const auto stride = static_cast<size_t>(width) * 4;
+            std::vector<int> rows(buf.height);
+            std::iota(rows.begin(), rows.end(), 0);
+            std::for_each(std::execution::par_unseq, rows.begin(), rows.end(), [&](const int y)
+                          {
+                              const auto src = data + y * 2 * stride;
+                              Simd::Halve(src, src + stride, buf.data + static_cast<size_t>(y) * buf.width * 4, buf.width); });
+            return buf;
+        }
+
+        // Decodes an image with its longer side at maxSide or a little over, for
+        // previews. Sequential JPEGs are scaled by 1/2, 1/4 or 1/8 in the DCT domain
+        // while decoding; what is still twice as large, and any other format, is
+        // halved with a 2x2 box. maxSide <= 0 keeps the full size.
+        static ImageFile Preview(const uint8_t *fileData, const size_t size, const int maxSide)
+        {
+            const auto larger = [&](const ImageFile &img)
+            {
+                return maxSide > 0 && std::min(img.width, img.height) >= 2 &&
+                       std::max(img.width, img.height) / 2 >= maxSide;
+            };
+
+            ImageFile img{};
+            if (const auto frame = maxSide > 0 ? Jpeg::Probe(fileData, size) : std::nullopt; frame && frame->Reducible)
+            {
+                auto scale = 1;
+                while (scale < 8 && std::max(frame->Width, frame->Height) / (scale * 2) >= maxSide)
+                    scale *= 2;
+                // stb is quicker at full size
+                if (scale > 1)
+                {
+                    const auto w = Jpeg::ReducedExtent(frame->Width, scale), h = Jpeg::ReducedExtent(frame->Height, scale);
+                    // released by Clear with stbi_image_free, i.e. free
+                    img = ImageFile(static_cast<uint8_t *>(std::malloc(static_cast<size_t>(w) * h * 4)), w, h);
+                    if (!img.data)
+                        throw __Image_Ex__("out of memory: ", w, "x", h);
+                    try
+                    {
+                        Jpeg::DecodeReduced(fileData, size, scale, img.data);
+                    }
+                    catch (const Jpeg::Exception &)
+                    {
+                        // leave damaged files to stb, which may still get something out of them
+                        img.Clear();
+                    }
+                }
+            }
+            if (img.Empty())
+                img.LoadMemory(fileData, size);
+
+            while (larger(img))
+                img = img.Halved();
+            return img;
+        }
+
         void Clear()
         {
             if (autoFree && data != nullptr)
@@ -478,25 +795,205 @@ namespace Image
             data = nullptr;
             width = 0;
             height = 0;
+            format = Rgba8;
         }
 
         void LoadFile(const std::filesystem::path &file)
         {
-            data = stbi_load(reinterpret_cast<const char *>(file.u8string().c_str()), &width, &height, nullptr, 4);
+            std::ifstream fs(file, std::ios::in | std::ios::binary);
+            if (!fs)
+                throw __Image_Ex__("open file failed: ", file.string());
+            std::vector<uint8_t> buf(std::filesystem::file_size(file));
+            fs.read(reinterpret_cast<char *>(buf.data()), static_cast<std::streamsize>(buf.size()));
+            if (static_cast<size_t>(fs.gcount()) != buf.size())
+                throw __Image_Ex__("read file failed: ", file.string());
+            LoadMemory(buf.data(), buf.size());
+        }
+
+        // Reads the header alone, the formats LoadMemory takes are probed the same way.
+        static ImageInfo Probe(const uint8_t *fileData, const size_t size)
+        {
+            if (Qoi::IsQoi(fileData, size))
+            {
+                ImageInfo info{.Channels = Qoi::Channels(fileData, size)};
+                Qoi::Info(fileData, size, info.Width, info.Height);
+                return info;
+            }
+            if (Netpbm::IsPam(fileData, size) || Netpbm::IsPfm(fileData, size))
+            {
+                const auto layout = Netpbm::Header(fileData, size);
+                return {.Width = layout.Width, .Height = layout.Height, .Channels = layout.Depth,
+                        .Depth = Netpbm::IsPfm(fileData, size) ? 32 : layout.MaxVal > 255 ? 16 : 8};
+            }
+            if (Jpeg::IsJpeg(fileData, size))
+            {
+                const auto frame = Jpeg::Probe(fileData, size);
+                if (!frame)
+                    throw __Image_Ex__("no jpeg frame header in ", size, " bytes");
+                return {.Width = frame->Width, .Height = frame->Height, .Channels = frame->Components,
+                        .Depth = frame->Precision};
+            }
+
+            const auto len = static_cast<int>(std::min<size_t>(size, INT_MAX));
+            ImageInfo info{};
+            if (!stbi_info_from_memory(fileData, len, &info.Width, &info.Height, &info.Channels))
+                throw __Image_Ex__("invalid header: \"", stbi_failure_reason(), "\"");
+            if (stbi_is_16_bit_from_memory(fileData, len))
+                info.Depth = 16;
+            else if (stbi_is_hdr_from_memory(fileData, len))
+                info.Depth = 32;
+            return info;
+        }
+
+        // Reads only as much of the file as the header needs: a first block, then
+        // more while it comes up short, e.g. a JPEG with a large Exif segment.
+        static ImageInfo Probe(const std::filesystem::path &file)
+        {
+            std::ifstream fs(file, std::ios::in | std::ios::binary);
+            if (!fs)
+                throw __Image_Ex__("open file failed: ", file.string());
+            const auto total = std::filesystem::file_size(file);
+
+            std::vector<uint8_t> buf{};
+            for (uint64_t want = 64 * 1024;; want *= 8)
+            {
+                const auto have = buf.size();
+                buf.resize(static_cast<size_t>(std::min(want, total)));
+                fs.read(reinterpret_cast<char *>(buf.data() + have), static_cast<std::streamsize>(buf.size() - have));
+                if (static_cast<size_t>(fs.gcount()) != buf.size() - have)
+                    throw __Image_Ex__("read file failed: ", file.string());
+
+                if (buf.size() == total)
+                    return Probe(buf.data(), buf.size());
+                try
+                {
+                    return Probe(buf.data(), buf.size());
+                }
+                catch (const Exception &)
+                {
+                }
+                catch (const Qoi::Exception &)
+                {
+                }
+                catch (const Netpbm::Exception &)
+                {
+                }
+            }
+        }
+
+        // The pixel format LoadMemory can keep for a file, nullopt where it only
+        // decodes to Rgba8: QOI, Radiance HDR and what stb can not read.
+        static std::optional<PixelFormat> NativeFormat(const uint8_t *fileData, const size_t size)
+        {
+            if (Netpbm::IsPam(fileData, size) || Netpbm::IsPfm(fileData, size))
+            {
+                const auto layout = Netpbm::Header(fileData, size);
+                return PixelFormat{layout.Depth, Netpbm::IsPfm(fileData, size) ? SampleType::F32
+                                                 : layout.MaxVal > 255         ? SampleType::U16
+                                                                               : SampleType::U8};
+            }
+            if (Qoi::IsQoi(fileData, size) || size > INT_MAX)
+                return std::nullopt;
+
+            const auto len = static_cast<int>(size);
+            int w, h, channels;
+            if (stbi_is_hdr_from_memory(fileData, len) || !stbi_info_from_memory(fileData, len, &w, &h, &channels))
+                return std::nullopt;
+            return PixelFormat{channels, stbi_is_16_bit_from_memory(fileData, len) ? SampleType::U16 : SampleType::U8};
+        }
+
+        // QOI, PAM and PFM are decoded here, everything else by stb. The result is
+        // Rgba8, or the file's own format when accepts takes it: gray and 16 bit
+        // PNGs, 16 bit PAMs and float PFMs then keep their size and precision.
+        void LoadMemory(const uint8_t *fileData, const size_t size, const FormatFilter &accepts = {})
+        {
+            Clear();
+            const auto native = accepts ? NativeFormat(fileData, size) : std::nullopt;
+            const auto keep = native && *native != Rgba8 && accepts(*native);
+
+            const auto decode = [&](auto info, auto decoder, const PixelFormat &fmt)
+            {
+                int w, h;
+                info(fileData, size, w, h);
+                // released by Clear with stbi_image_free, i.e. free
+                data = static_cast<uint8_t *>(std::malloc(static_cast<size_t>(w) * h * fmt.PixelBytes()));
+                if (!data)
+                    throw __Image_Ex__("out of memory: ", w, "x", h);
+                try
+                {
+                    decoder(fileData, size, data);
+                }
+                catch (...)
+                {
+                    stbi_image_free(data);
+                    data = nullptr;
+                    throw;
+                }
+                width = w;
+                height = h;
+                format = fmt;
+                autoFree = true;
+            };
+
+            if (Qoi::IsQoi(fileData, size))
+                return decode(Qoi::Info, Qoi::Decode, Rgba8);
+            if (Netpbm::IsPam(fileData, size) || Netpbm::IsPfm(fileData, size))
+                return keep ? decode(Netpbm::Info, Netpbm::DecodeNative, *native)
+                            : decode(Netpbm::Info, Netpbm::Decode, Rgba8);
+
+            if (size > INT_MAX)
+                throw __Image_Ex__("file too large: ", size);
+            const auto len = static_cast<int>(size);
+            if (keep && native->Sample == SampleType::U16)
+                data = reinterpret_cast<uint8_t *>(stbi_load_16_from_memory(fileData, len, &width, &height, nullptr, native->Channels));
+            else
+                data = stbi_load_from_memory(fileData, len, &width, &height, nullptr, keep ? native->Channels : 4);
+            autoFree = true;
             if (!data)
                 throw __Image_Ex__("invalid data: \"", stbi_failure_reason(), "\"");
+            format = keep ? *native : Rgba8;
         }
 
-        void Save(const std::filesystem::path &path) const
+        // mips is the chain below this image, only formats that store one use it
+        void Save(const std::filesystem::path &path, const SaveOptions &opt = {},
+                  const std::span<const ImageFile> mips = {}) const
         {
+            // the encoders all take 8 bit RGBA
+            if (format != Rgba8)
+                return Converted(Rgba8).Save(path, opt, mips);
+
             const auto ext = path.extension();
+            if (ext == ".dds")
+            {
+                std::vector<Dds::Surface> levels{{data, width, height}};
+                for (const auto &mip : mips)
+                    levels.push_back({mip.data, mip.width, mip.height});
+                Dds::Save(path, levels, opt.Dds);
+                return;
+            }
+
+            if (ext == ".png")
+            {
+                Png::Save(path, data, width, height, opt.Png);
+                return;
+            }
+
+            if (ext == ".jpg" || ext == ".jpeg" || ext == ".jpe")
+            {
+                Jpeg::Save(path, data, width, height, opt.Jpeg);
+                return;
+            }
+
+            if (ext == ".qoi")
+                return Qoi::Save(path, data, width, height);
+            if (ext == ".pam")
+                return Netpbm::SavePam(path, data, width, height);
+            if (ext == ".pfm")
+                return Netpbm::SavePfm(path, data, width, height);
+
 #define MakeData (const char *)path.u8string().c_str(), width, height, 4, data
             int ret;
-            if (ext == ".png")
-                ret = stbi_write_png(MakeData, width * 4);
-            else if (ext == ".jpg" || ext == ".jpeg" || ext == ".jpe")
-                ret = stbi_write_jpg(MakeData, 100);
-            else if (ext == ".bmp")
+            if (ext == ".bmp")
                 ret = stbi_write_bmp(MakeData);
             else if (ext == ".tga")
                 ret = stbi_write_tga(MakeData);
@@ -515,11 +1012,14 @@ namespace Image
         [[nodiscard]] uint8_t *Data() { return data; }
         [[nodiscard]] int Width() const { return width; }
         [[nodiscard]] int Height() const { return height; }
-        [[nodiscard]] size_t Size() const { return static_cast<size_t>(width) * height * 4; }
+        [[nodiscard]] size_t Size() const { return static_cast<size_t>(width) * height * format.PixelBytes(); }
+        [[nodiscard]] const PixelFormat &Format() const { return format; }
 
+        // At and Set are Rgba8 only
         template <typename T>
         [[nodiscard]] ColorRgba<T> At(const int64_t row, const int64_t col) const
         {
+            assert(format == Rgba8);
             const auto *p = data + (row * width + col) * 4;
             return ColorRgba<T>(p[0], p[1], p[2], p[3]);
         }
@@ -527,6 +1027,7 @@ namespace Image
         template <typename T>
         void Set(const int64_t row, const int64_t col, const ColorRgba<T> &val)
         {
+            assert(format == Rgba8);
             auto *bgra = data + (row * width + col) * 4;
             bgra[RIdx] = static_cast<uint8_t>(val.R);
             bgra[GIdx] = static_cast<uint8_t>(val.G);
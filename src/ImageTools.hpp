@@ -1,11 +1,21 @@
 #pragma once
 #include "Image.hpp"
 
+#include <algorithm>
 #include <array>
+#include <execution>
 #include <filesystem>
 #include <format>
+#include <memory>
+#include <mutex>
+#include <numbers>
+#include <numeric>
+#include <vector>
+
+#include <stb_image_resize.h>
 
 #include "CubeLUT.hpp"
+#include "Simd.hpp"
 
 #undef max
 #undef min
@@ -39,6 +49,40 @@ namespace ImageTools
         {
             return v ? T{1} : T{0};
         }
+
+        // planar float copy of a run of RGBA8 pixels for the SoA color kernels in Simd
+        struct RgbBlock
+        {
+            static constexpr size_t Size = 256;
+
+            float R[Size];
+            float G[Size];
+            float B[Size];
+
+            void Load(const uint8_t *src, const size_t n)
+            {
+                for (size_t i = 0; i < n; ++i, src += 4)
+                {
+                    R[i] = static_cast<float>(src[0]) / 255.f;
+                    G[i] = static_cast<float>(src[1]) / 255.f;
+                    B[i] = static_cast<float>(src[2]) / 255.f;
+                }
+            }
+
+            // same rounding as Image::FloatToUint8, alpha is taken from src
+            void Store(uint8_t *dst, const uint8_t *src, const size_t n) const
+            {
+                const auto cvt = [](const float v)
+                { return static_cast<uint8_t>(std::clamp(std::round(v * 255.f), 0.f, 255.f)); };
+                for (size_t i = 0; i < n; ++i, dst += 4, src += 4)
+                {
+                    dst[0] = cvt(R[i]);
+                    dst[1] = cvt(G[i]);
+                    dst[2] = cvt(B[i]);
+                    dst[3] = src[3];
+                }
+            }
+        };
     }
 
     struct ImageSize
@@ -60,15 +104,25 @@ namespace ImageTools
                 "ImageTools::Exception",                             \
                 std::format(fmt, __VA_ARGS__)))
 
+    // A processor is constructed once per batch: the constructor does all the
+    // image independent work and keeps heavy results in shared immutable state,
+    // so copies are cheap. Each image then gets its own copy and Bind.
+    // Bind gets Rgba8 images; a tool that reads other pixel formats itself says
+    // so with its own Accepts, the caller converts the rest.
     template <typename Impl>
     class ITool
     {
     public:
         const Image::ImageFile *_ImgRef = nullptr;
 
-        void ImgRef(const Image::ImageFile &img)
+        [[nodiscard]] bool Accepts(const Image::PixelFormat &format) const
         {
-            static_cast<Impl *>(this)->ImgRef(img);
+            return format == Image::Rgba8;
+        }
+
+        void Bind(const Image::ImageFile &img)
+        {
+            static_cast<Impl *>(this)->Bind(img);
         }
 
         [[nodiscard]] ImageSize GetOutputSize() const
@@ -82,9 +136,32 @@ namespace ImageTools
         }
     };
 
+    // Fills one output row (GetOutputSize().Width RGBA pixels). Tools that can
+    // work on whole rows provide ProcessRow(row, dst), the rest go pixel by pixel.
+    template <typename Tool>
+    void ProcessRow(Tool &tool, const int64_t row, uint8_t *dst)
+    {
+        if constexpr (requires { tool.ProcessRow(row, dst); })
+        {
+            tool.ProcessRow(row, dst);
+        }
+        else
+        {
+            const auto width = tool.GetOutputSize().Width;
+            for (int64_t col = 0; col < width; ++col, dst += 4)
+            {
+                const auto [r, g, b, a] = tool(row, col);
+                dst[0] = r;
+                dst[1] = g;
+                dst[2] = b;
+                dst[3] = a;
+            }
+        }
+    }
+
     class LUT : public ITool<LUT>
     {
-        Lut::CubeLut lutData;
+        std::shared_ptr<const Lut::CubeLut> lutData;
 
         Lut::CubeLut::Row dMax;
         Lut::CubeLut::Row dMin;
@@ -136,14 +213,21 @@ namespace ImageTools
         }
 
     public:
-        LUT(const std::filesystem::path &cube) : lutData(Lut::CubeLut::FromCubeFile(cube))
+        LUT(std::shared_ptr<const Lut::CubeLut> cube) : lutData(std::move(cube))
+        {
+            dMin = lutData->DomainMin;
+            dMax = lutData->DomainMax;
+            size = static_cast<float>(lutData->Length());
+        }
+
+        LUT(const std::filesystem::path &cube) : LUT(Load(cube)) {}
+
+        static std::shared_ptr<const Lut::CubeLut> Load(const std::filesystem::path &cube)
         {
-            dMin = lutData.DomainMin;
-            dMax = lutData.DomainMax;
-            size = static_cast<float>(lutData.Length());
+            return std::make_shared<const Lut::CubeLut>(Lut::CubeLut::FromCubeFile(cube));
         }
 
-        void ImgRef(const Image::ImageFile &img) { _ImgRef = &img; }
+        void Bind(const Image::ImageFile &img) { _ImgRef = &img; }
 
         ImageSize GetOutputSize() const { return {_ImgRef->Width(), _ImgRef->Height()}; }
 
@@ -164,7 +248,7 @@ namespace ImageTools
             gi = std::clamp<float>(gi, 0.f, size - 1.f);
             bi = std::clamp<float>(bi, 0.f, size - 1.f);
 
-            const auto &nBgr = LookUp(lutData, bi, gi, ri);
+            const auto &nBgr = LookUp(*lutData, bi, gi, ri);
 
             return Image::ColorRgba<uint8_t>(Image::FloatToUint8({nBgr.R, nBgr.G, nBgr.B}), aiR);
         }
@@ -182,7 +266,7 @@ namespace ImageTools
     public:
         LinearDodgeColor(Image::ColorRgba<uint8_t> color) : color(std::move(color)) {}
 
-        void ImgRef(const Image::ImageFile &img) { _ImgRef = &img; }
+        void Bind(const Image::ImageFile &img) { _ImgRef = &img; }
 
         ImageSize GetOutputSize() const { return {_ImgRef->Width(), _ImgRef->Height()}; }
 
@@ -193,11 +277,70 @@ namespace ImageTools
 
             return Image::ColorRgba(ClampAdd(r0, r1), ClampAdd(g0, g1), ClampAdd(b0, b1), ClampAdd(a0, a1)).StaticCast<uint8_t>();
         }
+
+        void ProcessRow(const int64_t row, uint8_t *dst) const
+        {
+            const auto stride = static_cast<size_t>(_ImgRef->Width()) * 4;
+            const uint8_t rgba[4] = {color.R, color.G, color.B, color.A};
+            Simd::AddSaturateColor(_ImgRef->Data() + row * stride, rgba, dst, stride);
+        }
+    };
+
+    // An image decoded once plus resampled copies of it, made on first request
+    // for each size and shared by every processor holding it. Only the last few
+    // sizes are kept, a batch of mixed sizes would otherwise keep one per size.
+    class ResampledImage
+    {
+        static constexpr size_t MaxSizes = 4;
+
+        struct Entry
+        {
+            int Width;
+            int Height;
+            std::shared_ptr<const Image::ImageFile> Image;
+        };
+
+        std::shared_ptr<const Image::ImageFile> source;
+
+        mutable std::mutex mtx{};
+        // most recently used first
+        mutable std::vector<Entry> sizes{};
+
+    public:
+        explicit ResampledImage(std::shared_ptr<const Image::ImageFile> source) : source(std::move(source)) {}
+
+        [[nodiscard]] const Image::ImageFile &Source() const { return *source; }
+
+        [[nodiscard]] std::shared_ptr<const Image::ImageFile> At(const int width, const int height) const
+        {
+            if (source->Width() == width && source->Height() == height)
+                return source;
+
+            std::lock_guard lock(mtx);
+            const auto it = std::find_if(sizes.begin(), sizes.end(), [&](const Entry &e)
+                                         { return e.Width == width && e.Height == height; });
+            if (it != sizes.end())
+            {
+                std::rotate(sizes.begin(), it, it + 1);
+                return sizes.front().Image;
+            }
+
+            Image::ImageFile buf(width, height);
+            if (!stbir_resize_uint8(source->Data(), source->Width(), source->Height(), 0,
+                                    buf.Data(), width, height, 0, 4))
+                throw __Image_Tools_Ex__("resize overlay to {}x{} failed", width, height);
+
+            if (sizes.size() == MaxSizes)
+                sizes.pop_back();
+            sizes.insert(sizes.begin(), Entry{width, height, std::make_shared<const Image::ImageFile>(std::move(buf))});
+            return sizes.front().Image;
+        }
     };
 
     class LinearDodgeImage : public ITool<LinearDodgeImage>
     {
-        Image::ImageFile image;
+        std::shared_ptr<const ResampledImage> overlay;
+        std::shared_ptr<const Image::ImageFile> image{};
 
         static int16_t ClampAdd(const int16_t x, const int16_t y)
         {
@@ -205,19 +348,32 @@ namespace ImageTools
         }
 
     public:
-        LinearDodgeImage(Image::ImageFile image) : image(std::move(image)) {}
+        LinearDodgeImage(std::shared_ptr<const ResampledImage> overlay) : overlay(std::move(overlay)) {}
+        LinearDodgeImage(Image::ImageFile image)
+            : overlay(std::make_shared<const ResampledImage>(std::make_shared<const Image::ImageFile>(std::move(image)))) {}
 
-        void ImgRef(const Image::ImageFile &img) { _ImgRef = &img; }
+        // the overlay is stretched over the whole image
+        void Bind(const Image::ImageFile &img)
+        {
+            _ImgRef = &img;
+            image = overlay->At(img.Width(), img.Height());
+        }
 
         ImageSize GetOutputSize() const { return {_ImgRef->Width(), _ImgRef->Height()}; }
 
         Image::ColorRgba<uint8_t> operator()(const int64_t row, const int64_t col) const
         {
             const auto [r0, g0, b0, a0] = _ImgRef->At<uint8_t>(row, col);
-            const auto [r1, g1, b1, a1] = image.At<int16_t>(row, col);
+            const auto [r1, g1, b1, a1] = image->At<int16_t>(row, col);
 
             return Image::ColorRgba(ClampAdd(r0, r1), ClampAdd(g0, g1), ClampAdd(b0, b1), ClampAdd(a0, a1)).StaticCast<uint8_t>();
         }
+
+        void ProcessRow(const int64_t row, uint8_t *dst) const
+        {
+            const auto stride = static_cast<size_t>(_ImgRef->Width()) * 4;
+            Simd::AddSaturate(_ImgRef->Data() + row * stride, image->Data() + row * stride, dst, stride);
+        }
     };
 
     template <typename T>
@@ -304,57 +460,343 @@ namespace ImageTools
         }
     };
 
+    // Normals from a height channel. The gradient operator is separable: a
+    // derivative along one axis times a smoothing across it. Each output row
+    // reads its 2 * radius + 1 input rows once, whatever the operator.
     class GenerateNormalTexture : public ITool<GenerateNormalTexture>
     {
+    public:
+        enum class Operator
+        {
+            Central,
+            Prewitt,
+            Sobel,
+            Scharr,
+            Sobel5x5
+        };
+
+        enum class Channel
+        {
+            R,
+            G,
+            B,
+            A,
+            Luma
+        };
+
+        static constexpr int MaxRadius = 2;
+
+        // taps from -Radius to Radius, normalized so every operator reports slope per pixel
+        struct Kernel
+        {
+            using Taps = std::array<float, 2 * MaxRadius + 1>;
+
+            int Radius = 1;
+            Taps Smooth{};
+            Taps Deriv{};
+
+            static Kernel Of(const Operator op)
+            {
+                switch (op)
+                {
+                case Operator::Prewitt:
+                    return Make(1, {1, 1, 1}, {-1, 0, 1});
+                case Operator::Sobel:
+                    return Make(1, {1, 2, 1}, {-1, 0, 1});
+                case Operator::Scharr:
+                    return Make(1, {3, 10, 3}, {-1, 0, 1});
+                case Operator::Sobel5x5:
+                    return Make(2, {1, 4, 6, 4, 1}, {-1, -2, 0, 2, 1});
+                case Operator::Central:
+                default:
+                    return Make(1, {0, 1, 0}, {-1, 0, 1});
+                }
+            }
+
+        private:
+            static Kernel Make(const int radius, const std::initializer_list<float> smooth, const std::initializer_list<float> deriv)
+            {
+                Kernel k{radius};
+                std::ranges::copy(smooth, k.Smooth.begin());
+                std::ranges::copy(deriv, k.Deriv.begin());
+
+                float sum = 0, gain = 0;
+                for (int i = 0; i <= 2 * radius; ++i)
+                {
+                    sum += k.Smooth[i];
+                    gain += static_cast<float>(i - radius) * k.Deriv[i];
+                }
+                for (auto &v : k.Deriv)
+                    v /= gain;
+                for (auto &v : k.Smooth)
+                    v /= sum;
+                return k;
+            }
+        };
+
+        // height = dot(weights, rgba), rgba in [0, 1]
+        static std::array<float, 4> WeightsOf(const Channel channel)
+        {
+            switch (channel)
+            {
+            case Channel::G:
+                return {0, 1, 0, 0};
+            case Channel::B:
+                return {0, 0, 1, 0};
+            case Channel::A:
+                return {0, 0, 0, 1};
+            case Channel::Luma:
+                return {0.2126f, 0.7152f, 0.0722f, 0};
+            case Channel::R:
+            default:
+                return {1, 0, 0, 0};
+            }
+        }
+
+    private:
+        static constexpr int64_t SpanSize = 256;
+
         float bias = 50.;
         bool invertR = false;
         bool invertG = false;
+        Kernel kernel = Kernel::Of(Operator::Central);
+        std::array<float, 4> weights = WeightsOf(Channel::R);
+        int channel = 0; // byte offset of a single channel height, -1 for weighted
 
-        Sampler<float> smp = Sampler<float>(Image::ImageFile{});
+        [[nodiscard]] float Dz() const { return 1.f - ((bias - 0.1f) / 100.f); }
 
-    public:
-        GenerateNormalTexture(const float bias = 50., const bool invertR = false, const bool invertG = false) : bias(bias), invertR(invertR), invertG(invertG) {}
+        [[nodiscard]] bool IsRgba8() const { return _ImgRef->Format() == Image::Rgba8; }
 
-        void ImgRef(const Image::ImageFile &img)
+        // n <= SpanSize + 2 * MaxRadius pixels
+        void LoadHeights(const uint8_t *px, const int64_t n, float *out) const
+        {
+            if (!IsRgba8())
+            {
+                float rgba[(SpanSize + 2 * MaxRadius) * 4];
+                Image::__Detail::LoadPixels(px, _ImgRef->Format(), static_cast<size_t>(n), rgba);
+                const auto w = weights;
+                for (int64_t j = 0; j < n; ++j)
+                {
+                    const auto p = rgba + j * 4;
+                    out[j] = channel < 0 ? w[0] * p[0] + w[1] * p[1] + w[2] * p[2] + w[3] * p[3] : p[channel];
+                }
+                return;
+            }
+            if (channel < 0)
+            {
+                const auto w = weights;
+                for (int64_t j = 0; j < n; ++j, px += 4)
+                    out[j] = (w[0] * px[0] + w[1] * px[1] + w[2] * px[2] + w[3] * px[3]) / 255.f;
+            }
+            else
+            {
+                Simd::ChannelToFloat(px, channel, 1.f / 255.f, out, static_cast<size_t>(n));
+            }
+        }
+
+        // n <= SpanSize pixels starting at (row, col)
+        void ProcessSpan(const int64_t row, const int64_t col, const int64_t n, uint8_t *dst) const
+        {
+            constexpr auto cache = SpanSize + 2 * MaxRadius;
+            const int64_t width = _ImgRef->Width(), height = _ImgRef->Height();
+            const auto data = _ImgRef->Data();
+            const auto bytes = static_cast<int64_t>(_ImgRef->Format().PixelBytes());
+            const auto r = kernel.Radius;
+            const auto taps = 2 * r + 1;
+            const auto wide = n + 2 * r;
+
+            // heights of the rows around this one, edges clamped like the GPU sampler
+            float rows[2 * MaxRadius + 1][cache];
+            const auto first = col - r;
+            const auto lo = std::max<int64_t>(first, 0) - first;
+            const auto hi = std::min<int64_t>(first + wide, width) - first;
+            for (int k = 0; k < taps; ++k)
+            {
+                const auto src = data + std::clamp<int64_t>(row + k - r, 0, height - 1) * width * bytes;
+                LoadHeights(src + (first + lo) * bytes, hi - lo, rows[k] + lo);
+                std::fill(rows[k], rows[k] + lo, rows[k][lo]);
+                std::fill(rows[k] + hi, rows[k] + wide, rows[k][hi - 1]);
+            }
+
+            // vertical pass: smoothed heights and their derivative down the rows
+            float smooth[cache], deriv[cache];
+            std::fill_n(smooth, wide, 0.f);
+            std::fill_n(deriv, wide, 0.f);
+            for (int k = 0; k < taps; ++k)
+            {
+                if (kernel.Smooth[k] != 0.f)
+                    Simd::Axpy(smooth, rows[k], kernel.Smooth[k], static_cast<size_t>(wide));
+                if (kernel.Deriv[k] != 0.f)
+                    Simd::Axpy(deriv, rows[k], kernel.Deriv[k], static_cast<size_t>(wide));
+            }
+
+            // horizontal pass, dx follows the rows and dy the columns
+            float dx[SpanSize], dy[SpanSize];
+            std::fill_n(dx, n, 0.f);
+            std::fill_n(dy, n, 0.f);
+            const auto sr = invertR ? -1.f : 1.f, sg = invertG ? -1.f : 1.f;
+            for (int k = 0; k < taps; ++k)
+            {
+                if (kernel.Smooth[k] != 0.f)
+                    Simd::Axpy(dx, deriv + k, sr * kernel.Smooth[k], static_cast<size_t>(n));
+                if (kernel.Deriv[k] != 0.f)
+                    Simd::Axpy(dy, smooth + k, sg * kernel.Deriv[k], static_cast<size_t>(n));
+            }
+
+            // alpha is carried over, from an Rgba8 copy of the span for other formats
+            const auto src = data + (row * width + col) * bytes;
+            if (IsRgba8())
+                return Simd::PackNormals(dx, dy, Dz(), src, dst, static_cast<size_t>(n));
+            float rgba[SpanSize * 4];
+            uint8_t alpha[SpanSize * 4];
+            Image::__Detail::LoadPixels(src, _ImgRef->Format(), static_cast<size_t>(n), rgba);
+            Image::__Detail::StorePixels(rgba, static_cast<size_t>(n), Image::Rgba8, alpha);
+            Simd::PackNormals(dx, dy, Dz(), alpha, dst, static_cast<size_t>(n));
+        }
+
+    public:
+        GenerateNormalTexture(const float bias = 50., const bool invertR = false, const bool invertG = false,
+                              const Operator op = Operator::Central, const Channel channel = Channel::R)
+            : bias(bias), invertR(invertR), invertG(invertG), kernel(Kernel::Of(op)), weights(WeightsOf(channel)),
+              channel(channel == Channel::Luma ? -1 : static_cast<int>(channel))
         {
-            _ImgRef = &img;
-            smp = Sampler<float>(*_ImgRef);
         }
 
+        // heights are read from any channel count and sample type, e.g. a 16 bit gray height map
+        [[nodiscard]] bool Accepts(const Image::PixelFormat &) const { return true; }
+
+        void Bind(const Image::ImageFile &img) { _ImgRef = &img; }
+
         ImageSize GetOutputSize() const { return {_ImgRef->Width(), _ImgRef->Height()}; }
 
         Image::ColorRgba<uint8_t> operator()(const int64_t row, const int64_t col) const
         {
-            const int64_t xi = row;
-            const int64_t yi = col;
+            uint8_t px[4];
+            ProcessSpan(row, col, 1, px);
+            return Image::ColorRgba<uint8_t>(px[0], px[1], px[2], px[3]);
+        }
 
-            const float x = static_cast<float>(xi) / (smp.GetImg().Height() - 1);
-            const float y = static_cast<float>(yi) / (smp.GetImg().Width() - 1);
+        void ProcessRow(const int64_t row, uint8_t *dst) const
+        {
+            const int64_t width = _ImgRef->Width();
+            for (int64_t x = 0; x < width; x += SpanSize)
+                ProcessSpan(row, x, std::min(SpanSize, width - x), dst + x * 4);
+        }
+    };
 
-            const float d0 = smp(x, y).R;
-            const float d1 = smp(x - smp.GetStepRow(), y).R;
-            const float d2 = smp(x + smp.GetStepRow(), y).R;
-            const float d3 = smp(x, y - smp.GetStepCol()).R;
-            const float d4 = smp(x, y + smp.GetStepCol()).R;
+    // Builds every output channel from an input channel or a constant, e.g. to pack
+    // masks into one texture. Plain mappings are a single byte shuffle per row;
+    // NormalZ rebuilds the z of a unit normal from the output's red and green.
+    class ChannelSwizzle : public ITool<ChannelSwizzle>
+    {
+    public:
+        enum class Source
+        {
+            R = 0,
+            G = 1,
+            B = 2,
+            A = 3,
+            Zero = 4,
+            One = 5,
+            NormalZ = 6
+        };
 
-            float dx = ((d2 - d0) + (d0 - d1)) * 0.5f;
-            float dy = ((d4 - d0) + (d0 - d3)) * 0.5f;
+        using Mapping = std::array<Source, 4>;
 
-            dx = dx * (invertR ? -1.f : 1.f);
-            dy = dy * (invertG ? -1.f : 1.f);
-            float dz = 1.f - ((bias - 0.1f) / 100.f);
+    private:
+        uint8_t order[4]{};
+        uint32_t fill = 0;
+        uint8_t normalZ = 0;
 
-            const float len = std::sqrt(dx * dx + dy * dy + dz * dz);
+        // z = sqrt(1 - x^2 - y^2) for every (x, y) byte pair, indexed by x | y << 8
+        static const std::array<uint8_t, 256 * 256> &NormalZTable()
+        {
+            static const auto table = []
+            {
+                std::array<uint8_t, 256 * 256> tab{};
+                for (int y = 0; y < 256; ++y)
+                {
+                    const auto fy = (static_cast<float>(y) - 127.5f) / 127.5f;
+                    for (int x = 0; x < 256; ++x)
+                    {
+                        const auto fx = (static_cast<float>(x) - 127.5f) / 127.5f;
+                        const auto z = std::sqrt(std::max(0.f, 1.f - fx * fx - fy * fy));
+                        tab[x | y << 8] = static_cast<uint8_t>(std::round(z * 127.5f + 127.5f));
+                    }
+                }
+                return tab;
+            }();
+            return table;
+        }
 
-            dx = (dx / len) * 0.5f + 0.5f;
-            dy = (dy / len) * 0.5f + 0.5f;
-            dz = (dz / len) * 0.5f + 0.5f;
+        void RebuildZ(uint8_t *px, const int64_t n) const
+        {
+            if (!normalZ)
+                return;
+            const auto &tab = NormalZTable();
+            for (int64_t i = 0; i < n; ++i, px += 4)
+            {
+                const auto z = tab[px[0] | px[1] << 8];
+                for (int c = 0; c < 4; ++c)
+                    if (normalZ & 1 << c)
+                        px[c] = z;
+            }
+        }
+
+    public:
+        explicit ChannelSwizzle(const Mapping &mapping)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                switch (mapping[c])
+                {
+                case Source::R:
+                case Source::G:
+                case Source::B:
+                case Source::A:
+                    order[c] = static_cast<uint8_t>(mapping[c]);
+                    break;
+                case Source::Zero:
+                    order[c] = 4;
+                    break;
+                case Source::One:
+                    order[c] = 4;
+                    fill |= 0xffu << c * 8;
+                    break;
+                case Source::NormalZ:
+                    order[c] = 4;
+                    normalZ |= static_cast<uint8_t>(1 << c);
+                    break;
+                default:
+                    throw __Image_Tools_Ex__("invalid channel source: {}", static_cast<int>(mapping[c]));
+                }
+            }
+            if (normalZ)
+                NormalZTable();
+        }
+
+        void Bind(const Image::ImageFile &img) { _ImgRef = &img; }
 
-            return Image::ColorRgba(Image::FloatToUint8({dx, dy, dz}), _ImgRef->At<uint8_t>(row, col).A);
+        ImageSize GetOutputSize() const { return {_ImgRef->Width(), _ImgRef->Height()}; }
+
+        Image::ColorRgba<uint8_t> operator()(const int64_t row, const int64_t col) const
+        {
+            uint8_t px[4];
+            Simd::Swizzle(_ImgRef->Data() + (row * _ImgRef->Width() + col) * 4, order, fill, px, 1);
+            RebuildZ(px, 1);
+            return Image::ColorRgba<uint8_t>(px[0], px[1], px[2], px[3]);
+        }
+
+        void ProcessRow(const int64_t row, uint8_t *dst) const
+        {
+            const int64_t width = _ImgRef->Width();
+            Simd::Swizzle(_ImgRef->Data() + row * width * 4, order, fill, dst, width);
+            RebuildZ(dst, width);
         }
     };
 
-    class NormalMapConvert : public ITool<NormalMapConvert>
+    // RGB normals <-> DA (DXT5nm style: x in alpha, y in green) as channel swizzles
+    class NormalMapConvert : public ChannelSwizzle
     {
     public:
         enum class Format
@@ -363,30 +805,453 @@ namespace ImageTools
             DA = 1
         };
 
+        static Mapping MappingOf(const Format &in, const Format &out)
+        {
+            using S = Source;
+            if (in == Format::RGB && out == Format::DA)
+                return {S::G, S::G, S::G, S::R};
+            if (in == Format::DA && out == Format::RGB)
+                return {S::A, S::G, S::NormalZ, S::One};
+            return {S::R, S::G, S::B, S::A};
+        }
+
+        NormalMapConvert(const Format &in, const Format &out) : ChannelSwizzle(MappingOf(in, out)) {}
+    };
+    // Separable resampler to any size. A row is the vertical pass over the source
+    // rows it needs into a float row, then the horizontal pass into the output, both
+    // driven by coefficient tables built in Bind, so rows are independent and the
+    // caller's parallel row loop does the threading.
+    class Resample : public ITool<Resample>
+    {
+    public:
+        enum class Filter
+        {
+            Box,
+            Triangle,
+            Bicubic,
+            Lanczos3,
+            Kaiser
+        };
+
+        // taps of every output pixel of one axis, start is clamped so that
+        // start + Taps never leaves the source, edge pixels take the weights
+        // of the taps beyond them
+        struct Coefficients
+        {
+            static constexpr int32_t FixedOne = 1 << 14;
+
+            int Taps = 0;
+            std::vector<int32_t> Start{};
+            std::vector<float> Weights{};
+
+            // the weights in 2.14 fixed point, every output summing to exactly
+            // FixedOne, packed two per int32 for pmaddwd; FixedAbsSum is the
+            // largest sum of |weight| and bounds the overshoot
+            std::vector<int32_t> FixedPairs{};
+            int32_t FixedAbsSum = 0;
+
+            static Coefficients Of(Filter filter, int64_t in, int64_t out);
+        };
+
+        static double RadiusOf(const Filter filter)
+        {
+            switch (filter)
+            {
+            case Filter::Box:
+                return .5;
+            case Filter::Triangle:
+                return 1.;
+            case Filter::Bicubic:
+                return 2.;
+            case Filter::Lanczos3:
+            case Filter::Kaiser:
+                return 3.;
+            default:
+                throw __Image_Tools_Ex__("invalid filter: {}", static_cast<int>(filter));
+            }
+        }
+
+        // Bicubic is Catmull-Rom (Keys, a = -0.5), Kaiser a sinc under a Kaiser
+        // window (alpha 4) of the same width as Lanczos3, the usual mip filter
+        static double Kernel(const Filter filter, const double x)
+        {
+            constexpr auto pi = std::numbers::pi;
+            const auto ax = std::abs(x);
+            switch (filter)
+            {
+            case Filter::Box:
+                return x >= -.5 && x < .5 ? 1. : 0.;
+            case Filter::Triangle:
+                return std::max(0., 1. - ax);
+            case Filter::Bicubic:
+                if (ax < 1.)
+                    return (1.5 * ax - 2.5) * ax * ax + 1.;
+                if (ax < 2.)
+                    return ((-.5 * ax + 2.5) * ax - 4.) * ax + 2.;
+                return 0.;
+            case Filter::Lanczos3:
+                if (ax < 1e-8)
+                    return 1.;
+                if (ax < 3.)
+                    return 3. * std::sin(pi * x) * std::sin(pi * x / 3.) / (pi * pi * x * x);
+                return 0.;
+            case Filter::Kaiser:
+            {
+                if (ax >= 3.)
+                    return 0.;
+                static const auto i0 = std::cyl_bessel_i(0., 4.);
+                const auto t = ax / 3.;
+                const auto window = std::cyl_bessel_i(0., 4. * std::sqrt(1. - t * t)) / i0;
+                return ax < 1e-8 ? window : window * std::sin(pi * x) / (pi * x);
+            }
+            default:
+                throw __Image_Tools_Ex__("invalid filter: {}", static_cast<int>(filter));
+            }
+        }
+
     private:
-        Format input;
-        Format output;
+        Filter filter = Filter::Lanczos3;
+        int width = 0;
+        int height = 0;
+        double scale = 0;
+
+        ImageSize outputSize{};
+        Coefficients horizontal{};
+        Coefficients vertical{};
+        bool fixedPoint = false;
 
     public:
-        NormalMapConvert(const Format &in, const Format &out) : input(in), output(out) {}
+        // a 0 side follows the aspect ratio of the input, both 0 keep its size
+        Resample(const Filter filter, const int width, const int height)
+            : filter(filter), width(width), height(height)
+        {
+            if (width < 0 || height < 0)
+                throw __Image_Tools_Ex__("invalid size: {}x{}", width, height);
+        }
+
+        Resample(const Filter filter, const double scale) : filter(filter), scale(scale)
+        {
+            if (!(scale > 0))
+                throw __Image_Tools_Ex__("invalid scale: {}", scale);
+        }
 
-        void ImgRef(const Image::ImageFile &img) { _ImgRef = &img; }
+        [[nodiscard]] ImageSize OutputSizeOf(const ImageSize &input) const
+        {
+            const auto round = [](const double v)
+            { return static_cast<int>(std::max<long long>(1, std::llround(v))); };
+
+            if (scale > 0)
+                return {round(input.Width * scale), round(input.Height * scale)};
+            if (width && height)
+                return {width, height};
+            if (width)
+                return {width, round(static_cast<double>(input.Height) * width / input.Width)};
+            if (height)
+                return {round(static_cast<double>(input.Width) * height / input.Height), height};
+            return input;
+        }
 
-        ImageSize GetOutputSize() const { return {_ImgRef->Width(), _ImgRef->Height()}; }
+        void Bind(const Image::ImageFile &img)
+        {
+            _ImgRef = &img;
+            outputSize = OutputSizeOf({img.Width(), img.Height()});
+            horizontal = Coefficients::Of(filter, img.Width(), outputSize.Width);
+            vertical = Coefficients::Of(filter, img.Height(), outputSize.Height);
+
+            // the 9.6 int16 row between the passes holds 2x the byte range, the
+            // int32 sums of the horizontal pass a bit under 4x of that
+            fixedPoint = vertical.FixedAbsSum < 2 * Coefficients::FixedOne &&
+                         horizontal.FixedAbsSum < 3 * Coefficients::FixedOne;
+        }
+
+        [[nodiscard]] ImageSize GetOutputSize() const { return outputSize; }
+
+        // output row reads source rows below this one only, i.e. it can be made
+        // once that many source rows exist
+        [[nodiscard]] int64_t SourceRowsFor(const int64_t row) const
+        {
+            return vertical.Start[row] + vertical.Taps;
+        }
 
         Image::ColorRgba<uint8_t> operator()(const int64_t row, const int64_t col) const
         {
-            const auto color = _ImgRef->At<uint8_t>(row, col);
-            if (input == output)
-                return color;
-            if (input == Format::RGB && output == Format::DA)
+            const auto data = _ImgRef->Data();
+            const auto stride = static_cast<size_t>(_ImgRef->Width()) * 4;
+            float acc[4]{};
+            for (int ky = 0; ky < vertical.Taps; ++ky)
+            {
+                const auto wy = vertical.Weights[row * vertical.Taps + ky];
+                const auto src = data + (vertical.Start[row] + ky) * stride + horizontal.Start[col] * 4;
+                for (int kx = 0; kx < horizontal.Taps; ++kx)
+                {
+                    const auto w = wy * horizontal.Weights[col * horizontal.Taps + kx];
+                    for (int c = 0; c < 4; ++c)
+                        acc[c] += w * src[kx * 4 + c];
+                }
+            }
+            uint8_t px[4];
+            for (int c = 0; c < 4; ++c)
+                px[c] = static_cast<uint8_t>(std::clamp(std::nearbyint(acc[c]), 0.f, 255.f));
+            return Image::ColorRgba<uint8_t>(px[0], px[1], px[2], px[3]);
+        }
+
+        // 8-bit in and out, so the integer path unless its headroom is exceeded
+        void ProcessRow(const int64_t row, uint8_t *dst) const
+        {
+            const auto n = static_cast<size_t>(_ImgRef->Width()) * 4;
+            const auto src = _ImgRef->Data() + vertical.Start[row] * n;
+
+            if (fixedPoint)
+            {
+                // one spare zero pixel, an odd tap count reads a pair past the last tap
+                thread_local std::vector<int16_t> fixedLine{};
+                fixedLine.resize(n + 4);
+                std::fill_n(fixedLine.data() + n, 4, int16_t{0});
+                Simd::FilterRowsFixed(src, n, vertical.FixedPairs.data() + row * ((vertical.Taps + 1) / 2),
+                                      vertical.Taps, fixedLine.data(), n);
+                Simd::ResampleRowFixed(fixedLine.data(), horizontal.Start.data(), horizontal.FixedPairs.data(),
+                                       horizontal.Taps, dst, static_cast<size_t>(outputSize.Width));
+                return;
+            }
+
+            thread_local std::vector<float> line{};
+            line.resize(n);
+            Simd::FilterRows(src, n, vertical.Weights.data() + row * vertical.Taps, vertical.Taps, line.data(), n);
+
+            Simd::ResampleRow(line.data(), horizontal.Start.data(), horizontal.Weights.data(), horizontal.Taps,
+                              dst, static_cast<size_t>(outputSize.Width));
+        }
+    };
+
+    inline Resample::Coefficients Resample::Coefficients::Of(const Filter filter, const int64_t in, const int64_t out)
+    {
+        // minifying stretches the kernel over 1 / scale source pixels
+        const auto scale = static_cast<double>(out) / static_cast<double>(in);
+        const auto stretch = std::max(1., 1. / scale);
+        const auto support = RadiusOf(filter) * stretch;
+
+        std::vector<int64_t> first(out);
+        std::vector<std::vector<double>> taps(out);
+        size_t maxTaps = 1;
+        for (int64_t x = 0; x < out; ++x)
+        {
+            const auto center = (static_cast<double>(x) + .5) / scale;
+            const auto lo = static_cast<int64_t>(std::floor(center - support - .5));
+            const auto hi = static_cast<int64_t>(std::ceil(center + support - .5));
+
+            const auto begin = std::clamp<int64_t>(lo, 0, in - 1);
+            auto &w = taps[x];
+            w.assign(std::clamp<int64_t>(hi, 0, in - 1) - begin + 1, 0.);
+            double sum = 0;
+            for (auto i = lo; i <= hi; ++i)
+            {
+                const auto v = Kernel(filter, (static_cast<double>(i) + .5 - center) / stretch);
+                w[std::clamp<int64_t>(i, 0, in - 1) - begin] += v;
+                sum += v;
+            }
+
+            if (sum == 0.)
             {
-                const auto [X, Y, Z, A] = color;
-                return Image::ColorRgba(Y, Y, Y, X);
+                // nothing under the kernel, take the nearest pixel
+                std::ranges::fill(w, 0.);
+                w[std::clamp<int64_t>(static_cast<int64_t>(center), 0, in - 1) - begin] = 1.;
+                sum = 1.;
             }
+            for (auto &v : w)
+                v /= sum;
+
+            auto b = w.begin(), e = w.end();
+            while (b + 1 < e && *b == 0.)
+                ++b;
+            while (e - 1 > b && *(e - 1) == 0.)
+                --e;
+            first[x] = begin + (b - w.begin());
+            w = std::vector<double>(b, e);
+            maxTaps = std::max(maxTaps, w.size());
+        }
+
+        Coefficients co{};
+        co.Taps = static_cast<int>(maxTaps);
+        co.Start.resize(out);
+        co.Weights.assign(out * maxTaps, 0.f);
+
+        const auto pairs = (maxTaps + 1) / 2;
+        co.FixedPairs.assign(out * pairs, 0);
+        std::vector<int32_t> fixed(pairs * 2);
+        for (int64_t x = 0; x < out; ++x)
+        {
+            const auto start = std::min<int64_t>(first[x], in - co.Taps);
+            const auto offset = first[x] - start;
+            co.Start[x] = static_cast<int32_t>(start);
+
+            std::ranges::fill(fixed, 0);
+            int32_t sum = 0;
+            for (size_t k = 0; k < taps[x].size(); ++k)
+            {
+                co.Weights[x * maxTaps + offset + k] = static_cast<float>(taps[x][k]);
+                fixed[offset + k] = static_cast<int32_t>(std::lround(taps[x][k] * FixedOne));
+                sum += fixed[offset + k];
+            }
+
+            // rounding leftovers go to the largest tap so flat areas stay exact
+            *std::ranges::max_element(fixed, {}, [](const int32_t v)
+                                      { return std::abs(v); }) += FixedOne - sum;
+
+            int32_t absSum = 0;
+            for (size_t j = 0; j < pairs; ++j)
+            {
+                co.FixedPairs[x * pairs + j] = static_cast<int32_t>(static_cast<uint16_t>(fixed[j * 2]) |
+                                                                    static_cast<uint32_t>(fixed[j * 2 + 1]) << 16);
+                absSum += std::abs(fixed[j * 2]) + std::abs(fixed[j * 2 + 1]);
+            }
+            co.FixedAbsSum = std::max(co.FixedAbsSum, absSum);
+        }
+        return co;
+    }
+
+    // A mip chain laid out as one image: the input on the left, every further
+    // level (half the size of the one before, down to 1x1 or the level limit)
+    // stacked top to bottom on its right.
+    class MipChain : public ITool<MipChain>
+    {
+    public:
+        using Filter = Resample::Filter;
+
+        // rows of the first level made per step of the cascade
+        static constexpr int64_t BandRows = 32;
+
+    private:
+        Filter filter = Filter::Box;
+        int maxLevels = 0;
+
+        std::vector<Image::ImageFile> levels{};
+        std::vector<int> offsets{};
+        ImageSize outputSize{};
+
+    public:
+        // maxLevels counts the levels below the input, 0 for a full chain
+        MipChain(const Filter filter, const int maxLevels = 0) : filter(filter), maxLevels(maxLevels)
+        {
+            if (maxLevels < 0)
+                throw __Image_Tools_Ex__("invalid level count: {}", maxLevels);
+        }
+
+        // D3D sizes: every level halves and rounds down, never below 1
+        static std::vector<ImageSize> LevelSizes(ImageSize size, const int maxLevels = 0)
+        {
+            std::vector<ImageSize> sizes{};
+            while ((size.Width > 1 || size.Height > 1) && (maxLevels == 0 || std::ssize(sizes) < maxLevels))
+            {
+                size = {std::max(1, size.Width / 2), std::max(1, size.Height / 2)};
+                sizes.push_back(size);
+            }
+            return sizes;
+        }
+
+        // Levels 1 ~ n of base, each reduced from the one before. The input is read
+        // once: the levels advance together band by band, so a level's rows are
+        // consumed by the next level while they are still in cache.
+        static std::vector<Image::ImageFile> Build(const Image::ImageFile &base, const Filter filter, const int maxLevels = 0)
+        {
+            std::vector<Image::ImageFile> out{};
+            std::vector<Resample> reducers{};
+            for (const auto &[w, h] : LevelSizes({base.Width(), base.Height()}, maxLevels))
+            {
+                out.emplace_back(w, h);
+                reducers.emplace_back(filter, w, h);
+            }
+            // an exact 2x box step is a plain 2x2 average, which has its own kernel
+            std::vector<bool> halve(out.size());
+            for (size_t k = 0; k < out.size(); ++k)
+            {
+                const auto &src = k == 0 ? base : out[k - 1];
+                reducers[k].Bind(src);
+                halve[k] = filter == Filter::Box && src.Width() == out[k].Width() * 2 && src.Height() == out[k].Height() * 2;
+            }
+
+            // makes every row of level k whose taps lie in the first `available` rows of
+            // the level above, returns how many rows level k has now
+            std::vector<int64_t> done(out.size(), 0);
+            const auto advance = [&](const size_t k, const int64_t available)
+            {
+                const auto height = static_cast<int64_t>(out[k].Height());
+                auto end = done[k];
+                while (end < height && reducers[k].SourceRowsFor(end) <= available)
+                    ++end;
+
+                const auto stride = static_cast<size_t>(out[k].Width()) * 4;
+                std::vector<int64_t> rows(end - done[k]);
+                std::iota(rows.begin(), rows.end(), done[k]);
+                std::for_each(std::execution::par_unseq, rows.begin(), rows.end(), [&](const int64_t row)
+                              {
+                                  const auto dst = out[k].Data() + row * stride;
+                                  if (!halve[k])
+                                      return reducers[k].ProcessRow(row, dst);
+                                  const auto src = (k == 0 ? base : out[k - 1]).Data() + row * stride * 4;
+                                  Simd::Halve(src, src + stride * 2, dst, out[k].Width()); });
+                return done[k] = end;
+            };
+
+            for (int64_t available = 0; available < base.Height();)
+            {
+                available = std::min<int64_t>(base.Height(), available + BandRows * 2);
+                auto rows = available;
+                for (size_t k = 0; k < out.size(); ++k)
+                    rows = advance(k, rows);
+            }
+            return out;
+        }
+
+        void Bind(const Image::ImageFile &img)
+        {
+            _ImgRef = &img;
+            levels = Build(img, filter, maxLevels);
+
+            offsets.clear();
+            int offset = 0;
+            for (const auto &level : levels)
+            {
+                offsets.push_back(offset);
+                offset += level.Height();
+            }
+            outputSize = {img.Width() + (levels.empty() ? 0 : levels[0].Width()), img.Height()};
+        }
+
+        [[nodiscard]] ImageSize GetOutputSize() const { return outputSize; }
+
+        Image::ColorRgba<uint8_t> operator()(const int64_t row, const int64_t col) const
+        {
+            if (col < _ImgRef->Width())
+                return _ImgRef->At<uint8_t>(row, col);
+
+            const auto x = col - _ImgRef->Width();
+            for (size_t k = 0; k < levels.size(); ++k)
+                if (row >= offsets[k] && row < offsets[k] + levels[k].Height())
+                    return x < levels[k].Width() ? levels[k].At<uint8_t>(row - offsets[k], x) : Image::ColorRgba<uint8_t>(0);
             return Image::ColorRgba<uint8_t>(0);
         }
+
+        void ProcessRow(const int64_t row, uint8_t *dst) const
+        {
+            const auto width = static_cast<size_t>(_ImgRef->Width()) * 4;
+            std::copy_n(_ImgRef->Data() + row * width, width, dst);
+
+            auto right = dst + width;
+            const auto rightWidth = static_cast<size_t>(outputSize.Width) * 4 - width;
+            size_t copied = 0;
+            for (size_t k = 0; k < levels.size(); ++k)
+            {
+                if (row >= offsets[k] && row < offsets[k] + levels[k].Height())
+                {
+                    copied = static_cast<size_t>(levels[k].Width()) * 4;
+                    std::copy_n(levels[k].Data() + (row - offsets[k]) * copied, copied, right);
+                    break;
+                }
+            }
+            std::fill(right + copied, right + rightWidth, uint8_t{0});
+        }
     };
+
 #if 0
     class ColorBalance : ITool<ColorBalance>
     {
@@ -440,7 +1305,7 @@ namespace ImageTools
         {
         }
 
-        void ImgRef(const Image::ImageFile &img) { _ImgRef = &img; }
+        void Bind(const Image::ImageFile &img) { _ImgRef = &img; }
 
         ImageSize GetOutputSize() const { return {_ImgRef->Width(), _ImgRef->Height()}; }
 
@@ -483,70 +1348,110 @@ namespace ImageTools
             Highlights = 2
         };
 
+        // adjustments of one range, each -100 ~ 100
+        struct Balance
+        {
+            float CyanRed = 0;
+            float MagentaGreen = 0;
+            float YellowBlue = 0;
+        };
+
     private:
-        Range AdjRange = Range::Midtones;
-        float CyanRed = 0;
-        float MagentaGreen = 0;
-        float YellowBlue = 0;
         bool PreserveLuminosity = true;
 
-        std::array<float, 3> gamma;
+        // each channel's curve only depends on that channel's byte, so it is
+        // tabulated once: as float for the luminosity step and as final bytes
+        std::array<std::array<float, 256>, 3> curve{};
+        std::array<std::array<uint8_t, 256>, 3> table{};
 
-    public:
-        ColorBalance(const Range range,
-                     const float cyanRed,      // -100 ~ 100
-                     const float magentaGreen, // -100 ~ 100
-                     const float yellowBlue,   // -100 ~ 100
-                     const bool preserveLuminosity) : AdjRange(range),
-                                                      CyanRed(cyanRed),
-                                                      MagentaGreen(magentaGreen),
-                                                      YellowBlue(yellowBlue),
-                                                      PreserveLuminosity(preserveLuminosity)
+        static std::array<float, 3> Gamma(const Range range, const Balance &balance)
         {
-            gamma = {this->CyanRed, this->MagentaGreen, this->YellowBlue};
-
-            // auto sorted = gamma;
-            // std::ranges::sort(sorted);
-            // const auto mid = sorted[1];
-            //
-            // gamma[0] -= mid;
-            // gamma[1] -= mid;
-            // gamma[2] -= mid;
+            const auto a = balance.CyanRed, b = balance.MagentaGreen, c = balance.YellowBlue;
 
             if (range == Range::Midtones)
             {
                 constexpr auto delta = 0.0033944f;
 
-                const auto [a, b, c] = gamma;
-                gamma[0] = std::exp(-delta * a + delta * b + delta * c);
-                gamma[1] = std::exp(+delta * a - delta * b + delta * c);
-                gamma[2] = std::exp(+delta * a + delta * b - delta * c);
+                return {std::exp(-delta * a + delta * b + delta * c),
+                        std::exp(+delta * a - delta * b + delta * c),
+                        std::exp(+delta * a + delta * b - delta * c)};
             }
-            else if (range == Range::Shadows)
+            if (range == Range::Shadows)
             {
                 constexpr auto delta = 0.003923f;
 
-                const auto [a, b, c] = gamma;
-                gamma[0] = -delta * a * __Detail::Boole<float>(a < 0.) + delta * b * __Detail::Boole<float>(b > 0.) + delta * c * __Detail::Boole<float>(c > 0.);
-                gamma[1] = +delta * a * __Detail::Boole<float>(a > 0.) - delta * b * __Detail::Boole<float>(b < 0.) + delta * c * __Detail::Boole<float>(c > 0.);
-                gamma[2] = +delta * a * __Detail::Boole<float>(a > 0.) + delta * b * __Detail::Boole<float>(b > 0.) - delta * c * __Detail::Boole<float>(c < 0.);
+                return {-delta * a * __Detail::Boole<float>(a < 0.) + delta * b * __Detail::Boole<float>(b > 0.) + delta * c * __Detail::Boole<float>(c > 0.),
+                        +delta * a * __Detail::Boole<float>(a > 0.) - delta * b * __Detail::Boole<float>(b < 0.) + delta * c * __Detail::Boole<float>(c > 0.),
+                        +delta * a * __Detail::Boole<float>(a > 0.) + delta * b * __Detail::Boole<float>(b > 0.) - delta * c * __Detail::Boole<float>(c < 0.)};
             }
-            else if (range == Range::Highlights)
+            if (range == Range::Highlights)
             {
                 constexpr auto delta = 0.003923f;
 
-                const auto [a, b, c] = gamma;
-                gamma[0] = +delta * a * __Detail::Boole<float>(a > 0.) - delta * b * __Detail::Boole<float>(b < 0.) - delta * c * __Detail::Boole<float>(c < 0.);
-                gamma[1] = -delta * a * __Detail::Boole<float>(a < 0.) + delta * b * __Detail::Boole<float>(b > 0.) - delta * c * __Detail::Boole<float>(c < 0.);
-                gamma[2] = -delta * a * __Detail::Boole<float>(a < 0.) - delta * b * __Detail::Boole<float>(b < 0.) + delta * c * __Detail::Boole<float>(c > 0.);
+                return {+delta * a * __Detail::Boole<float>(a > 0.) - delta * b * __Detail::Boole<float>(b < 0.) - delta * c * __Detail::Boole<float>(c < 0.),
+                        -delta * a * __Detail::Boole<float>(a < 0.) + delta * b * __Detail::Boole<float>(b > 0.) - delta * c * __Detail::Boole<float>(c < 0.),
+                        -delta * a * __Detail::Boole<float>(a < 0.) - delta * b * __Detail::Boole<float>(b < 0.) + delta * c * __Detail::Boole<float>(c > 0.)};
             }
-            else
+
+            assert((false));
+            return {};
+        }
+
+        // one channel through a range's curve, v in [0, 1]
+        static float Transfer(const Range range, const float g, const float v)
+        {
+            if (range == Range::Midtones)
+                return std::clamp(std::pow(v, g), 0.f, 1.f);
+            if (range == Range::Shadows)
+                return std::clamp((v - g) / (1.f - g), 0.f, 1.f);
+            if (range == Range::Highlights)
+                return std::clamp(v / (1.f - g), 0.f, 1.f);
+            assert((false));
+            return 0.f;
+        }
+
+    public:
+        // All three ranges in one pass, indexed by Range. They apply in the order
+        // shadows, midtones, highlights, like three stacked single range tools
+        // but without rounding in between. A zero Balance leaves its range out.
+        ColorBalance(const std::array<Balance, 3> &balances, const bool preserveLuminosity)
+            : PreserveLuminosity(preserveLuminosity)
+        {
+            std::array<std::array<float, 3>, 3> gammas{};
+            for (int r = 0; r < 3; ++r)
+                gammas[r] = Gamma(static_cast<Range>(r), balances[r]);
+
+            for (int c = 0; c < 3; ++c)
             {
-                assert((false));
+                for (int v = 0; v < 256; ++v)
+                {
+                    auto x = static_cast<float>(v) / 255.f;
+                    for (const auto r : {Range::Shadows, Range::Midtones, Range::Highlights})
+                        x = Transfer(r, gammas[static_cast<int>(r)][c], x);
+
+                    curve[c][v] = x;
+                    table[c][v] = static_cast<uint8_t>(std::clamp(std::round(x * 255.f), 0.f, 255.f));
+                }
             }
         }
 
-        void ImgRef(const Image::ImageFile &img) { _ImgRef = &img; }
+        ColorBalance(const Range range,
+                     const float cyanRed,      // -100 ~ 100
+                     const float magentaGreen, // -100 ~ 100
+                     const float yellowBlue,   // -100 ~ 100
+                     const bool preserveLuminosity)
+            : ColorBalance(
+                  [&]
+                  {
+                      std::array<Balance, 3> balances{};
+                      balances[static_cast<int>(range)] = {cyanRed, magentaGreen, yellowBlue};
+                      return balances;
+                  }(),
+                  preserveLuminosity)
+        {
+        }
+
+        void Bind(const Image::ImageFile &img) { _ImgRef = &img; }
 
         ImageSize GetOutputSize() const { return {_ImgRef->Width(), _ImgRef->Height()}; }
 
@@ -554,46 +1459,59 @@ namespace ImageTools
         {
             const auto color = _ImgRef->At<uint8_t>(row, col);
 
+            if (!PreserveLuminosity)
+                return {table[0][color.R], table[1][color.G], table[2][color.B], color.A};
+
             const auto r = static_cast<float>(color.R) / 255.f;
             const auto g = static_cast<float>(color.G) / 255.f;
             const auto b = static_cast<float>(color.B) / 255.f;
 
-            float nr = 0., ng = 0., nb = 0.;
+            auto hsl = RgbToHsl(Image::ColorRgb{curve[0][color.R], curve[1][color.G], curve[2][color.B]});
+            hsl.L = RgbToHsl(Image::ColorRgb{r, g, b}).L;
+            const auto [nr, ng, nb] = HslToRgb(hsl);
 
-            if (AdjRange == Range::Midtones)
-            {
-                nr = std::clamp(std::pow(r, gamma[0]), 0.f, 1.f);
-                ng = std::clamp(std::pow(g, gamma[1]), 0.f, 1.f);
-                nb = std::clamp(std::pow(b, gamma[2]), 0.f, 1.f);
-            }
-            else if (AdjRange == Range::Shadows)
-            {
-                nr = std::clamp((r - gamma[0]) / (1.f - gamma[0]), 0.f, 1.f);
-                ng = std::clamp((g - gamma[1]) / (1.f - gamma[1]), 0.f, 1.f);
-                nb = std::clamp((b - gamma[2]) / (1.f - gamma[2]), 0.f, 1.f);
-            }
-            else if (AdjRange == Range::Highlights)
-            {
-                nr = std::clamp(r / (1.f - gamma[0]), 0.f, 1.f);
-                ng = std::clamp(g / (1.f - gamma[1]), 0.f, 1.f);
-                nb = std::clamp(b / (1.f - gamma[2]), 0.f, 1.f);
-            }
-            else
+            return Image::ColorRgba(Image::FloatToUint8({nr, ng, nb}), color.A);
+        }
+
+        void ProcessRow(const int64_t row, uint8_t *dst) const
+        {
+            const auto width = static_cast<size_t>(_ImgRef->Width());
+            const auto src = _ImgRef->Data() + row * width * 4;
+
+            if (!PreserveLuminosity)
             {
-                assert((false));
+                for (size_t i = 0; i < width * 4; i += 4)
+                {
+                    dst[i + 0] = table[0][src[i + 0]];
+                    dst[i + 1] = table[1][src[i + 1]];
+                    dst[i + 2] = table[2][src[i + 2]];
+                    dst[i + 3] = src[i + 3];
+                }
+                return;
             }
 
-            if (PreserveLuminosity)
+            constexpr auto size = __Detail::RgbBlock::Size;
+            __Detail::RgbBlock rgb;
+            float h[size], s[size], l[size], discard[size];
+            for (size_t x = 0; x < width; x += size)
             {
-                auto hsl = RgbToHsl(Image::ColorRgb{nr, ng, nb});
-                hsl.L = RgbToHsl(Image::ColorRgb{r, g, b}).L;
-                const auto rgb = HslToRgb(hsl);
-                nr = rgb.R;
-                ng = rgb.G;
-                nb = rgb.B;
+                const auto n = std::min(size, width - x);
+                const auto px = src + x * 4;
+
+                for (size_t i = 0; i < n; ++i)
+                {
+                    const auto r = px[i * 4 + 0], g = px[i * 4 + 1], b = px[i * 4 + 2];
+                    // only the lightness of the source is needed, no full conversion
+                    l[i] = (static_cast<float>(std::max({r, g, b})) / 255.f + static_cast<float>(std::min({r, g, b})) / 255.f) / 2.f;
+                    rgb.R[i] = curve[0][r];
+                    rgb.G[i] = curve[1][g];
+                    rgb.B[i] = curve[2][b];
+                }
+
+                Simd::RgbToHsl(rgb.R, rgb.G, rgb.B, h, s, discard, n);
+                Simd::HslToRgb(h, s, l, rgb.R, rgb.G, rgb.B, n);
+                rgb.Store(dst + x * 4, px, n);
             }
-
-            return Image::ColorRgba(Image::FloatToUint8({nr, ng, nb}), color.A);
         }
     };
 
@@ -609,7 +1527,7 @@ namespace ImageTools
                                                                      Saturation(s / 100.f),
                                                                      Lightness(l / 100.f) {}
 
-        void ImgRef(const Image::ImageFile &img) { _ImgRef = &img; }
+        void Bind(const Image::ImageFile &img) { _ImgRef = &img; }
 
         ImageSize GetOutputSize() const { return {_ImgRef->Width(), _ImgRef->Height()}; }
 
@@ -631,5 +1549,32 @@ namespace ImageTools
 
             return Image::ColorRgba(Image::FloatToUint8({nr, ng, nb}), color.A);
         }
+
+        void ProcessRow(const int64_t row, uint8_t *dst) const
+        {
+            constexpr auto size = __Detail::RgbBlock::Size;
+            const auto width = static_cast<size_t>(_ImgRef->Width());
+            const auto src = _ImgRef->Data() + row * width * 4;
+
+            __Detail::RgbBlock rgb;
+            float h[size], s[size], l[size];
+            for (size_t x = 0; x < width; x += size)
+            {
+                const auto n = std::min(size, width - x);
+                rgb.Load(src + x * 4, n);
+                Simd::RgbToHsl(rgb.R, rgb.G, rgb.B, h, s, l, n);
+
+                for (size_t i = 0; i < n; ++i)
+                {
+                    const auto hue = h[i] + 360.f + Hue;
+                    h[i] = hue - 360.f * std::floor(hue / 360.f);
+                    s[i] = std::clamp(s[i] + Saturation, 0.f, 1.f);
+                    l[i] = std::clamp(l[i] + Lightness, 0.f, 1.f);
+                }
+
+                Simd::HslToRgb(h, s, l, rgb.R, rgb.G, rgb.B, n);
+                rgb.Store(dst + x * 4, src + x * 4, n);
+            }
+        }
     };
 }
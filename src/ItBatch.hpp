@@ -0,0 +1,672 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <shellapi.h>
+
+#include <nlohmann/json.hpp>
+
+#include "Image.hpp"
+#include "ImageTools.hpp"
+#include "ItException.hpp"
+#include "ItJournal.hpp"
+#include "ItLog.hpp"
+#include "ItSerialization.hpp"
+#include "ItText.hpp"
+#include "ItUtility.hpp"
+
+struct ExportOptions
+{
+    bool Resume = true;
+    bool Incremental = false;
+    uint64_t PresetHash = 0;
+    Image::SaveOptions Save{};
+
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(ExportOptions, Resume, Incremental, PresetHash, Save)
+};
+
+enum class ExportResult
+{
+    Done,
+    Skipped,
+    Failed
+};
+
+// Exports one input, consulting the journal next to the output first.
+// `process` turns the decoded input into the image to save, `accepts` picks
+// the pixel formats it takes as stored in the file instead of Rgba8.
+template <typename Fn>
+ExportResult ExportItem(const ExportOptions &opt, ExportJournalSet &journals,
+                        const std::filesystem::path &in, const std::filesystem::path &out, Fn &&process,
+                        const Image::ImageFile::FormatFilter &accepts = {})
+{
+    const auto journaled = opt.Resume || opt.Incremental;
+    ExportJournal::Record rec{
+        .Input = ToImString(in),
+        .Output = ToImString(out),
+        .PresetHash = opt.PresetHash};
+
+    auto result = ExportResult::Failed;
+    try
+    {
+        bool skip = false;
+        // the input is hashed and decoded from one mapping
+        std::optional<MappedFile> mapped{};
+        if (journaled)
+        {
+            auto &journal = journals.For(out);
+            rec.InputStamp = FileStamp::Of(in).value_or(FileStamp{});
+
+            if (opt.Incremental && journal.IsUpToDate(in, out, rec.InputStamp, rec.PresetHash))
+            {
+                LogInfo(R"({}: "{}")", Text::UpToDate(), in);
+                return ExportResult::Skipped;
+            }
+
+            if (opt.Resume)
+            {
+                mapped.emplace(in);
+                rec.InputHash = XXHash64::Hash(mapped->Bytes());
+                // content unchanged but touched: skip, and refresh the stamps so the next run takes the stat path
+                skip = journal.IsDone(in, out, rec.InputHash, rec.PresetHash);
+            }
+        }
+
+        if (skip)
+        {
+            LogInfo(R"({}: "{}")", Text::Skipped(), in);
+            result = ExportResult::Skipped;
+        }
+        else
+        {
+            if (!mapped)
+                mapped.emplace(in);
+            const Image::ImageFile img(mapped->Data(), mapped->Size(), accepts);
+            // the view is not needed past decoding, and the output may replace the input
+            mapped.reset();
+
+            if (!exists(out.parent_path()))
+                create_directories(out.parent_path());
+            const auto output = process(img);
+            std::vector<Image::ImageFile> mips{};
+            if (out.extension() == ".dds" && opt.Save.Dds.Mipmaps)
+                mips = ImageTools::MipChain::Build(output, ImageTools::MipChain::Filter::Box);
+            output.Save(out, opt.Save, mips);
+            result = ExportResult::Done;
+        }
+
+        rec.State = ExportJournal::Status::Done;
+        rec.OutputStamp = FileStamp::Of(out).value_or(FileStamp{});
+    }
+    catch (const std::exception &ex)
+    {
+        LogErr("[Export] processor error:\n{}", LogMsg::LogException(ex));
+    }
+
+    if (journaled)
+    {
+        try
+        {
+            journals.For(out).Append(std::move(rec));
+        }
+        catch (const std::exception &ex)
+        {
+            LogErr("[Export] journal error:\n{}", LogMsg::LogException(ex));
+        }
+    }
+
+    return result;
+}
+
+// Job directory shared by the coordinator and its worker processes:
+//   job.json             preset and export options
+//   chunk-NNNNNN.json    input/output pairs, published atomically by rename
+//   chunk-NNNNNN.claim   created exclusively by the worker that owns the chunk, holds its pid
+//   chunk-NNNNNN.progress  Cursor of the worker on the chunk
+//   chunk-NNNNNN.done    every item of the chunk has been handled
+//   shard-N.progress     Cursor of a hash-sharded worker
+//   sealed               number of chunks, no more will be published
+//   cancel               workers stop after the current item
+class BatchQueue
+{
+public:
+    struct Item
+    {
+        std::string Input{};
+        std::string Output{};
+
+        NLOHMANN_DEFINE_TYPE_INTRUSIVE(Item, Input, Output)
+    };
+
+    struct Job
+    {
+        nlohmann::json Preset{};
+        ExportOptions Options{};
+
+        NLOHMANN_DEFINE_TYPE_INTRUSIVE(Job, Preset, Options)
+    };
+
+    struct Shard
+    {
+        uint64_t Index = 0;
+        uint64_t Count = 1;
+    };
+
+    // Written before each item, so after a crash it names the item that was
+    // running and a new worker resumes there. Handled counts the items before it.
+    struct Cursor
+    {
+        size_t Chunk = 0;
+        size_t Item = 0;
+        uint64_t Handled = 0;
+
+        NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(Cursor, Chunk, Item, Handled)
+    };
+
+    static constexpr size_t ChunkSize = 32;
+    // a chunk is also closed at this many input pixels, so a run of large
+    // images does not leave one worker with most of the job
+    static constexpr uint64_t ChunkPixels = 256ull * 1024 * 1024;
+
+private:
+    std::filesystem::path dir{};
+
+    // coordinator side
+    std::vector<size_t> chunkSizes{};
+    std::vector<bool> chunkDone{};
+    uint64_t completed = 0;
+
+    [[nodiscard]] std::filesystem::path ChunkPath(const size_t index, const std::string_view ext) const
+    {
+        return dir / std::format("chunk-{:06}.{}", index, ext);
+    }
+
+    static void WriteAtomic(const std::filesystem::path &file, const std::string_view data)
+    {
+        auto tmp = file;
+        tmp += ".tmp";
+        {
+            std::ofstream fs(tmp, std::ios::out | std::ios::binary | std::ios::trunc);
+            if (!fs)
+                throw Ex(ImgToolsException, "open file failed: {}", ToImString(tmp));
+            fs.write(data.data(), static_cast<std::streamsize>(data.size()));
+            if (!fs)
+                throw Ex(ImgToolsException, "write file failed: {}", ToImString(tmp));
+        }
+        if (!MoveFileExW(tmp.c_str(), file.c_str(), MOVEFILE_REPLACE_EXISTING))
+            throw Ex(WinApiException, "MoveFileExW: {}: {}", ToImString(file), GetLastError());
+    }
+
+    [[nodiscard]] static std::string ReadText(const std::filesystem::path &file)
+    {
+        const auto bytes = ReadFileBytes(file);
+        return {bytes.begin(), bytes.end()};
+    }
+
+    [[nodiscard]] std::optional<size_t> Sealed() const
+    {
+        const auto file = dir / "sealed";
+        if (!exists(file))
+            return std::nullopt;
+        return std::stoull(ReadText(file));
+    }
+
+    bool TryClaim(const size_t index) const
+    {
+        const auto claim = ChunkPath(index, "claim");
+        const auto handle = CreateFileW(claim.c_str(), GENERIC_WRITE, 0, nullptr,
+                                        CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (handle == INVALID_HANDLE_VALUE)
+            return false;
+
+        const auto pid = std::to_string(GetCurrentProcessId());
+        DWORD written = 0;
+        WriteFile(handle, pid.data(), static_cast<DWORD>(pid.size()), &written, nullptr);
+        CloseHandle(handle);
+        return true;
+    }
+
+public:
+    explicit BatchQueue(std::filesystem::path dir) : dir(std::move(dir)) {}
+
+    [[nodiscard]] const std::filesystem::path &Dir() const { return dir; }
+
+    void Create(const Job &job) const
+    {
+        create_directories(dir);
+        WriteAtomic(dir / "job.json", nlohmann::json(job).dump());
+    }
+
+    [[nodiscard]] Job ReadJob() const
+    {
+        return nlohmann::json::parse(ReadText(dir / "job.json")).get<Job>();
+    }
+
+    void Publish(const std::vector<Item> &items)
+    {
+        WriteAtomic(ChunkPath(chunkSizes.size(), "json"), nlohmann::json(items).dump());
+        chunkSizes.push_back(items.size());
+        chunkDone.push_back(false);
+    }
+
+    [[nodiscard]] size_t Published() const { return chunkSizes.size(); }
+
+    void Seal() const { WriteAtomic(dir / "sealed", std::to_string(chunkSizes.size())); }
+
+    void Cancel() const { WriteAtomic(dir / "cancel", {}); }
+
+    [[nodiscard]] bool Cancelled() const { return exists(dir / "cancel"); }
+
+    void MarkChunkDone(const size_t index) const { WriteAtomic(ChunkPath(index, "done"), {}); }
+
+    [[nodiscard]] bool ChunkDone(const size_t index) const { return exists(ChunkPath(index, "done")); }
+
+    [[nodiscard]] std::filesystem::path CursorPath(const std::optional<Shard> &shard, const size_t chunk) const
+    {
+        return shard ? dir / std::format("shard-{}.progress", shard->Index) : ChunkPath(chunk, "progress");
+    }
+
+    [[nodiscard]] std::optional<Cursor> ReadCursor(const std::filesystem::path &file) const
+    {
+        try
+        {
+            if (exists(file))
+                return nlohmann::json::parse(ReadText(file)).get<Cursor>();
+        }
+        catch (const std::exception &)
+        {
+        }
+        return std::nullopt;
+    }
+
+    void WriteCursor(const std::filesystem::path &file, const Cursor &cursor) const
+    {
+        WriteAtomic(file, nlohmann::json(cursor).dump());
+    }
+
+    [[nodiscard]] std::optional<Item> ReadItem(const size_t chunk, const size_t item) const
+    {
+        const auto file = ChunkPath(chunk, "json");
+        if (!exists(file))
+            return std::nullopt;
+        const auto items = nlohmann::json::parse(ReadText(file)).get<std::vector<Item>>();
+        if (item >= items.size())
+            return std::nullopt;
+        return items[item];
+    }
+
+    // Published chunks not done yet, once the queue is sealed.
+    [[nodiscard]] std::optional<size_t> Unfinished() const
+    {
+        const auto sealed = Sealed();
+        if (!sealed)
+            return std::nullopt;
+        size_t count = 0;
+        for (size_t i = 0; i < *sealed; ++i)
+            count += !ChunkDone(i);
+        return count;
+    }
+
+    // Unfinished chunks still claimed by a worker that is gone.
+    [[nodiscard]] std::vector<size_t> Orphans(const DWORD pid) const
+    {
+        std::vector<size_t> out{};
+        const auto owner = std::to_string(pid);
+        for (size_t i = 0; i < chunkSizes.size(); ++i)
+        {
+            if (chunkDone[i] || exists(ChunkPath(i, "done")))
+                continue;
+            if (const auto claim = ChunkPath(i, "claim"); exists(claim) && ReadText(claim) == owner)
+                out.push_back(i);
+        }
+        return out;
+    }
+
+    void Unclaim(const size_t index) const
+    {
+        std::error_code ec;
+        remove(ChunkPath(index, "claim"), ec);
+    }
+
+    // Items in chunks marked done so far.
+    [[nodiscard]] uint64_t CompletedItems()
+    {
+        for (size_t i = 0; i < chunkSizes.size(); ++i)
+        {
+            if (!chunkDone[i] && exists(ChunkPath(i, "done")))
+            {
+                chunkDone[i] = true;
+                completed += chunkSizes[i];
+            }
+        }
+        return completed;
+    }
+
+    [[nodiscard]] uint64_t ShardProgress(const uint64_t index) const
+    {
+        const auto cursor = ReadCursor(CursorPath(Shard{.Index = index}, 0));
+        return cursor ? cursor->Handled : 0;
+    }
+
+    // Worker loop. Without a shard chunks are claimed first come first served,
+    // with one every chunk is read and only the items hashing to it are taken.
+    // Either way the work resumes at the cursor a crashed worker left behind.
+    template <typename Fn>
+    void Work(const std::optional<Shard> &shard, Fn &&fn) const
+    {
+        ReadAhead readAhead{};
+        auto cursor = shard ? ReadCursor(CursorPath(shard, 0)).value_or(Cursor{}) : Cursor{};
+        for (size_t index = cursor.Chunk;;)
+        {
+            if (Cancelled())
+                return;
+
+            if (!exists(ChunkPath(index, "json")))
+            {
+                const auto sealed = Sealed();
+                if (!sealed || index < *sealed)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                    continue;
+                }
+                if (shard)
+                    return;
+
+                // chunks handed back after a crash are behind the scan, take them
+                // up until every chunk is done
+                bool pending = false;
+                if (const auto left = ClaimLeftover(*sealed, pending))
+                {
+                    auto chunkCursor = ReadCursor(CursorPath(shard, *left)).value_or(Cursor{.Chunk = *left});
+                    if (!RunChunk(*left, shard, chunkCursor, readAhead, fn))
+                        return;
+                    MarkChunkDone(*left);
+                }
+                else if (!pending)
+                    return;
+                else
+                    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+                continue;
+            }
+
+            if (shard)
+            {
+                if (!RunChunk(index, shard, cursor, readAhead, fn))
+                    return;
+                cursor = {.Chunk = index + 1, .Item = 0, .Handled = cursor.Handled};
+                WriteCursor(CursorPath(shard, index), cursor);
+            }
+            else if (TryClaim(index))
+            {
+                auto chunkCursor = ReadCursor(CursorPath(shard, index)).value_or(Cursor{.Chunk = index});
+                if (!RunChunk(index, shard, chunkCursor, readAhead, fn))
+                    return;
+                MarkChunkDone(index);
+            }
+            ++index;
+        }
+    }
+
+private:
+    // Claims an unfinished chunk below sealed that no worker holds; pending tells
+    // whether any chunk is unfinished at all.
+    std::optional<size_t> ClaimLeftover(const size_t sealed, bool &pending) const
+    {
+        for (size_t i = 0; i < sealed; ++i)
+        {
+            if (ChunkDone(i))
+                continue;
+            pending = true;
+            if (TryClaim(i))
+                return i;
+        }
+        return std::nullopt;
+    }
+
+    // Runs the items of a chunk from the cursor on, false if cancelled.
+    template <typename Fn>
+    bool RunChunk(const size_t index, const std::optional<Shard> &shard, Cursor &cursor,
+                  ReadAhead &readAhead, Fn &&fn) const
+    {
+        const auto cursorPath = CursorPath(shard, index);
+        const auto items = nlohmann::json::parse(ReadText(ChunkPath(index, "json"))).get<std::vector<Item>>();
+        std::vector<size_t> mine{};
+        for (size_t i = cursor.Chunk == index ? cursor.Item : 0; i < items.size(); ++i)
+            if (!shard || XXHash64::Hash(items[i].Input) % shard->Count == shard->Index)
+                mine.push_back(i);
+
+        for (size_t k = 0; k < mine.size(); ++k)
+        {
+            if (Cancelled())
+                return false;
+            cursor.Chunk = index;
+            cursor.Item = mine[k];
+            WriteCursor(cursorPath, cursor);
+            if (k + 1 < mine.size())
+                readAhead.Hint(FromImString(items[mine[k + 1]].Input));
+
+            fn(items[mine[k]]);
+            ++cursor.Handled;
+        }
+        return true;
+    }
+};
+
+// ImgTools.exe --worker <job dir> [--shard <index>/<count>]
+struct WorkerArgs
+{
+    std::filesystem::path JobDir{};
+    std::optional<BatchQueue::Shard> Shard{};
+
+    static std::optional<WorkerArgs> FromCommandLine()
+    {
+        int argc = 0;
+        const auto argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+        if (!argv)
+            return std::nullopt;
+        const std::vector<std::wstring> args(argv, argv + argc);
+        LocalFree(argv);
+
+        if (args.size() < 3 || args[1] != L"--worker")
+            return std::nullopt;
+
+        WorkerArgs out{.JobDir = args[2]};
+        if (args.size() >= 5 && args[3] == L"--shard")
+        {
+            const auto &val = args[4];
+            const auto sep = val.find(L'/');
+            if (sep == std::wstring::npos)
+                throw Ex(ImgToolsException, "invalid shard: {}", ToImString(val));
+            out.Shard = BatchQueue::Shard{
+                .Index = std::stoull(val.substr(0, sep)),
+                .Count = std::stoull(val.substr(sep + 1))};
+            if (out.Shard->Count == 0 || out.Shard->Index >= out.Shard->Count)
+                throw Ex(ImgToolsException, "invalid shard: {}", ToImString(val));
+        }
+        return out;
+    }
+
+    [[nodiscard]] std::wstring ToCommandLine(const std::filesystem::path &exe) const
+    {
+        auto cmd = std::format(LR"("{}" --worker "{}")", exe.wstring(), JobDir.wstring());
+        if (Shard)
+            cmd += std::format(L" --shard {}/{}", Shard->Index, Shard->Count);
+        return cmd;
+    }
+};
+
+// Runs worker processes of this executable over a BatchQueue. A worker that
+// dies is replaced and its work resumes at the item it died on; an item that
+// keeps killing workers is given up on so one bad input cannot stall the job.
+// A worker slot that keeps dying outside any item is not replaced, the other
+// workers take over its chunks. Failed tells whether anything was left undone.
+class WorkerPool
+{
+    struct Worker
+    {
+        HANDLE Process = nullptr;
+        DWORD Pid = 0;
+        std::optional<BatchQueue::Shard> Shard{};
+        int Restarts = 0;
+    };
+
+    static constexpr int MaxAttempts = 3;
+
+    BatchQueue &queue;
+    std::filesystem::path exe{};
+    std::vector<Worker> workers{};
+    // crashes per cursor file and item
+    std::map<std::tuple<std::filesystem::path, size_t, size_t>, int> itemFailures{};
+    uint64_t givenUp = 0;
+    bool abandoned = false;
+
+    // Counts a crash against the item under a cursor, moving the cursor past it
+    // after MaxAttempts. False if the cursor names no item the worker was on.
+    bool Blame(const std::filesystem::path &cursorPath, const std::optional<BatchQueue::Shard> &shard)
+    {
+        auto cursor = queue.ReadCursor(cursorPath);
+        if (!cursor)
+            return false;
+        const auto item = queue.ReadItem(cursor->Chunk, cursor->Item);
+        // a shard cursor left between chunks points at no item of its own
+        if (!item || (shard && XXHash64::Hash(item->Input) % shard->Count != shard->Index))
+            return false;
+        if (++itemFailures[{cursorPath, cursor->Chunk, cursor->Item}] < MaxAttempts)
+            return true;
+
+        LogErr(R"([Batch] giving up on "{}" after {} crashed workers)", item->Input, MaxAttempts);
+        ++givenUp;
+        ++cursor->Item;
+        ++cursor->Handled;
+        queue.WriteCursor(cursorPath, *cursor);
+        return true;
+    }
+
+    void Spawn(Worker &worker) const
+    {
+        auto cmd = WorkerArgs{.JobDir = queue.Dir(), .Shard = worker.Shard}.ToCommandLine(exe);
+
+        STARTUPINFOW si{};
+        si.cb = sizeof si;
+        PROCESS_INFORMATION pi{};
+        if (!CreateProcessW(nullptr, cmd.data(), nullptr, nullptr, FALSE,
+                            CREATE_NO_WINDOW, nullptr, nullptr, &si, &pi))
+            throw Ex(WinApiException, "CreateProcessW: {}", GetLastError());
+
+        CloseHandle(pi.hThread);
+        worker.Process = pi.hProcess;
+        worker.Pid = pi.dwProcessId;
+    }
+
+public:
+    WorkerPool(BatchQueue &queue, const BatchMode mode, const size_t count) : queue(queue)
+    {
+        std::wstring buf(MaxPathLengthW, L'\0');
+        buf.resize(GetModuleFileNameW(nullptr, buf.data(), static_cast<DWORD>(buf.size())));
+        exe = buf;
+
+        workers.resize(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (mode == BatchMode::Shard)
+                workers[i].Shard = BatchQueue::Shard{.Index = i, .Count = count};
+            Spawn(workers[i]);
+        }
+    }
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool(WorkerPool &&) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+    WorkerPool &operator=(WorkerPool &&) = delete;
+
+    ~WorkerPool()
+    {
+        for (auto &worker : workers)
+        {
+            if (!worker.Process)
+                continue;
+            TerminateProcess(worker.Process, EXIT_FAILURE);
+            CloseHandle(worker.Process);
+        }
+    }
+
+    // Reaps exited workers and replaces crashed ones; false once all are done.
+    bool Poll()
+    {
+        bool alive = false;
+        for (auto &worker : workers)
+        {
+            if (!worker.Process)
+                continue;
+            if (WaitForSingleObject(worker.Process, 0) == WAIT_TIMEOUT)
+            {
+                alive = true;
+                continue;
+            }
+
+            DWORD code = EXIT_FAILURE;
+            GetExitCodeProcess(worker.Process, &code);
+            CloseHandle(worker.Process);
+            worker.Process = nullptr;
+            if (code == EXIT_SUCCESS || queue.Cancelled())
+                continue;
+
+            LogWarn("[Batch] worker {} exited with {:#x}", worker.Pid, code);
+            bool blamed = false;
+            if (worker.Shard)
+                blamed = Blame(queue.CursorPath(worker.Shard, 0), worker.Shard);
+            else
+                for (const auto chunk : queue.Orphans(worker.Pid))
+                {
+                    // the chunk goes back to the queue and resumes at its cursor
+                    blamed = Blame(queue.CursorPath(std::nullopt, chunk), std::nullopt) || blamed;
+                    queue.Unclaim(chunk);
+                }
+
+            if (!blamed && ++worker.Restarts > MaxAttempts * 2)
+            {
+                // a sharded slot's items only it can take, so they stay undone
+                LogErr("[Batch] worker slot restarted too often, not replacing it");
+                abandoned = abandoned || worker.Shard.has_value();
+                continue;
+            }
+            Spawn(worker);
+            alive = true;
+        }
+        return alive;
+    }
+
+    // Items given up on, or chunks no worker finished; meaningful once Poll is false.
+    [[nodiscard]] bool Failed() const
+    {
+        if (givenUp > 0 || abandoned)
+            return true;
+        if (queue.Cancelled())
+            return false;
+        // shard workers only stop early when cancelled or abandoned
+        if (workers.empty() || workers.front().Shard)
+            return false;
+        return queue.Unfinished().value_or(1) > 0;
+    }
+
+    [[nodiscard]] uint64_t GivenUp() const { return givenUp; }
+
+    [[nodiscard]] uint64_t Completed() const
+    {
+        if (workers.empty() || !workers.front().Shard)
+            return queue.CompletedItems();
+
+        uint64_t sum = 0;
+        for (const auto &worker : workers)
+            sum += queue.ShardProgress(worker.Shard->Index);
+        return sum;
+    }
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdlib>
 #include <filesystem>
 
 namespace Config
@@ -20,6 +21,13 @@ namespace Config
             return std::filesystem::current_path();
 	    }
     }();
+    // per-user data that can be rebuilt at any time, e.g. the image header index
+    static const auto CacheDir = []
+    {
+        if (const auto local = _wgetenv(L"LOCALAPPDATA"); local && *local)
+            return std::filesystem::path(local) / "ImgTools" / "cache";
+        return TmpDir / "cache";
+    }();
 
     #define ItPresetExt "itpreset"
     static constexpr auto ItPresetFilter = L"preset file(*." ItPresetExt ")\0*." ItPresetExt "\0";
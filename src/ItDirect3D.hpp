@@ -581,6 +581,9 @@ namespace D3D11
     {
         if (img.Empty())
             throw Ex(D3D11Exception, "img.Empty()");
+        // the shaders sample RGBA
+        if (img.Format() != Image::Rgba8)
+            return LoadTextureFromFile(dev, img.Converted(Image::Rgba8));
 
         Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> outSrv;
 
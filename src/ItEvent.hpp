@@ -58,6 +58,11 @@ struct EndProcessEvent : IEvent<EndProcessEvent>
     auto GetArg() const { return std::nullopt; }
 };
 
+struct StartWatchEvent : IEvent<StartWatchEvent>
+{
+    auto GetArg() const { return std::nullopt; }
+};
+
 struct LoadImageEvent : IEvent<LoadImageEvent>
 {
     using ArgType = std::vector<std::filesystem::path>;
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include <nlohmann/json.hpp>
+
+#include "Image.hpp"
+#include "ItConfig.hpp"
+#include "ItException.hpp"
+#include "ItJournal.hpp"
+#include "ItSerialization.hpp"
+#include "ItUtility.hpp"
+
+// Header info of the images in one directory, kept in the per-user cache so
+// planning over the same inputs again costs a stat per file instead of a read.
+// Input directories are never written to. Entries are keyed by file name and
+// trusted while the file's FileStamp holds. The cache is best effort: an
+// unreadable index starts empty and an unwritable cache keeps it in memory.
+class ImageIndex
+{
+public:
+    struct Entry
+    {
+        FileStamp Stamp{};
+        Image::ImageInfo Info{};
+
+        NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(Entry, Stamp, Info)
+    };
+
+    // bump when Entry changes meaning, older indexes are then dropped
+    static constexpr int Version = 2;
+
+private:
+    std::filesystem::path dir{};
+    std::filesystem::path file{};
+    std::unordered_map<std::string, Entry> entries{};
+    std::mutex mtx{};
+    bool dirty = false;
+
+    void Load()
+    {
+        std::ifstream fs(file, std::ios::in | std::ios::binary);
+        if (!fs)
+            return;
+
+        try
+        {
+            const auto j = nlohmann::json::parse(fs);
+            // the directory is stored too, two paths may share a hash
+            if (j.value("Version", 0) == Version && j.value("Directory", std::string{}) == ToImString(dir))
+                entries = j.at("Entries").get<std::unordered_map<std::string, Entry>>();
+        }
+        catch (const std::exception &)
+        {
+            entries.clear();
+        }
+    }
+
+public:
+    explicit ImageIndex(const std::filesystem::path &directory)
+        : dir(Normalize(directory)), file(PathOf(dir))
+    {
+        Load();
+    }
+
+    [[nodiscard]] static std::filesystem::path Normalize(const std::filesystem::path &directory)
+    {
+        std::error_code ec;
+        const auto abs = absolute(directory, ec);
+        return (ec ? directory : abs).lexically_normal();
+    }
+
+    // where the index of a directory is kept
+    [[nodiscard]] static std::filesystem::path PathOf(const std::filesystem::path &directory)
+    {
+        return Config::CacheDir / "index" /
+               std::format("{:016x}.json", XXHash64::Hash(ToImString(Normalize(directory))));
+    }
+
+    ImageIndex(const ImageIndex &) = delete;
+    ImageIndex(ImageIndex &&) = delete;
+    ImageIndex &operator=(const ImageIndex &) = delete;
+    ImageIndex &operator=(ImageIndex &&) = delete;
+
+    ~ImageIndex()
+    {
+        try
+        {
+            Save();
+        }
+        catch (const std::exception &)
+        {
+        }
+    }
+
+    // Cached info of a file in this directory, probed on a miss. nullopt if the
+    // file is gone or not an image stb and the own decoders can read.
+    [[nodiscard]] std::optional<Image::ImageInfo> Get(const std::filesystem::path &image)
+    {
+        const auto stamp = FileStamp::Of(image);
+        if (!stamp)
+            return std::nullopt;
+
+        const auto key = ToImString(image.filename());
+        {
+            std::lock_guard lock(mtx);
+            if (const auto it = entries.find(key); it != entries.end() && it->second.Stamp == *stamp)
+                return it->second.Info;
+        }
+
+        Image::ImageInfo info{};
+        try
+        {
+            info = Image::ImageFile::Probe(image);
+        }
+        catch (const std::exception &)
+        {
+            return std::nullopt;
+        }
+
+        std::lock_guard lock(mtx);
+        entries.insert_or_assign(key, Entry{*stamp, info});
+        dirty = true;
+        return info;
+    }
+
+    // Writes the index if anything was probed since it was loaded, replacing the
+    // old one by rename so a reader never sees half of it. Nothing is written
+    // when the cache directory can not be created or opened for writing.
+    void Save()
+    {
+        std::lock_guard lock(mtx);
+        if (!dirty)
+            return;
+
+        // files that are gone would otherwise stay forever
+        std::erase_if(entries, [&](const auto &kv)
+                      { return !exists(dir / FromImString(kv.first)); });
+
+        std::error_code ec;
+        create_directories(file.parent_path(), ec);
+        if (ec)
+            return;
+
+        auto tmp = file;
+        tmp += std::format(".{}.tmp", GetCurrentProcessId());
+        bool written = false;
+        {
+            std::ofstream fs(tmp, std::ios::out | std::ios::binary | std::ios::trunc);
+            if (!fs)
+                return;
+            fs << nlohmann::json{{"Version", Version}, {"Directory", ToImString(dir)}, {"Entries", entries}}.dump();
+            fs.close();
+            written = !fs.fail();
+        }
+        // the temp name is per process, a failed save would otherwise leave one behind every run
+        if (!written)
+        {
+            remove(tmp, ec);
+            throw Ex(ImgToolsException, "write file failed: {}", ToImString(tmp));
+        }
+        if (!MoveFileExW(tmp.c_str(), file.c_str(), MOVEFILE_REPLACE_EXISTING))
+        {
+            const auto err = GetLastError();
+            remove(tmp, ec);
+            throw Ex(WinApiException, "MoveFileExW: {}: {}", ToImString(file), err);
+        }
+        dirty = false;
+    }
+};
+
+// One index per input directory, loaded on first use.
+class ImageIndexSet
+{
+    std::map<std::filesystem::path, std::unique_ptr<ImageIndex>> indexes{};
+    std::mutex mtx{};
+
+public:
+    ImageIndex &For(const std::filesystem::path &image)
+    {
+        const auto dir = image.parent_path();
+
+        std::lock_guard lock(mtx);
+        auto &index = indexes[dir];
+        if (!index)
+            index = std::make_unique<ImageIndex>(dir);
+        return *index;
+    }
+
+    [[nodiscard]] std::optional<Image::ImageInfo> Get(const std::filesystem::path &image)
+    {
+        return For(image).Get(image);
+    }
+
+    // saves and drops every index, failures are ignored like on destruction
+    void Clear()
+    {
+        std::lock_guard lock(mtx);
+        indexes.clear();
+    }
+};
@@ -0,0 +1,251 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include <nlohmann/json.hpp>
+
+#include "ItException.hpp"
+#include "ItUtility.hpp"
+
+enum class ExportStatus
+{
+    Done,
+    Failed
+};
+
+NLOHMANN_JSON_SERIALIZE_ENUM(ExportStatus, {{ExportStatus::Done, "Done"},
+                                            {ExportStatus::Failed, "Failed"}})
+
+// Size and modification time of a file, enough for a make-like up-to-date check.
+struct FileStamp
+{
+    uint64_t Size = 0;
+    int64_t Time = 0;
+
+    [[nodiscard]] static std::optional<FileStamp> Of(const std::filesystem::path &file)
+    {
+        std::error_code ec;
+        const auto size = std::filesystem::file_size(file, ec);
+        if (ec)
+            return std::nullopt;
+        const auto time = std::filesystem::last_write_time(file, ec);
+        if (ec)
+            return std::nullopt;
+        return FileStamp{size, static_cast<int64_t>(time.time_since_epoch().count())};
+    }
+
+    bool operator==(const FileStamp &) const = default;
+
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(FileStamp, Size, Time)
+};
+
+// Append-only record of finished export items, kept next to the outputs.
+// Every record is written straight through to the OS so an application crash
+// loses nothing; FlushFileBuffers is batched so a power loss loses at most the
+// last batch. The last record of an input wins, a torn line is ignored.
+// Several processes may append to the same journal: each record is a single
+// append-mode WriteFile, which the file system keeps whole.
+class ExportJournal
+{
+public:
+    using Status = ExportStatus;
+
+    struct Record
+    {
+        std::string Input{};
+        std::string Output{};
+        uint64_t InputHash = 0;
+        uint64_t PresetHash = 0;
+        Status State = Status::Failed;
+        FileStamp InputStamp{};
+        FileStamp OutputStamp{};
+
+        NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(Record, Input, Output, InputHash, PresetHash, State,
+                                                    InputStamp, OutputStamp)
+    };
+
+    static constexpr auto FileName = ".imgtools.journal";
+
+private:
+    std::filesystem::path path{};
+    HANDLE file = INVALID_HANDLE_VALUE;
+
+    std::unordered_map<std::string, Record> records{};
+    // the last line has no newline, a crash cut it short
+    bool torn = false;
+
+    std::mutex mtx{};
+    size_t pending = 0;
+    size_t syncEvery = 64;
+    std::chrono::milliseconds syncInterval{2000};
+    std::chrono::steady_clock::time_point lastSync = std::chrono::steady_clock::now();
+
+    void Load()
+    {
+        std::ifstream fs(path, std::ios::in | std::ios::binary);
+        if (!fs)
+            return;
+
+        std::string line;
+        while (std::getline(fs, line))
+        {
+            // getline only hits the end of the file on a line without a newline
+            torn = fs.eof();
+            if (line.empty() || line == "\r")
+                continue;
+
+            try
+            {
+                auto rec = nlohmann::json::parse(line).get<Record>();
+                auto key = rec.Input;
+                records.insert_or_assign(std::move(key), std::move(rec));
+            }
+            catch (const std::exception &)
+            {
+                // torn write from a crash, skipped so the records after it still count
+            }
+        }
+    }
+
+    void SyncImpl()
+    {
+        if (pending == 0)
+            return;
+        FlushFileBuffers(file);
+        pending = 0;
+        lastSync = std::chrono::steady_clock::now();
+    }
+
+public:
+    explicit ExportJournal(std::filesystem::path journal,
+                           const size_t syncEvery = 64,
+                           const std::chrono::milliseconds syncInterval = std::chrono::milliseconds(2000))
+        : path(std::move(journal)), syncEvery(syncEvery), syncInterval(syncInterval)
+    {
+        Load();
+
+        file = CreateFileW(path.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                           OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            throw Ex(WinApiException, "CreateFileW: {}: {}", ToImString(path), GetLastError());
+
+        // finish a line a crash cut short so the next record starts on its own
+        if (torn)
+        {
+            DWORD written = 0;
+            WriteFile(file, "\n", 1, &written, nullptr);
+        }
+    }
+
+    ExportJournal(const ExportJournal &) = delete;
+    ExportJournal(ExportJournal &&) = delete;
+    ExportJournal &operator=(const ExportJournal &) = delete;
+    ExportJournal &operator=(ExportJournal &&) = delete;
+
+    ~ExportJournal()
+    {
+        if (file != INVALID_HANDLE_VALUE)
+        {
+            SyncImpl();
+            CloseHandle(file);
+        }
+    }
+
+    [[nodiscard]] bool IsDone(const std::filesystem::path &input, const std::filesystem::path &output,
+                              const uint64_t inputHash, const uint64_t presetHash)
+    {
+        std::lock_guard lock(mtx);
+        const auto it = records.find(ToImString(input));
+        if (it == records.end())
+            return false;
+
+        const auto &rec = it->second;
+        return rec.State == Status::Done &&
+               rec.InputHash == inputHash &&
+               rec.PresetHash == presetHash &&
+               rec.Output == ToImString(output) &&
+               exists(output);
+    }
+
+    // Stat-only check: the input is unchanged by size/mtime and the output is
+    // still the file this journal wrote, so nothing needs to be read or decoded.
+    [[nodiscard]] bool IsUpToDate(const std::filesystem::path &input, const std::filesystem::path &output,
+                                  const FileStamp &inputStamp, const uint64_t presetHash)
+    {
+        std::lock_guard lock(mtx);
+        const auto it = records.find(ToImString(input));
+        if (it == records.end())
+            return false;
+
+        const auto &rec = it->second;
+        if (rec.State != Status::Done ||
+            rec.PresetHash != presetHash ||
+            rec.Output != ToImString(output) ||
+            rec.InputStamp != inputStamp)
+            return false;
+
+        const auto outputStamp = FileStamp::Of(output);
+        return outputStamp && *outputStamp == rec.OutputStamp;
+    }
+
+    void Append(Record rec)
+    {
+        auto line = nlohmann::json(rec).dump();
+        line.push_back('\n');
+
+        std::lock_guard lock(mtx);
+
+        DWORD written = 0;
+        if (!WriteFile(file, line.data(), static_cast<DWORD>(line.size()), &written, nullptr) || written != line.size())
+            throw Ex(WinApiException, "WriteFile: {}: {}", ToImString(path), GetLastError());
+
+        auto key = rec.Input;
+        records.insert_or_assign(std::move(key), std::move(rec));
+
+        if (++pending >= syncEvery || std::chrono::steady_clock::now() - lastSync >= syncInterval)
+            SyncImpl();
+    }
+
+    void Sync()
+    {
+        std::lock_guard lock(mtx);
+        SyncImpl();
+    }
+};
+
+// One journal per output directory, opened on first use.
+class ExportJournalSet
+{
+    std::map<std::filesystem::path, std::unique_ptr<ExportJournal>> journals{};
+    std::mutex mtx{};
+
+public:
+    ExportJournal &For(const std::filesystem::path &output)
+    {
+        const auto dir = output.parent_path();
+
+        std::lock_guard lock(mtx);
+        auto &journal = journals[dir];
+        if (!journal)
+        {
+            if (!exists(dir))
+                create_directories(dir);
+            journal = std::make_unique<ExportJournal>(dir / ExportJournal::FileName);
+        }
+        return *journal;
+    }
+
+    void Clear()
+    {
+        std::lock_guard lock(mtx);
+        journals.clear();
+    }
+};
@@ -24,6 +24,14 @@ MakeStr(type);
 MakeEnum(_Language, English, Chinese);
 MakeEnum(_NormalMapConvertFormat, RGB, DA);
 MakeEnum(_ColorBalance_Range, Shadows, Midtones, Highlights);
+MakeEnum(_GenerateNormal_Operator, Central, Prewitt, Sobel, Scharr, Sobel5x5);
+MakeEnum(_GenerateNormal_Channel, R, G, B, A, Luma);
+MakeEnum(_ChannelSwizzle_Source, R, G, B, A, Zero, One, NormalZ);
+MakeEnum(_Resample_Filter, Box, Triangle, Bicubic, Lanczos3, Kaiser);
+MakeEnum(_Dds_Format, BC1, BC3, BC4, BC5, BC7);
+MakeEnum(_Dds_Quality, Fast, Normal, Best);
+MakeEnum(_Png_Level, Store, Fast, Default, Max);
+MakeEnum(_Jpeg_Subsampling, Yuv444, Yuv422, Yuv420);
 
 inline nlohmann::json FilePacker(const std::filesystem::path &path)
 {
@@ -103,6 +111,17 @@ namespace nlohmann
         }
     };
 
+    template <>
+    struct adl_serializer<BatchMode>
+    {
+        static void to_json(json &j, const BatchMode &v) { j = Enum::ToString<BatchMode>(v); }
+
+        static void from_json(const json &j, BatchMode &v)
+        {
+            v = Enum::FromString<BatchMode>(j.get<std::string>());
+        }
+    };
+
     template <>
     struct adl_serializer<ImageTools::ColorBalance::Range>
     {
@@ -118,6 +137,122 @@ namespace nlohmann
         }
     };
 
+    template <>
+    struct adl_serializer<ImageTools::GenerateNormalTexture::Operator>
+    {
+        static void to_json(json &j, const ImageTools::GenerateNormalTexture::Operator v)
+        {
+            j = Enum::ToString<_GenerateNormal_Operator>(static_cast<_GenerateNormal_Operator>(v));
+        }
+
+        static void from_json(const json &j, ImageTools::GenerateNormalTexture::Operator &v)
+        {
+            v = static_cast<ImageTools::GenerateNormalTexture::Operator>(
+                Enum::FromString<_GenerateNormal_Operator>(j.get<std::string>()));
+        }
+    };
+
+    template <>
+    struct adl_serializer<ImageTools::GenerateNormalTexture::Channel>
+    {
+        static void to_json(json &j, const ImageTools::GenerateNormalTexture::Channel v)
+        {
+            j = Enum::ToString<_GenerateNormal_Channel>(static_cast<_GenerateNormal_Channel>(v));
+        }
+
+        static void from_json(const json &j, ImageTools::GenerateNormalTexture::Channel &v)
+        {
+            v = static_cast<ImageTools::GenerateNormalTexture::Channel>(
+                Enum::FromString<_GenerateNormal_Channel>(j.get<std::string>()));
+        }
+    };
+
+    template <>
+    struct adl_serializer<ImageTools::ChannelSwizzle::Source>
+    {
+        static void to_json(json &j, const ImageTools::ChannelSwizzle::Source v)
+        {
+            j = Enum::ToString<_ChannelSwizzle_Source>(static_cast<_ChannelSwizzle_Source>(v));
+        }
+
+        static void from_json(const json &j, ImageTools::ChannelSwizzle::Source &v)
+        {
+            v = static_cast<ImageTools::ChannelSwizzle::Source>(
+                Enum::FromString<_ChannelSwizzle_Source>(j.get<std::string>()));
+        }
+    };
+
+    template <>
+    struct adl_serializer<ImageTools::Resample::Filter>
+    {
+        static void to_json(json &j, const ImageTools::Resample::Filter v)
+        {
+            j = Enum::ToString<_Resample_Filter>(static_cast<_Resample_Filter>(v));
+        }
+
+        static void from_json(const json &j, ImageTools::Resample::Filter &v)
+        {
+            v = static_cast<ImageTools::Resample::Filter>(
+                Enum::FromString<_Resample_Filter>(j.get<std::string>()));
+        }
+    };
+
+    template <>
+    struct adl_serializer<Dds::Format>
+    {
+        static void to_json(json &j, const Dds::Format &v)
+        {
+            j = Enum::ToString<_Dds_Format>(static_cast<_Dds_Format>(v));
+        }
+
+        static void from_json(const json &j, Dds::Format &v)
+        {
+            v = static_cast<Dds::Format>(Enum::FromString<_Dds_Format>(j.get<std::string>()));
+        }
+    };
+
+    template <>
+    struct adl_serializer<Dds::Quality>
+    {
+        static void to_json(json &j, const Dds::Quality &v)
+        {
+            j = Enum::ToString<_Dds_Quality>(static_cast<_Dds_Quality>(v));
+        }
+
+        static void from_json(const json &j, Dds::Quality &v)
+        {
+            v = static_cast<Dds::Quality>(Enum::FromString<_Dds_Quality>(j.get<std::string>()));
+        }
+    };
+
+    template <>
+    struct adl_serializer<Png::Level>
+    {
+        static void to_json(json &j, const Png::Level &v)
+        {
+            j = Enum::ToString<_Png_Level>(static_cast<_Png_Level>(v));
+        }
+
+        static void from_json(const json &j, Png::Level &v)
+        {
+            v = static_cast<Png::Level>(Enum::FromString<_Png_Level>(j.get<std::string>()));
+        }
+    };
+
+    template <>
+    struct adl_serializer<Jpeg::Subsampling>
+    {
+        static void to_json(json &j, const Jpeg::Subsampling &v)
+        {
+            j = Enum::ToString<_Jpeg_Subsampling>(static_cast<_Jpeg_Subsampling>(v));
+        }
+
+        static void from_json(const json &j, Jpeg::Subsampling &v)
+        {
+            v = static_cast<Jpeg::Subsampling>(Enum::FromString<_Jpeg_Subsampling>(j.get<std::string>()));
+        }
+    };
+
     // template <>
     // struct adl_serializer<std::u8string>
     // {
@@ -163,3 +298,24 @@ namespace nlohmann
         }
     };
 }
+
+namespace Dds
+{
+    NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(Options, Format, Quality, Mipmaps)
+}
+
+namespace Png
+{
+    NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(Options, Level)
+}
+
+namespace Jpeg
+{
+    NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(Options, Quality, Subsampling)
+}
+
+namespace Image
+{
+    NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(SaveOptions, Dds, Png, Jpeg)
+    NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(ImageInfo, Width, Height, Channels, Depth)
+}
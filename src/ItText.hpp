@@ -165,6 +165,24 @@ namespace Text
         MakeCnText("法线格式转换");
     }
 
+    MakeFunc(ChannelSwizzle)
+    {
+        MakeEnText("Channel Swizzle");
+        MakeCnText("通道重排");
+    }
+
+    MakeFunc(Resize)
+    {
+        MakeEnText("Resize");
+        MakeCnText("缩放");
+    }
+
+    MakeFunc(Mipmap)
+    {
+        MakeEnText("Mipmap");
+        MakeCnText("多级纹理");
+    }
+
     MakeFunc(InputFormat)
     {
         MakeEnText("Input Format");
@@ -225,6 +243,24 @@ namespace Text
         MakeCnText("格式");
     }
 
+    MakeFunc(Compression)
+    {
+        MakeEnText("Compression");
+        MakeCnText("压缩格式");
+    }
+
+    MakeFunc(Quality)
+    {
+        MakeEnText("Quality");
+        MakeCnText("质量");
+    }
+
+    MakeFunc(Subsampling)
+    {
+        MakeEnText("Chroma Subsampling");
+        MakeCnText("色度抽样");
+    }
+
     MakeFunc(ColorLookup)
     {
         MakeEnText("Color Lookup");
@@ -477,6 +513,24 @@ namespace Text
         MakeCnText("无限制");
     }
 
+    MakeFunc(PreviewSize)
+    {
+        MakeEnText("Preview Size");
+        MakeCnText("预览尺寸");
+    }
+
+    MakeFunc(PreviewSizeTip)
+    {
+        MakeEnText("Longest side previews are loaded at, applies to images opened afterwards");
+        MakeCnText("载入预览的最长边, 对之后打开的图片生效");
+    }
+
+    MakeFunc(FullSize)
+    {
+        MakeEnText("Full Size");
+        MakeCnText("原尺寸");
+    }
+
     MakeFunc(Base64ToImage)
     {
         MakeEnText("Base64 To Image");
@@ -495,6 +549,78 @@ namespace Text
         MakeCnText("重置");
     }
 
+    MakeFunc(ResumeExport)
+    {
+        MakeEnText("Resume (skip finished files)");
+        MakeCnText("断点续传(跳过已完成文件)");
+    }
+
+    MakeFunc(IncrementalExport)
+    {
+        MakeEnText("Incremental (skip up-to-date outputs)");
+        MakeCnText("增量导出(跳过已是最新的输出)");
+    }
+
+    MakeFunc(IncrementalExportTip)
+    {
+        MakeEnText("Compare input size/modification time and the preset with the journal next to the output, without reading the input");
+        MakeCnText("根据输出目录中的记录比较输入文件大小/修改时间与预设, 不读取输入文件");
+    }
+
+    MakeFunc(UpToDate)
+    {
+        MakeEnText("Up to date");
+        MakeCnText("已是最新");
+    }
+
+    MakeFunc(WorkerProcesses)
+    {
+        MakeEnText("Worker processes");
+        MakeCnText("工作进程数");
+    }
+
+    MakeFunc(WorkerProcessesTip)
+    {
+        MakeEnText("Export in separate CPU-only processes, a crashing file only takes down its own worker");
+        MakeCnText("在独立的进程中导出(仅CPU), 出错的文件只会导致所在的工作进程崩溃");
+    }
+
+    MakeFunc(WorkerScheduling)
+    {
+        MakeEnText("Scheduling");
+        MakeCnText("调度方式");
+    }
+
+    MakeFunc(Watch)
+    {
+        MakeEnText("Watch");
+        MakeCnText("监视");
+    }
+
+    MakeFunc(WatchTip)
+    {
+        MakeEnText("Keep exporting images as they are added to or changed in the input directories, until cancelled");
+        MakeCnText("持续导出输入目录中新增或修改的图片, 直到取消");
+    }
+
+    MakeFunc(Watching)
+    {
+        MakeEnText("Watching...");
+        MakeCnText("监视中...");
+    }
+
+    MakeFunc(WatchNeedsDirectory)
+    {
+        MakeEnText("Watch needs at least one input directory");
+        MakeCnText("监视需要至少一个输入目录");
+    }
+
+    MakeFunc(Skipped)
+    {
+        MakeEnText("Skipped");
+        MakeCnText("已跳过");
+    }
+
 #undef MakeFunc
 #undef MakeText
 
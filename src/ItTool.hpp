@@ -1,6 +1,7 @@
 #pragma once
 
-#include <stb_image_resize.h>
+#include <memory>
+#include <mutex>
 
 #include <waifu2x-ncnn-vulkan/src/waifu2x.h>
 #include <realsr-ncnn-vulkan/src/realsr.h>
@@ -28,10 +29,10 @@ public:
 
     explicit ToolCombine(ToolType tool) : Tool(std::move(tool)) {}
 
-    void ImgRef(const Image::ImageFile &img)
+    void Bind(const Image::ImageFile &img)
     {
         std::visit([&](auto &t)
-                   { t.ImgRef(img); },
+                   { t.Bind(img); },
                    Tool);
     }
 
@@ -48,78 +49,101 @@ public:
                           { return t(row, col); },
                           Tool);
     }
+
+    void ProcessRow(const int64_t row, uint8_t *dst)
+    {
+        std::visit([&](auto &t)
+                   { ImageTools::ProcessRow(t, row, dst); },
+                   Tool);
+    }
 };
 
 class Waifu2xNcnn : public ImageTools::ITool<Waifu2xNcnn>
 {
-    int Noise = 3;
-    int TileSize = -1;
+public:
+    // network with its weights loaded, shared by every copy of the processor;
+    // ncnn keeps per-run state in the net so runs are serialized
+    struct Model
+    {
+        Waifu2x Net;
+        std::mutex Mtx{};
+
+        Model(const int noise, const int tileSize) : Net(ncnn::get_default_gpu_index(), false, 1)
+        {
+            Net.scale = 2;
+            Net.noise = noise;
+            Net.prepadding = 18;
+            Net.tilesize = tileSize;
+            if (tileSize == -1)
+            {
+                if (const auto heap = ncnn::get_gpu_device(ncnn::get_default_gpu_index())
+                                          ->get_heap_budget();
+                    heap > 2600)
+                    Net.tilesize = 400;
+                else if (heap > 740)
+                    Net.tilesize = 200;
+                else if (heap > 250)
+                    Net.tilesize = 100;
+                else
+                    Net.tilesize = 32;
+            }
+
+            static const RcResource CunetNoise0(MAKEINTRESOURCE(CUNET_NOISE0), RT_RCDATA, "CUNET_NOISE0");
+            static const RcResource CunetNoise1(MAKEINTRESOURCE(CUNET_NOISE1), RT_RCDATA, "CUNET_NOISE1");
+            static const RcResource CunetNoise2(MAKEINTRESOURCE(CUNET_NOISE2), RT_RCDATA, "CUNET_NOISE2");
+            static const RcResource CunetNoise3(MAKEINTRESOURCE(CUNET_NOISE3), RT_RCDATA, "CUNET_NOISE3");
+
+            switch (noise)
+            {
+            case 0:
+                Net.load(reinterpret_cast<const char *>(noise0_scale2_0x_model_param),
+                         CunetNoise0.Get().data());
+                break;
+            case 1:
+                Net.load(reinterpret_cast<const char *>(noise1_scale2_0x_model_param),
+                         CunetNoise1.Get().data());
+                break;
+            case 2:
+                Net.load(reinterpret_cast<const char *>(noise2_scale2_0x_model_param),
+                         CunetNoise2.Get().data());
+                break;
+            case 3:
+                Net.load(reinterpret_cast<const char *>(noise3_scale2_0x_model_param),
+                         CunetNoise3.Get().data());
+                break;
+            default:
+                assert((false, "invalid noise"));
+            }
+        }
+    };
+
+private:
+    std::shared_ptr<Model> model{};
 
     ImageTools::ImageSize OutputSize{};
     ncnn::Mat OutputBuffer{};
     Image::ImageFile Output{};
 
 public:
+    explicit Waifu2xNcnn(std::shared_ptr<Model> model) : model(std::move(model)) {}
+
     Waifu2xNcnn(const int noise, const int tileSize)
-        : Noise(noise), TileSize(tileSize) {}
+        : model(std::make_shared<Model>(noise, tileSize)) {}
 
-    void ImgRef(const Image::ImageFile &img)
+    void Bind(const Image::ImageFile &img)
     {
         _ImgRef = &img;
 
-        Waifu2x waifu2x(ncnn::get_default_gpu_index(), false, 1);
-        waifu2x.scale = 2;
-        waifu2x.noise = Noise;
-        waifu2x.prepadding = 18;
-        waifu2x.tilesize = TileSize;
-        if (TileSize == -1)
-        {
-            if (const auto heap = ncnn::get_gpu_device(ncnn::get_default_gpu_index())
-                                      ->get_heap_budget();
-                heap > 2600)
-                waifu2x.tilesize = 400;
-            else if (heap > 740)
-                waifu2x.tilesize = 200;
-            else if (heap > 250)
-                waifu2x.tilesize = 100;
-            else
-                waifu2x.tilesize = 32;
-        }
-
-        static const RcResource CunetNoise0(MAKEINTRESOURCE(CUNET_NOISE0), RT_RCDATA, "CUNET_NOISE0");
-        static const RcResource CunetNoise1(MAKEINTRESOURCE(CUNET_NOISE1), RT_RCDATA, "CUNET_NOISE1");
-        static const RcResource CunetNoise2(MAKEINTRESOURCE(CUNET_NOISE2), RT_RCDATA, "CUNET_NOISE2");
-        static const RcResource CunetNoise3(MAKEINTRESOURCE(CUNET_NOISE3), RT_RCDATA, "CUNET_NOISE3");
-
-        switch (Noise)
-        {
-        case 0:
-            waifu2x.load(reinterpret_cast<const char *>(noise0_scale2_0x_model_param),
-                         CunetNoise0.Get().data());
-            break;
-        case 1:
-            waifu2x.load(reinterpret_cast<const char *>(noise1_scale2_0x_model_param),
-                         CunetNoise1.Get().data());
-            break;
-        case 2:
-            waifu2x.load(reinterpret_cast<const char *>(noise2_scale2_0x_model_param),
-                         CunetNoise2.Get().data());
-            break;
-        case 3:
-            waifu2x.load(reinterpret_cast<const char *>(noise3_scale2_0x_model_param),
-                         CunetNoise3.Get().data());
-            break;
-        default:
-            assert((false, "invalid noise"));
-        }
-
         const ncnn::Mat input(_ImgRef->Width(), _ImgRef->Height(),
                               (void *)_ImgRef->Data(), 4, 4);
 
         OutputSize = {_ImgRef->Width() * 2, _ImgRef->Height() * 2};
         OutputBuffer = {OutputSize.Width, OutputSize.Height, 4, 4};
 
-        waifu2x.process(input, OutputBuffer);
+        {
+            std::lock_guard lock(model->Mtx);
+            model->Net.process(input, OutputBuffer);
+        }
 
         Output = {static_cast<uint8_t *>(OutputBuffer.data), OutputSize.Width,
                   OutputSize.Height, false};
@@ -149,12 +173,12 @@ private:
 
 public:
     LinearDodge(const float color[4]) : proc(ColorProc(Image::FloatToUint8({color[0], color[1], color[2], color[3]}))) {}
-    LinearDodge(const std::filesystem::path &param) : proc(ImageProc(param)) {}
+    LinearDodge(std::shared_ptr<const ImageTools::ResampledImage> overlay) : proc(ImageProc(std::move(overlay))) {}
 
-    void ImgRef(const Image::ImageFile &img)
+    void Bind(const Image::ImageFile &img)
     {
         std::visit([&](auto &p)
-                   { p.ImgRef(img); },
+                   { p.Bind(img); },
                    proc);
     }
 
@@ -171,64 +195,85 @@ public:
                           { return p(row, col); },
                           proc);
     }
+
+    void ProcessRow(const int64_t row, uint8_t *dst)
+    {
+        std::visit([&](auto &p)
+                   { ImageTools::ProcessRow(p, row, dst); },
+                   proc);
+    }
 };
 
 MakeEnum(RealsrNcnnModel, DF2K_X4, DF2K_JPEG_X4);
 
 class RealsrNcnn : public ImageTools::ITool<RealsrNcnn>
 {
+public:
+    // see Waifu2xNcnn::Model
+    struct Model
+    {
+        RealSR Net;
+        std::mutex Mtx{};
+
+        Model(const RealsrNcnnModel model, const bool useTta) : Net(ncnn::get_default_gpu_index(), useTta)
+        {
+            if (const auto heap = ncnn::get_gpu_device(ncnn::get_default_gpu_index())->get_heap_budget(); heap > 1900)
+                Net.tilesize = 200;
+            else if (heap > 550)
+                Net.tilesize = 100;
+            else if (heap > 190)
+                Net.tilesize = 64;
+            else
+                Net.tilesize = 32;
+
+            Net.scale = 4;
+            Net.prepadding = 10;
+
+            static const RcResource Df2k(MAKEINTRESOURCE(DF2K), RT_RCDATA, "DF2K");
+            static const RcResource Df2k_Jpeg(MAKEINTRESOURCE(DF2K_JPEG), RT_RCDATA, "DF2K_JPEG");
+
+            if (model == RealsrNcnnModel::DF2K_X4)
+            {
+                Net.load(reinterpret_cast<const char *>(realsr_df2k_x4_param), Df2k.Get().data());
+            }
+            else if (model == RealsrNcnnModel::DF2K_JPEG_X4)
+            {
+                Net.load(reinterpret_cast<const char *>(realsr_df2k_jpeg_x4_param), Df2k_Jpeg.Get().data());
+            }
+            else
+            {
+                assert((false, "invalid realsr model"));
+            }
+        }
+    };
+
+private:
+    std::shared_ptr<Model> model{};
+
     ImageTools::ImageSize OutputSize{};
     ncnn::Mat OutputBuffer{};
     Image::ImageFile Output{};
 
-    RealsrNcnnModel Model = RealsrNcnnModel::DF2K_JPEG_X4;
-    bool UseTta = false;
-
 public:
-    RealsrNcnn(const RealsrNcnnModel model, const bool useTta) : Model(model), UseTta(useTta) {}
+    explicit RealsrNcnn(std::shared_ptr<Model> model) : model(std::move(model)) {}
+
+    RealsrNcnn(const RealsrNcnnModel model, const bool useTta)
+        : model(std::make_shared<Model>(model, useTta)) {}
 
-    void ImgRef(const Image::ImageFile &img)
+    void Bind(const Image::ImageFile &img)
     {
         _ImgRef = &img;
 
-        const auto gpu = ncnn::get_default_gpu_index();
-        RealSR realsr(gpu, UseTta);
-
-        if (const auto heap = ncnn::get_gpu_device(gpu)->get_heap_budget(); heap > 1900)
-            realsr.tilesize = 200;
-        else if (heap > 550)
-            realsr.tilesize = 100;
-        else if (heap > 190)
-            realsr.tilesize = 64;
-        else
-            realsr.tilesize = 32;
-
-        realsr.scale = 4;
-        realsr.prepadding = 10;
-
-        static const RcResource Df2k(MAKEINTRESOURCE(DF2K), RT_RCDATA, "DF2K");
-        static const RcResource Df2k_Jpeg(MAKEINTRESOURCE(DF2K_JPEG), RT_RCDATA, "DF2K_JPEG");
-
-        if (Model == RealsrNcnnModel::DF2K_X4)
-        {
-            realsr.load(reinterpret_cast<const char *>(realsr_df2k_x4_param), Df2k.Get().data());
-        }
-        else if (Model == RealsrNcnnModel::DF2K_JPEG_X4)
-        {
-            realsr.load(reinterpret_cast<const char *>(realsr_df2k_jpeg_x4_param), Df2k_Jpeg.Get().data());
-        }
-        else
-        {
-            assert((false, "invalid realsr model"));
-        }
-
         const ncnn::Mat input(_ImgRef->Width(), _ImgRef->Height(),
                               (void *)_ImgRef->Data(), 4, 4);
 
         OutputSize = {_ImgRef->Width() * 4, _ImgRef->Height() * 4};
         OutputBuffer = {OutputSize.Width, OutputSize.Height, 4, 4};
 
-        realsr.process(input, OutputBuffer);
+        {
+            std::lock_guard lock(model->Mtx);
+            model->Net.process(input, OutputBuffer);
+        }
 
         Output = {static_cast<uint8_t *>(OutputBuffer.data), OutputSize.Width,
                   OutputSize.Height, false};
@@ -243,34 +288,3 @@ public:
 
     Image::ImageFile &GetOutputImage() { return Output; }
 };
-
-class StbResize : public ImageTools::ITool<StbResize>
-{
-    int scale = 1;
-    ImageTools::ImageSize OutputSize{};
-    Image::ImageFile OutputImage{};
-
-public:
-    explicit StbResize(const int scale) : scale(scale) {}
-
-    void ImgRef(const Image::ImageFile &img)
-    {
-        _ImgRef = &img;
-
-        OutputSize = {_ImgRef->Width() * scale, _ImgRef->Height() * scale};
-        OutputImage = {OutputSize.Width, OutputSize.Height};
-
-        stbir_resize_uint8(_ImgRef->Data(), _ImgRef->Width(), _ImgRef->Height(),
-                           0, OutputImage.Data(), OutputSize.Width, OutputSize.Height,
-                           0, 4);
-    }
-
-    [[nodiscard]] const ImageTools::ImageSize &GetOutputSize() const { return OutputSize; }
-
-    Image::ColorRgba<uint8_t> operator()(const int64_t row, const int64_t col) const
-    {
-        return OutputImage.At<uint8_t>(row, col);
-    }
-
-    Image::ImageFile &GetOutputImage() { return OutputImage; }
-};
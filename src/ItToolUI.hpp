@@ -2,6 +2,8 @@
 
 #include <any>
 #include <filesystem>
+#include <memory>
+#include <mutex>
 #include <ranges>
 
 #include "Convert/Convert.hpp"
@@ -17,6 +19,7 @@
 
 #include <misc/cpp/imgui_stdlib.h>
 
+#include "Shader_ChannelSwizzle.h"
 #include "Shader_ColorBalance.h"
 #include "Shader_GenerateNormalTexture.h"
 #include "Shader_HueSaturation.h"
@@ -24,7 +27,7 @@
 #include "Shader_LinearDodgeColor.h"
 #include "Shader_LinearDodgeImage.h"
 #include "Shader_LinearResize.h"
-#include "Shader_NormalMapConvertorRGB2DA.h"
+#include "Shader_Resample.h"
 
 template <typename Impl>
 struct ITool
@@ -40,9 +43,10 @@ struct ITool
 
     void UI(bool &needUpdate) { return static_cast<Impl *>(this)->UI(); }
 
-    [[nodiscard]] decltype(auto) Processor() const
+    // image independent setup for a batch, the result is copied and bound per image
+    [[nodiscard]] decltype(auto) Prepare() const
     {
-        return static_cast<Impl *>(this)->Processor();
+        return static_cast<Impl *>(this)->Prepare();
     }
 
     [[nodiscard]] std::optional<ImageView>
@@ -59,6 +63,56 @@ struct ITool
     }
 };
 
+// Keeps the last heavy resource a tool prepared (parsed LUT, decoded overlay,
+// loaded network) so preparing again with unchanged settings costs nothing.
+template <typename Key, typename T>
+class PreparedCache
+{
+    mutable std::mutex mtx{};
+    mutable std::optional<Key> key{};
+    mutable std::shared_ptr<T> value{};
+
+public:
+    PreparedCache() = default;
+    PreparedCache(const PreparedCache &other)
+    {
+        std::lock_guard lock(other.mtx);
+        key = other.key;
+        value = other.value;
+    }
+    PreparedCache &operator=(const PreparedCache &other)
+    {
+        if (this != &other)
+        {
+            std::scoped_lock lock(mtx, other.mtx);
+            key = other.key;
+            value = other.value;
+        }
+        return *this;
+    }
+
+    template <typename Fn>
+    std::shared_ptr<T> Get(const Key &k, Fn &&make) const
+    {
+        std::lock_guard lock(mtx);
+        if (!key || *key != k)
+        {
+            value = make();
+            key = k;
+        }
+        return value;
+    }
+};
+
+// a file is reloaded when it is replaced or edited in place
+using FileKey = std::pair<std::filesystem::path, std::filesystem::file_time_type>;
+
+inline FileKey MakeFileKey(const std::filesystem::path &file)
+{
+    std::error_code ec;
+    return {file, last_write_time(file, ec)};
+}
+
 #pragma region InitShader
 #define InitShader(func, sh)                                                     \
     static std::unordered_map<Dx11DevType *,                                     \
@@ -114,6 +168,8 @@ struct LutTool : ITool<LutTool>
         Check();
     }
 
+    PreparedCache<FileKey, const Lut::CubeLut> Cube{};
+
     [[nodiscard]] nlohmann::json SaveData() const
     {
         auto obj = nlohmann::json::object();
@@ -175,11 +231,13 @@ struct LutTool : ITool<LutTool>
             ImGui::TextColored({1.f, 0.f, 0.f, 1.f}, "* %s", Text::InvalidPath());
     }
 
-    [[nodiscard]] std::optional<ProcessorType> Processor() const
+    [[nodiscard]] std::optional<ProcessorType> Prepare() const
     {
         if (!Valid)
             return {};
-        return ProcessorType(Data.CubeFilePath.GetView());
+        const auto path = Data.CubeFilePath.GetPath();
+        return ProcessorType(Cube.Get(MakeFileKey(path), [&]
+                                      { return ProcessorType::Load(path); }));
     }
 
     struct ShaderData
@@ -192,24 +250,22 @@ struct LutTool : ITool<LutTool>
     [[nodiscard]] std::optional<ImageView>
     GPU(Dx11DevType *dev, Dx11DevCtxType *devCtx, const ImageView &input)
     {
-        static Lut::CubeLut cube;
-
         if (!Valid)
             return {};
 
-        if (static U8String path; path != Data.CubeFilePath)
+        std::shared_ptr<const Lut::CubeLut> cubePtr{};
+        try
         {
-            path = Data.CubeFilePath;
-            try
-            {
-                cube = Lut::CubeLut::FromCubeFile(Data.CubeFilePath.GetPath());
-            }
-            catch (...)
-            {
-                Valid = false;
-                return {};
-            }
+            const auto path = Data.CubeFilePath.GetPath();
+            cubePtr = Cube.Get(MakeFileKey(path), [&]
+                               { return ProcessorType::Load(path); });
+        }
+        catch (...)
+        {
+            Valid = false;
+            return {};
         }
+        const auto &cube = *cubePtr;
 
         InitShader("LutTool", g_LUT3D);
 
@@ -245,179 +301,6 @@ struct LutTool : ITool<LutTool>
     }
 };
 
-#if 0
-struct LinearDodgeColorTool : ITool<LinearDodgeColorTool>
-{
-	using ProcessorType = ImageTools::LinearDodgeColor;
-
-	struct ToolData
-	{
-		std::array<float, 4> Color = {0, 0, 0, 0};
-
-		NLOHMANN_DEFINE_TYPE_INTRUSIVE(ToolData, Color)
-	} Data;
-
-	nlohmann::json SaveData() const
-	{
-		return nlohmann::json::object({{String_data, Data}});
-	}
-
-	void LoadData(const nlohmann::json &obj) { obj[String_data].get_to(Data); }
-
-	static const char *Name() { return Text::LinearDodgeColor(); }
-
-	void UI(bool &needUpdate)
-	{
-		ImGui::ColorEdit4(Text::Color(), Data.Color.data());
-		if (ImGui::IsItemEdited())
-			needUpdate = true;
-	}
-
-	[[nodiscard]] std::optional<ProcessorType> Processor() const
-	{
-		return ProcessorType(
-			Image::ColorRgba<uint8_t>(Data.Color[0] * 255., Data.Color[1] * 255.,
-									  Data.Color[2] * 255., Data.Color[3] * 255.));
-	}
-
-	[[nodiscard]] std::optional<ImageView>
-	GPU(Dx11DevType *dev, Dx11DevCtxType *devCtx, const ImageView &input)
-	{
-		InitShader("LinearDodgeColorTool", g_LinearDodgeColor);
-
-		const auto resBuf =
-			D3D11::CreateTexture2dUavBuf(dev, input.Width, input.Height);
-		const auto resBufUav = D3D11::CreateTexture2dUav(dev, resBuf.Get());
-
-		const auto dataBuf = D3D11::CreateStructuredBuffer(dev, sizeof(float) * 4,
-														   1, Data.Color.data());
-		const auto dataSrv = D3D11::CreateBufferSRV(dev, dataBuf.Get());
-
-		ID3D11ShaderResourceView *srvs[2] = {input.SRV.Get(), dataSrv.Get()};
-		ID3D11UnorderedAccessView *uavs[] = {resBufUav.Get()};
-		D3D11::RunComputeShader(devCtx, g_LinearDodgeColorShader, srvs, uavs,
-								D3D11::GetThreadGroupNum(input.Width),
-								D3D11::GetThreadGroupNum(input.Height), 1);
-
-		return ImageView(input, D3D11::CreateSrvFromTex(dev, resBuf.Get()));
-	}
-};
-
-struct LinearDodgeImageTool : ITool<LinearDodgeImageTool>
-{
-	using ProcessorType = ImageTools::LinearDodgeImage;
-
-	struct ToolData
-	{
-		U8String ImagePath;
-
-		NLOHMANN_DEFINE_TYPE_INTRUSIVE(ToolData, ImagePath)
-	} Data;
-
-	nlohmann::json SaveData() const
-	{
-		auto obj = nlohmann::json::object();
-		if (Data.ImagePath.Empty())
-		{
-			obj[String_data] = nullptr;
-		}
-		else
-		{
-			const auto path = Data.ImagePath.GetPath();
-			obj[String_data] = File::ReadAll(path);
-			obj[String_ext] = path.extension().u8string();
-		}
-		return obj;
-	}
-
-	void LoadData(const nlohmann::json &obj)
-	{
-		const auto data = obj[String_data].get<std::string>();
-		const auto ext = obj[String_ext].get<std::u8string>();
-
-		const auto tmpPath =
-			Config::TmpDir / String::FormatW("{}{}", UUID4(), ext);
-		File::WriteAll(tmpPath, data);
-		Data.ImagePath = tmpPath.u8string();
-		Valid = true;
-	}
-
-	bool Valid = false;
-
-	static const char *Name() { return Text::LinearDodgeImage(); }
-
-	bool Check()
-	{
-		Valid = false;
-		if (!Data.ImagePath.Empty() && exists(Data.ImagePath.GetPath()))
-			Valid = true;
-		return Valid;
-	}
-
-	void UI(bool &needUpdate)
-	{
-		ImGui::InputText(Text::ImageFile(), &Data.ImagePath.Buf);
-		if (ImGui::IsItemEdited())
-			if (Check())
-				needUpdate = true;
-		ImGui::SameLine();
-		if (ImGui::Button(Text::SelectSomething()))
-		{
-			if (const auto p = Pick::PickFile(); !p.empty())
-				Data.ImagePath.Set(p.u8string());
-			if (Check())
-				needUpdate = true;
-		}
-		if (!Valid)
-			ImGui::TextColored({1.f, 0.f, 0.f, 1.f}, "* %s", Text::InvalidPath());
-	}
-
-	[[nodiscard]] std::optional<ProcessorType> Processor() const
-	{
-		if (!Valid)
-			return {};
-		return ProcessorType(Data.ImagePath.GetPath());
-	}
-
-	[[nodiscard]] std::optional<ImageView>
-	GPU(Dx11DevType *dev, Dx11DevCtxType *devCtx, const ImageView &input)
-	{
-		static std::filesystem::path refPath{};
-		static Image::ImageFile ref{};
-
-		if (!Valid)
-			return {};
-
-		if (Data.ImagePath.GetPath() != refPath)
-		{
-			ref = Image::ImageFile(Data.ImagePath.GetPath());
-			if (ref.Empty())
-			{
-				Valid = false;
-				return {};
-			}
-			refPath = Data.ImagePath.GetPath();
-		}
-
-		InitShader("LinearDodgeImageTool", g_LinearDodgeImage);
-
-		const auto resBuf =
-			D3D11::CreateTexture2dUavBuf(dev, input.Width, input.Height);
-		const auto resBufUav = D3D11::CreateTexture2dUav(dev, resBuf.Get());
-
-		const auto refSrv = D3D11::LoadTextureFromFile(dev, ref);
-
-		ID3D11ShaderResourceView *srvs[2] = {input.SRV.Get(), refSrv.SRV.Get()};
-		ID3D11UnorderedAccessView *uavs[] = {resBufUav.Get()};
-		D3D11::RunComputeShader(devCtx, g_LinearDodgeImageShader, srvs, uavs,
-								D3D11::GetThreadGroupNum(input.Width),
-								D3D11::GetThreadGroupNum(input.Height), 1);
-
-		return ImageView(input, D3D11::CreateSrvFromTex(dev, resBuf.Get()));
-	}
-};
-#endif
-
 struct LinearDodgeTool : ITool<LinearDodgeTool>
 {
     using ProcessorType = LinearDodge;
@@ -429,6 +312,13 @@ struct LinearDodgeTool : ITool<LinearDodgeTool>
         U8String ImagePath{};
     } Data;
 
+    PreparedCache<FileKey, const ImageTools::ResampledImage> Overlay{};
+
+    static std::shared_ptr<const ImageTools::ResampledImage> LoadOverlay(const std::filesystem::path &path)
+    {
+        return std::make_shared<const ImageTools::ResampledImage>(std::make_shared<const Image::ImageFile>(path));
+    }
+
     [[nodiscard]] nlohmann::json SaveData() const
     {
         auto obj = nlohmann::json::object();
@@ -529,7 +419,7 @@ struct LinearDodgeTool : ITool<LinearDodgeTool>
         }
     }
 
-    [[nodiscard]] std::optional<ProcessorType> Processor() const
+    [[nodiscard]] std::optional<ProcessorType> Prepare() const
     {
         if (Data.Type == LinearDodgeType::Color)
         {
@@ -540,7 +430,9 @@ struct LinearDodgeTool : ITool<LinearDodgeTool>
             if (!Valid)
                 return {};
 
-            return ProcessorType(Data.ImagePath.GetPath());
+            const auto path = Data.ImagePath.GetPath();
+            return ProcessorType(Overlay.Get(MakeFileKey(path), [&]
+                                             { return LoadOverlay(path); }));
         }
         else
         {
@@ -574,22 +466,23 @@ struct LinearDodgeTool : ITool<LinearDodgeTool>
         }
         else if (Data.Type == LinearDodgeType::Image)
         {
-            static std::filesystem::path refPath{};
-            static Image::ImageFile ref{};
-
             if (!Valid)
                 return {};
 
-            if (Data.ImagePath.GetPath() != refPath)
+            std::shared_ptr<const Image::ImageFile> refPtr{};
+            try
             {
-                ref = Image::ImageFile(Data.ImagePath.GetPath());
-                if (ref.Empty())
-                {
-                    Valid = false;
-                    return {};
-                }
-                refPath = Data.ImagePath.GetPath();
+                const auto path = Data.ImagePath.GetPath();
+                refPtr = Overlay.Get(MakeFileKey(path), [&]
+                                     { return LoadOverlay(path); })
+                             ->At(input.Width, input.Height);
             }
+            catch (...)
+            {
+                Valid = false;
+                return {};
+            }
+            const auto &ref = *refPtr;
 
             InitShader("LinearDodgeImageTool", g_LinearDodgeImage);
 
@@ -625,8 +518,10 @@ struct GenerateNormalTextureTool : ITool<GenerateNormalTextureTool>
         float Bias = 50.;
         bool InvertR = false;
         bool InvertG = false;
+        ProcessorType::Operator Operator = ProcessorType::Operator::Central;
+        ProcessorType::Channel Channel = ProcessorType::Channel::R;
 
-        NLOHMANN_DEFINE_TYPE_INTRUSIVE(ToolData, Bias, InvertR, InvertG)
+        NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(ToolData, Bias, InvertR, InvertG, Operator, Channel)
     } Data;
 
     [[nodiscard]] nlohmann::json SaveData() const
@@ -645,11 +540,25 @@ struct GenerateNormalTextureTool : ITool<GenerateNormalTextureTool>
 
         needUpdate |= ImGui::Checkbox(U8 "invert R", &Data.InvertR);
         needUpdate |= ImGui::Checkbox(U8 "invert G", &Data.InvertG);
+
+        auto op = static_cast<_GenerateNormal_Operator>(Data.Operator);
+        if (GUI::EnumCombo(U8 "operator", op))
+        {
+            Data.Operator = static_cast<ProcessorType::Operator>(op);
+            needUpdate = true;
+        }
+
+        auto channel = static_cast<_GenerateNormal_Channel>(Data.Channel);
+        if (GUI::EnumCombo(U8 "height", channel))
+        {
+            Data.Channel = static_cast<ProcessorType::Channel>(channel);
+            needUpdate = true;
+        }
     }
 
-    [[nodiscard]] std::optional<ProcessorType> Processor() const
+    [[nodiscard]] std::optional<ProcessorType> Prepare() const
     {
-        return ProcessorType(Data.Bias, Data.InvertR, Data.InvertG);
+        return ProcessorType(Data.Bias, Data.InvertR, Data.InvertG, Data.Operator, Data.Channel);
     }
 
     struct ShaderData
@@ -659,6 +568,10 @@ struct GenerateNormalTextureTool : ITool<GenerateNormalTextureTool>
         uint32_t InvertG;
         float Width;
         float Height;
+        int32_t Radius;
+        std::array<float, 4> Weights;
+        ProcessorType::Kernel::Taps Smooth;
+        ProcessorType::Kernel::Taps Deriv;
     };
 
     [[nodiscard]] std::optional<ImageView>
@@ -670,27 +583,119 @@ struct GenerateNormalTextureTool : ITool<GenerateNormalTextureTool>
             D3D11::CreateTexture2dUavBuf(dev, input.Width, input.Height);
         const auto resBufUav = D3D11::CreateTexture2dUav(dev, resBuf.Get());
 
+        const auto kernel = ProcessorType::Kernel::Of(Data.Operator);
         const ShaderData data{Data.Bias, Data.InvertR, Data.InvertG,
                               static_cast<float>(input.Width),
-                              static_cast<float>(input.Height)};
+                              static_cast<float>(input.Height),
+                              kernel.Radius,
+                              ProcessorType::WeightsOf(Data.Channel),
+                              kernel.Smooth,
+                              kernel.Deriv};
         const auto dataBuf =
             D3D11::CreateStructuredBuffer(dev, sizeof(ShaderData), 1, &data);
         const auto dataSrv = D3D11::CreateBufferSRV(dev, dataBuf.Get());
 
-        const auto sam = D3D11::CreateSampler(dev);
-
         ID3D11ShaderResourceView *srvs[2] = {input.SRV.Get(), dataSrv.Get()};
         ID3D11UnorderedAccessView *uavs[1] = {resBufUav.Get()};
-        ID3D11SamplerState *sss[1] = {sam.Get()};
 
         D3D11::RunComputeShader(devCtx, g_GenerateNormalTextureShader, srvs, uavs,
-                                sss, D3D11::GetThreadGroupNum(input.Width),
+                                D3D11::GetThreadGroupNum(input.Width),
                                 D3D11::GetThreadGroupNum(input.Height), 1);
 
         return ImageView(input, D3D11::CreateSrvFromTex(dev, resBuf.Get()));
     }
 };
 
+struct ChannelSwizzleTool : ITool<ChannelSwizzleTool>
+{
+    using ProcessorType = ImageTools::ChannelSwizzle;
+
+    struct ToolData
+    {
+        ProcessorType::Mapping Mapping{ProcessorType::Source::R, ProcessorType::Source::G,
+                                       ProcessorType::Source::B, ProcessorType::Source::A};
+
+        NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(ToolData, Mapping)
+    } Data;
+
+    struct ShaderData
+    {
+        std::array<int32_t, 4> Sources;
+    };
+
+    [[nodiscard]] nlohmann::json SaveData() const
+    {
+        return nlohmann::json::object({{String_data, Data}});
+    }
+
+    void LoadData(const nlohmann::json &obj) { obj[String_data].get_to(Data); }
+
+    static const char *Name() { return Text::ChannelSwizzle(); }
+
+    void UI(bool &needUpdate)
+    {
+        constexpr const char *labels[] = {U8 "R", U8 "G", U8 "B", U8 "A"};
+        for (int c = 0; c < 4; ++c)
+        {
+            auto source = static_cast<_ChannelSwizzle_Source>(Data.Mapping[c]);
+            if (GUI::EnumCombo(labels[c], source))
+            {
+                Data.Mapping[c] = static_cast<ProcessorType::Source>(source);
+                needUpdate = true;
+            }
+        }
+    }
+
+    [[nodiscard]] std::optional<ProcessorType> Prepare() const
+    {
+        if (IsIdentity(Data.Mapping))
+            return {};
+        return ProcessorType(Data.Mapping);
+    }
+
+    static bool IsIdentity(const ProcessorType::Mapping &mapping)
+    {
+        for (int c = 0; c < 4; ++c)
+            if (mapping[c] != static_cast<ProcessorType::Source>(c))
+                return false;
+        return true;
+    }
+
+    static ImageView Swizzle(Dx11DevType *dev, Dx11DevCtxType *devCtx, const ImageView &input,
+                             const ProcessorType::Mapping &mapping)
+    {
+        InitShader("ChannelSwizzleTool", g_ChannelSwizzle);
+
+        const auto resBuf =
+            D3D11::CreateTexture2dUavBuf(dev, input.Width, input.Height);
+        const auto resBufUav = D3D11::CreateTexture2dUav(dev, resBuf.Get());
+
+        ShaderData data{};
+        for (int c = 0; c < 4; ++c)
+            data.Sources[c] = static_cast<int32_t>(mapping[c]);
+        const auto dataBuf =
+            D3D11::CreateStructuredBuffer(dev, sizeof(ShaderData), 1, &data);
+        const auto dataSrv = D3D11::CreateBufferSRV(dev, dataBuf.Get());
+
+        ID3D11ShaderResourceView *srvs[] = {input.SRV.Get(), dataSrv.Get()};
+        ID3D11UnorderedAccessView *uavs[] = {resBufUav.Get()};
+
+        D3D11::RunComputeShader(devCtx, g_ChannelSwizzleShader, srvs, uavs,
+                                D3D11::GetThreadGroupNum(input.Width),
+                                D3D11::GetThreadGroupNum(input.Height), 1);
+
+        return ImageView(input, D3D11::CreateSrvFromTex(dev, resBuf.Get()));
+    }
+
+    [[nodiscard]] std::optional<ImageView>
+    GPU(Dx11DevType *dev, Dx11DevCtxType *devCtx, const ImageView &input)
+    {
+        if (IsIdentity(Data.Mapping))
+            return {};
+        return Swizzle(dev, devCtx, input, Data.Mapping);
+    }
+};
+
 struct NormalMapConvertorTool : ITool<NormalMapConvertorTool>
 {
     using ProcessorType = ImageTools::NormalMapConvert;
@@ -720,30 +725,26 @@ struct NormalMapConvertorTool : ITool<NormalMapConvertorTool>
                            0);
         if (ImGui::IsItemEdited())
             needUpdate = true;
-#if 0
-		ImGui::SameLine();
-		ImGui::RadioButton(U8 "DA##in", reinterpret_cast<int*>(&Data.InputType),
-			1);
-		if (ImGui::IsItemEdited())
-			needUpdate = true;
-#endif
+        ImGui::SameLine();
+        ImGui::RadioButton(U8 "DA##in", reinterpret_cast<int *>(&Data.InputType),
+                           1);
+        if (ImGui::IsItemEdited())
+            needUpdate = true;
 
         ImGui::Text("%s", Text::OutputFormat());
         ImGui::SameLine();
-#if 0
-		ImGui::RadioButton(U8 "RGB##out", reinterpret_cast<int*>(&Data.OutputType),
-			0);
-		if (ImGui::IsItemEdited())
-			needUpdate = true;
-		ImGui::SameLine();
-#endif
+        ImGui::RadioButton(U8 "RGB##out", reinterpret_cast<int *>(&Data.OutputType),
+                           0);
+        if (ImGui::IsItemEdited())
+            needUpdate = true;
+        ImGui::SameLine();
         ImGui::RadioButton(U8 "DA##out", reinterpret_cast<int *>(&Data.OutputType),
                            1);
         if (ImGui::IsItemEdited())
             needUpdate = true;
     }
 
-    [[nodiscard]] std::optional<ProcessorType> Processor() const
+    [[nodiscard]] std::optional<ProcessorType> Prepare() const
     {
         if (Data.InputType == Data.OutputType)
             return {};
@@ -755,29 +756,8 @@ struct NormalMapConvertorTool : ITool<NormalMapConvertorTool>
     {
         if (Data.InputType == Data.OutputType)
             return {};
-
-        InitShader("NormalMapConvertorTool", g_NormalMapConvertorRGB2DA);
-
-        const auto resBuf =
-            D3D11::CreateTexture2dUavBuf(dev, input.Width, input.Height);
-        const auto resBufUav = D3D11::CreateTexture2dUav(dev, resBuf.Get());
-
-        ID3D11ShaderResourceView *srvs[] = {input.SRV.Get()};
-        ID3D11UnorderedAccessView *uavs[] = {resBufUav.Get()};
-
-        if (Data.InputType == ProcessorType::Format::RGB &&
-            Data.OutputType == ProcessorType::Format::DA)
-        {
-            D3D11::RunComputeShader(devCtx, g_NormalMapConvertorRGB2DAShader, srvs,
-                                    uavs, D3D11::GetThreadGroupNum(input.Width),
-                                    D3D11::GetThreadGroupNum(input.Height), 1);
-        }
-        else
-        {
-            throw Ex(ToolException, "[DA->RGB] not impl");
-        }
-
-        return ImageView(input, D3D11::CreateSrvFromTex(dev, resBuf.Get()));
+        return ChannelSwizzleTool::Swizzle(dev, devCtx, input,
+                                           ProcessorType::MappingOf(Data.InputType, Data.OutputType));
     }
 };
 
@@ -785,18 +765,24 @@ struct ColorBalanceTool : ITool<ColorBalanceTool>
 {
     using ProcessorType = ImageTools::ColorBalance;
 
-    struct ToolData
+    struct Balance
     {
-        ProcessorType::Range Range = ProcessorType::Range::Midtones;
-
         float CyanRed = 0;
         float MagentaGreen = 0;
         float YellowBlue = 0;
 
+        NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(Balance, CyanRed, MagentaGreen, YellowBlue)
+    };
+
+    struct ToolData
+    {
+        // the range being edited, all three are applied
+        ProcessorType::Range Range = ProcessorType::Range::Midtones;
+        std::array<Balance, 3> Balances{};
+
         bool PreserveLuminosity = true;
 
-        NLOHMANN_DEFINE_TYPE_INTRUSIVE(ToolData, Range, CyanRed, MagentaGreen,
-                                       YellowBlue, PreserveLuminosity)
+        NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(ToolData, Range, Balances, PreserveLuminosity)
     } Data;
 
     [[nodiscard]] nlohmann::json SaveData() const
@@ -804,7 +790,15 @@ struct ColorBalanceTool : ITool<ColorBalanceTool>
         return nlohmann::json::object({{String_data, Data}});
     }
 
-    void LoadData(const nlohmann::json &obj) { obj[String_data].get_to(Data); }
+    void LoadData(const nlohmann::json &obj)
+    {
+        const auto &data = obj[String_data];
+        data.get_to(Data);
+
+        // older presets hold the adjustments of the selected range only
+        if (!data.contains("Balances"))
+            Data.Balances[static_cast<int>(Data.Range)] = data.get<Balance>();
+    }
 
     static const char *Name() { return Text::ColorBalance(); }
 
@@ -824,40 +818,42 @@ struct ColorBalanceTool : ITool<ColorBalanceTool>
             Text::Highlights(), reinterpret_cast<int *>(&Data.Range),
             static_cast<int>(decltype(Data.Range)::Highlights));
 
+        auto &balance = Data.Balances[static_cast<int>(Data.Range)];
+
         ImGui::Text("%s", Text::Cyan());
         ImGui::SameLine();
         needUpdate |=
-            ImGui::SliderFloat(Text::Red(), &Data.CyanRed, -100., 100., "%.1f");
+            ImGui::SliderFloat(Text::Red(), &balance.CyanRed, -100., 100., "%.1f");
         GUI::DoubleClickToEdit();
 
         ImGui::Text("%s", Text::Magenta());
         ImGui::SameLine();
-        needUpdate |= ImGui::SliderFloat(Text::Green(), &Data.MagentaGreen, -100.,
+        needUpdate |= ImGui::SliderFloat(Text::Green(), &balance.MagentaGreen, -100.,
                                          100., "%.1f");
         GUI::DoubleClickToEdit();
 
         ImGui::Text("%s", Text::Yellow());
         ImGui::SameLine();
         needUpdate |=
-            ImGui::SliderFloat(Text::Blue(), &Data.YellowBlue, -100., 100., "%.1f");
+            ImGui::SliderFloat(Text::Blue(), &balance.YellowBlue, -100., 100., "%.1f");
         GUI::DoubleClickToEdit();
 
         needUpdate |=
             ImGui::Checkbox(Text::PreserveLuminosity(), &Data.PreserveLuminosity);
     }
 
-    [[nodiscard]] std::optional<ProcessorType> Processor() const
+    [[nodiscard]] std::optional<ProcessorType> Prepare() const
     {
-        return ProcessorType(Data.Range, Data.CyanRed, Data.MagentaGreen,
-                             Data.YellowBlue, Data.PreserveLuminosity);
+        std::array<ProcessorType::Balance, 3> balances{};
+        for (size_t i = 0; i < balances.size(); ++i)
+            balances[i] = {Data.Balances[i].CyanRed, Data.Balances[i].MagentaGreen, Data.Balances[i].YellowBlue};
+        return ProcessorType(balances, Data.PreserveLuminosity);
     }
 
+    // float3 Shadows, Midtones, Highlights; int PreserveLuminosity
     struct ShaderData
     {
-        int Range = 0;
-        float CyanRed = 0;
-        float MagentaGreen = 0;
-        float YellowBlue = 0;
+        Balance Balances[3]{};
         int PreserveLuminosity = 0;
     };
 
@@ -872,10 +868,7 @@ struct ColorBalanceTool : ITool<ColorBalanceTool>
 
         ShaderData shaderData;
 
-        shaderData.Range = static_cast<int>(Data.Range);
-        shaderData.CyanRed = Data.CyanRed;
-        shaderData.MagentaGreen = Data.MagentaGreen;
-        shaderData.YellowBlue = Data.YellowBlue;
+        std::ranges::copy(Data.Balances, shaderData.Balances);
         shaderData.PreserveLuminosity = Data.PreserveLuminosity;
 
         const auto dataBuf =
@@ -930,7 +923,7 @@ struct HueSaturationTool : ITool<HueSaturationTool>
         GUI::DoubleClickToEdit();
     }
 
-    [[nodiscard]] std::optional<ProcessorType> Processor() const
+    [[nodiscard]] std::optional<ProcessorType> Prepare() const
     {
         return ProcessorType(Data.Hue, Data.Saturation, Data.Lightness);
     }
@@ -959,9 +952,206 @@ struct HueSaturationTool : ITool<HueSaturationTool>
     }
 };
 
+struct ResizeTool : ITool<ResizeTool>
+{
+    using ProcessorType = ImageTools::Resample;
+
+    struct ToolData
+    {
+        ProcessorType::Filter Filter = ProcessorType::Filter::Lanczos3;
+        bool ByScale = true;
+        float Scale = 1.f;
+        int Width = 0;
+        int Height = 0;
+
+        NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(ToolData, Filter, ByScale, Scale, Width, Height)
+    } Data;
+
+    struct ShaderData
+    {
+        int32_t Filter;
+        float Radius;
+        float InputWidth;
+        float InputHeight;
+        float OutputWidth;
+        float OutputHeight;
+    };
+
+    [[nodiscard]] nlohmann::json SaveData() const
+    {
+        return nlohmann::json::object({{String_data, Data}});
+    }
+
+    void LoadData(const nlohmann::json &obj) { obj[String_data].get_to(Data); }
+
+    static const char *Name() { return Text::Resize(); }
+
+    void UI(bool &needUpdate)
+    {
+        auto filter = static_cast<_Resample_Filter>(Data.Filter);
+        if (GUI::EnumCombo(U8 "filter", filter))
+        {
+            Data.Filter = static_cast<ProcessorType::Filter>(filter);
+            needUpdate = true;
+        }
+
+        needUpdate |= ImGui::Checkbox(U8 "by scale", &Data.ByScale);
+        if (Data.ByScale)
+        {
+            needUpdate |= ImGui::SliderFloat(U8 "scale", &Data.Scale, 0.01f, 8.f, "%.3f");
+            Data.Scale = std::max(Data.Scale, 0.001f);
+        }
+        else
+        {
+            // 0 follows the aspect ratio of the input
+            needUpdate |= ImGui::InputInt(U8 "width", &Data.Width);
+            needUpdate |= ImGui::InputInt(U8 "height", &Data.Height);
+            Data.Width = std::max(Data.Width, 0);
+            Data.Height = std::max(Data.Height, 0);
+        }
+    }
+
+    [[nodiscard]] bool IsIdentity() const
+    {
+        return Data.ByScale ? Data.Scale == 1.f : Data.Width == 0 && Data.Height == 0;
+    }
+
+    [[nodiscard]] ProcessorType Processor() const
+    {
+        if (Data.ByScale)
+            return ProcessorType(Data.Filter, static_cast<double>(Data.Scale));
+        return ProcessorType(Data.Filter, Data.Width, Data.Height);
+    }
+
+    [[nodiscard]] std::optional<ProcessorType> Prepare() const
+    {
+        if (IsIdentity())
+            return {};
+        return Processor();
+    }
+
+    static ImageView Run(Dx11DevType *dev, Dx11DevCtxType *devCtx, const ImageView &input,
+                         const ProcessorType::Filter filter, const int outW, const int outH)
+    {
+        InitShader("ResizeTool", g_Resample);
+
+        const ShaderData data{
+            static_cast<int32_t>(filter),
+            static_cast<float>(ProcessorType::RadiusOf(filter)),
+            static_cast<float>(input.Width),
+            static_cast<float>(input.Height),
+            static_cast<float>(outW),
+            static_cast<float>(outH)};
+
+        const auto resBuf = D3D11::CreateTexture2dUavBuf(dev, outW, outH);
+        const auto resBufUav = D3D11::CreateTexture2dUav(dev, resBuf.Get());
+
+        const auto dataBuf =
+            D3D11::CreateStructuredBuffer(dev, sizeof(ShaderData), 1, &data);
+        const auto dataSrv = D3D11::CreateBufferSRV(dev, dataBuf.Get());
+
+        ID3D11ShaderResourceView *srvs[] = {input.SRV.Get(), dataSrv.Get()};
+        ID3D11UnorderedAccessView *uavs[] = {resBufUav.Get()};
+
+        D3D11::RunComputeShader(devCtx, g_ResampleShader, srvs, uavs,
+                                D3D11::GetThreadGroupNum(outW),
+                                D3D11::GetThreadGroupNum(outH), 1);
+
+        return ImageView(D3D11::CreateSrvFromTex(dev, resBuf.Get()), outW, outH);
+    }
+
+    [[nodiscard]] std::optional<ImageView>
+    GPU(Dx11DevType *dev, Dx11DevCtxType *devCtx, const ImageView &input)
+    {
+        if (IsIdentity())
+            return {};
+
+        const auto size = Processor().OutputSizeOf({input.Width, input.Height});
+        return Run(dev, devCtx, input, Data.Filter, size.Width, size.Height);
+    }
+};
+
+struct MipmapTool : ITool<MipmapTool>
+{
+    using ProcessorType = ImageTools::MipChain;
+
+    struct ToolData
+    {
+        ProcessorType::Filter Filter = ProcessorType::Filter::Box;
+        // levels below the input, 0 for a full chain
+        int Levels = 0;
+
+        NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(ToolData, Filter, Levels)
+    } Data;
+
+    [[nodiscard]] nlohmann::json SaveData() const
+    {
+        return nlohmann::json::object({{String_data, Data}});
+    }
+
+    void LoadData(const nlohmann::json &obj) { obj[String_data].get_to(Data); }
+
+    static const char *Name() { return Text::Mipmap(); }
+
+    void UI(bool &needUpdate)
+    {
+        auto filter = static_cast<_Resample_Filter>(Data.Filter);
+        if (GUI::EnumCombo(U8 "filter", filter))
+        {
+            Data.Filter = static_cast<ProcessorType::Filter>(filter);
+            needUpdate = true;
+        }
+
+        needUpdate |= ImGui::SliderInt(U8 "levels", &Data.Levels, 0, 16);
+        Data.Levels = std::max(Data.Levels, 0);
+    }
+
+    [[nodiscard]] std::optional<ProcessorType> Prepare() const
+    {
+        return ProcessorType(Data.Filter, Data.Levels);
+    }
+
+    // same atlas as MipChain: the input on the left, the levels stacked on the right,
+    // each level resampled from the one above it
+    [[nodiscard]] std::optional<ImageView>
+    GPU(Dx11DevType *dev, Dx11DevCtxType *devCtx, const ImageView &input)
+    {
+        const auto sizes = ProcessorType::LevelSizes({input.Width, input.Height}, Data.Levels);
+        if (sizes.empty())
+            return {};
+
+        const auto outW = input.Width + sizes[0].Width;
+        const auto outH = input.Height;
+        const auto resBuf = D3D11::CreateTexture2dUavBuf(dev, outW, outH);
+        const auto resBufUav = D3D11::CreateTexture2dUav(dev, resBuf.Get());
+
+        constexpr float zero[4]{};
+        devCtx->ClearUnorderedAccessViewFloat(resBufUav.Get(), zero);
+
+        const auto copy = [&](const ImageView &view, const UINT x, const UINT y)
+        {
+            Microsoft::WRL::ComPtr<ID3D11Resource> src;
+            view.SRV->GetResource(src.GetAddressOf());
+            devCtx->CopySubresourceRegion(resBuf.Get(), 0, x, y, 0, src.Get(), 0, nullptr);
+        };
+
+        copy(input, 0, 0);
+        auto level = input;
+        UINT y = 0;
+        for (const auto &[w, h] : sizes)
+        {
+            level = ResizeTool::Run(dev, devCtx, level, Data.Filter, w, h);
+            copy(level, input.Width, y);
+            y += h;
+        }
+
+        return ImageView(D3D11::CreateSrvFromTex(dev, resBuf.Get()), outW, outH);
+    }
+};
+
 struct Waifu2xTool : ITool<Waifu2xTool>
 {
-    using ProcessorType = ToolCombine<Waifu2xNcnn, StbResize>;
+    using ProcessorType = ToolCombine<Waifu2xNcnn, ImageTools::Resample>;
 
     static constexpr std::array TileValues{-1, 64, 100, 128, 240,
                                            256, 384, 432, 480, 512};
@@ -975,6 +1165,15 @@ struct Waifu2xTool : ITool<Waifu2xTool>
         NLOHMANN_DEFINE_TYPE_INTRUSIVE(ToolData, Preview, Noise, TileSizeIdx)
     } Data;
 
+    PreparedCache<std::pair<int, int>, Waifu2xNcnn::Model> Network{};
+
+    [[nodiscard]] std::shared_ptr<Waifu2xNcnn::Model> LoadModel() const
+    {
+        const auto tile = TileValues[Data.TileSizeIdx];
+        return Network.Get({Data.Noise, tile}, [&]
+                           { return std::make_shared<Waifu2xNcnn::Model>(Data.Noise, tile); });
+    }
+
     [[nodiscard]] nlohmann::json SaveData() const
     {
         return nlohmann::json::object({{String_data, Data}});
@@ -1014,12 +1213,12 @@ struct Waifu2xTool : ITool<Waifu2xTool>
                                    DescStr.data(), static_cast<int>(DescStr.size()));
     }
 
-    [[nodiscard]] std::optional<ProcessorType> Processor() const
+    [[nodiscard]] std::optional<ProcessorType> Prepare() const
     {
         if (!Data.Preview && IsPreview)
-            return ProcessorType(StbResize(2));
+            return ProcessorType(ImageTools::Resample(ImageTools::Resample::Filter::Bicubic, 2.));
 
-        return ProcessorType(Waifu2xNcnn(Data.Noise, TileValues[Data.TileSizeIdx]));
+        return ProcessorType(Waifu2xNcnn(LoadModel()));
     }
 
     struct ShaderData
@@ -1062,15 +1261,16 @@ struct Waifu2xTool : ITool<Waifu2xTool>
             return ImageView(D3D11::CreateSrvFromTex(dev, resBuf.Get()), outW, outH);
         }
 
-        Waifu2xNcnn proc(Data.Noise, TileValues[Data.TileSizeIdx]);
-        proc.ImgRef(D3D11::CreateOutTexture(dev, devCtx, input));
+        Waifu2xNcnn proc(LoadModel());
+        const auto img = D3D11::CreateOutTexture(dev, devCtx, input);
+        proc.Bind(img);
         return D3D11::LoadTextureFromFile(dev, proc.GetOutputImage());
     }
 };
 
 struct RealsrTool : ITool<RealsrTool>
 {
-    using ProcessorType = ToolCombine<RealsrNcnn, StbResize>;
+    using ProcessorType = ToolCombine<RealsrNcnn, ImageTools::Resample>;
 
     struct ToolData
     {
@@ -1081,6 +1281,14 @@ struct RealsrTool : ITool<RealsrTool>
         NLOHMANN_DEFINE_TYPE_INTRUSIVE(ToolData, Preview, Model, UseTta)
     } Data;
 
+    PreparedCache<std::pair<RealsrNcnnModel, bool>, RealsrNcnn::Model> Network{};
+
+    [[nodiscard]] std::shared_ptr<RealsrNcnn::Model> LoadModel() const
+    {
+        return Network.Get({Data.Model, Data.UseTta}, [&]
+                           { return std::make_shared<RealsrNcnn::Model>(Data.Model, Data.UseTta); });
+    }
+
     [[nodiscard]] nlohmann::json SaveData() const
     {
         return nlohmann::json::object({{String_data, Data}});
@@ -1099,12 +1307,12 @@ struct RealsrTool : ITool<RealsrTool>
         needUpdate |= GUI::EnumCombo("Model", Data.Model);
     }
 
-    [[nodiscard]] std::optional<ProcessorType> Processor() const
+    [[nodiscard]] std::optional<ProcessorType> Prepare() const
     {
         if (!Data.Preview && IsPreview)
-            return ProcessorType(StbResize(4));
+            return ProcessorType(ImageTools::Resample(ImageTools::Resample::Filter::Bicubic, 4.));
 
-        return ProcessorType(RealsrNcnn(Data.Model, Data.UseTta));
+        return ProcessorType(RealsrNcnn(LoadModel()));
     }
 
     struct ShaderData
@@ -1147,8 +1355,9 @@ struct RealsrTool : ITool<RealsrTool>
             return ImageView(D3D11::CreateSrvFromTex(dev, resBuf.Get()), outW, outH);
         }
 
-        RealsrNcnn proc(Data.Model, Data.UseTta);
-        proc.ImgRef(D3D11::CreateOutTexture(dev, devCtx, input));
+        RealsrNcnn proc(LoadModel());
+        const auto img = D3D11::CreateOutTexture(dev, devCtx, input);
+        proc.Bind(img);
         return D3D11::LoadTextureFromFile(dev, proc.GetOutputImage());
     }
 };
@@ -1181,7 +1390,7 @@ struct CustomTool : ITool<CustomTool>
         ImGui::InputTextMultiline("HLSL", &Data.Shader.Buf);
     }
 
-    [[nodiscard]] std::optional<ProcessorType> Processor() const
+    [[nodiscard]] std::optional<ProcessorType> Prepare() const
     {
         return std::nullopt;
     }
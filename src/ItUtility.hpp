@@ -1,14 +1,24 @@
 #pragma once
 
 #include <array>
+#include <atomic>
+#include <bit>
+#include <condition_variable>
 #include <coroutine>
+#include <cstring>
+#include <deque>
 #include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <mutex>
+#include <optional>
 #include <queue>
 #include <random>
 #include <ranges>
 #include <span>
 #include <string>
+#include <thread>
+#include <unordered_set>
 #include <variant>
 
 #include <ShlObj.h>
@@ -31,7 +41,8 @@
 [[maybe_unused]] static constexpr uint32_t MaxPathLength8 = MaxPathLengthW * 3;
 
 MakeEnum(Processor, CPU, GPU);
-MakeEnum(ImageFormat, jpg, png, bmp, tga);
+MakeEnum(ImageFormat, jpg, png, bmp, tga, dds, qoi, pam, pfm);
+MakeEnum(BatchMode, Queue, Shard);
 
 template <class... T>
 struct Visitor : T...
@@ -595,25 +606,534 @@ inline std::string ToImString(const std::filesystem::path &str)
     return std::string(reinterpret_cast<const char *>(str.u8string().c_str()), s.length());
 }
 
-template <std::ranges::range R>
-static Generator<std::filesystem::path> GetFilesFromPaths(R &&paths)
+inline std::filesystem::path FromImString(const std::string_view str)
+{
+    return std::u8string_view(reinterpret_cast<const char8_t *>(str.data()), str.length());
+}
+
+class XXHash64
 {
-    for (const std::filesystem::path path : paths)
+    static constexpr uint64_t P1 = 11400714785074694791ULL;
+    static constexpr uint64_t P2 = 14029467366897019727ULL;
+    static constexpr uint64_t P3 = 1609587929392839161ULL;
+    static constexpr uint64_t P4 = 9650029242287828579ULL;
+    static constexpr uint64_t P5 = 2870177450012600261ULL;
+
+    std::array<uint64_t, 4> acc{};
+    std::array<uint8_t, 32> buf{};
+    size_t bufLen = 0;
+    uint64_t total = 0;
+    uint64_t seed = 0;
+
+    static uint64_t Read64(const uint8_t *p)
+    {
+        uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static uint32_t Read32(const uint8_t *p)
+    {
+        uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static uint64_t Round(uint64_t a, const uint64_t input)
     {
-        if (is_regular_file(path))
+        a += input * P2;
+        a = std::rotl(a, 31);
+        return a * P1;
+    }
+
+    static uint64_t Merge(uint64_t a, const uint64_t val)
+    {
+        a ^= Round(0, val);
+        return a * P1 + P4;
+    }
+
+    void Consume(const uint8_t *p)
+    {
+        for (size_t i = 0; i < 4; ++i)
+            acc[i] = Round(acc[i], Read64(p + i * 8));
+    }
+
+public:
+    explicit XXHash64(const uint64_t seed = 0) { Reset(seed); }
+
+    void Reset(const uint64_t s = 0)
+    {
+        seed = s;
+        acc = {seed + P1 + P2, seed + P2, seed, seed - P1};
+        bufLen = 0;
+        total = 0;
+    }
+
+    XXHash64 &Update(const std::span<const uint8_t> data)
+    {
+        const auto *p = data.data();
+        auto len = data.size();
+        total += len;
+
+        if (bufLen)
+        {
+            const auto n = std::min(len, buf.size() - bufLen);
+            std::copy_n(p, n, buf.data() + bufLen);
+            bufLen += n;
+            p += n;
+            len -= n;
+            if (bufLen < buf.size())
+                return *this;
+            Consume(buf.data());
+            bufLen = 0;
+        }
+
+        for (; len >= 32; p += 32, len -= 32)
+            Consume(p);
+
+        std::copy_n(p, len, buf.data());
+        bufLen = len;
+        return *this;
+    }
+
+    [[nodiscard]] uint64_t Digest() const
+    {
+        uint64_t h;
+        if (total >= 32)
+        {
+            h = std::rotl(acc[0], 1) + std::rotl(acc[1], 7) + std::rotl(acc[2], 12) + std::rotl(acc[3], 18);
+            for (const auto a : acc)
+                h = Merge(h, a);
+        }
+        else
         {
-            co_yield path;
+            h = seed + P5;
         }
-        else if (is_directory(path))
+        h += total;
+
+        const auto *p = buf.data();
+        auto len = bufLen;
+        for (; len >= 8; p += 8, len -= 8)
+            h = std::rotl(h ^ Round(0, Read64(p)), 27) * P1 + P4;
+        if (len >= 4)
         {
-            for (const auto &f : std::filesystem::directory_iterator(path))
+            h = std::rotl(h ^ (Read32(p) * P1), 23) * P2 + P3;
+            p += 4;
+            len -= 4;
+        }
+        for (; len > 0; ++p, --len)
+            h = std::rotl(h ^ (*p * P5), 11) * P1;
+
+        h ^= h >> 33;
+        h *= P2;
+        h ^= h >> 29;
+        h *= P3;
+        h ^= h >> 32;
+        return h;
+    }
+
+    static uint64_t Hash(const std::span<const uint8_t> data, const uint64_t seed = 0)
+    {
+        return XXHash64(seed).Update(data).Digest();
+    }
+
+    static uint64_t Hash(const std::string_view data, const uint64_t seed = 0)
+    {
+        return Hash({reinterpret_cast<const uint8_t *>(data.data()), data.size()}, seed);
+    }
+};
+
+inline std::vector<uint8_t> ReadFileBytes(const std::filesystem::path &file)
+{
+    std::ifstream fs(file, std::ios::in | std::ios::binary);
+    if (!fs)
+        throw Ex(ImgToolsException, "open file failed: {}", ToImString(file));
+
+    std::vector<uint8_t> data(std::filesystem::file_size(file));
+    fs.read(reinterpret_cast<char *>(data.data()), static_cast<std::streamsize>(data.size()));
+    if (static_cast<size_t>(fs.gcount()) != data.size())
+        throw Ex(ImgToolsException, "read file failed: {}", ToImString(file));
+    return data;
+}
+
+// Read only view of a whole file. The handle is opened for sequential scan and
+// the view is prefetched in large reads up front (the madvise(MADV_SEQUENTIAL |
+// MADV_WILLNEED) of Windows), so a decoder reads straight from the page cache
+// instead of through a stdio buffer.
+class MappedFile
+{
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+    const uint8_t *view = nullptr;
+    size_t size = 0;
+
+    void Close()
+    {
+        if (view)
+            UnmapViewOfFile(view);
+        if (mapping)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        view = nullptr;
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+    }
+
+public:
+    explicit MappedFile(const std::filesystem::path &path)
+    {
+        file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            throw Ex(WinApiException, "CreateFileW: {}: {}", ToImString(path), GetLastError());
+
+        LARGE_INTEGER len{};
+        if (!GetFileSizeEx(file, &len))
+        {
+            const auto err = GetLastError();
+            Close();
+            throw Ex(WinApiException, "GetFileSizeEx: {}: {}", ToImString(path), err);
+        }
+        size = static_cast<size_t>(len.QuadPart);
+        // an empty file can not be mapped
+        if (size == 0)
+            return;
+
+        mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping)
+            view = static_cast<const uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (!view)
+        {
+            const auto err = GetLastError();
+            Close();
+            throw Ex(WinApiException, "MapViewOfFile: {}: {}", ToImString(path), err);
+        }
+
+        WIN32_MEMORY_RANGE_ENTRY range{const_cast<uint8_t *>(view), size};
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile(MappedFile &&) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile &operator=(MappedFile &&) = delete;
+
+    ~MappedFile() { Close(); }
+
+    [[nodiscard]] const uint8_t *Data() const { return view; }
+    [[nodiscard]] size_t Size() const { return size; }
+    [[nodiscard]] std::span<const uint8_t> Bytes() const { return {view, size}; }
+};
+
+// Decodes an image from a mapping of the file at about maxSide, see ImageFile::Preview.
+inline Image::ImageFile LoadImagePreview(const std::filesystem::path &file, const int maxSide)
+{
+    const MappedFile mapped(file);
+    return Image::ImageFile::Preview(mapped.Data(), mapped.Size(), maxSide);
+}
+
+// Warms the page cache for files that are about to be read: a background
+// thread maps each hinted file and faults it in, so its I/O overlaps the work
+// on the current one. Hints are best effort, only the latest few are kept and
+// failures are ignored.
+class ReadAhead
+{
+    static constexpr size_t Depth = 2;
+
+    std::mutex mtx{};
+    std::condition_variable_any cv{};
+    std::deque<std::filesystem::path> queue{};
+    std::jthread thread{};
+
+    void Loop(const std::stop_token &tk)
+    {
+        while (true)
+        {
+            std::filesystem::path path{};
+            {
+                std::unique_lock lock(mtx);
+                if (!cv.wait(lock, tk, [&]
+                             { return !queue.empty(); }))
+                    return;
+                path = std::move(queue.front());
+                queue.pop_front();
+            }
+
+            try
+            {
+                const MappedFile mapped(path);
+                uint8_t sum = 0;
+                for (size_t i = 0; i < mapped.Size() && !tk.stop_requested(); i += 4096)
+                    sum ^= mapped.Data()[i];
+                [[maybe_unused]] volatile const auto touched = sum;
+            }
+            catch (...)
             {
-                if (f.is_regular_file())
-                    co_yield f.path();
             }
         }
     }
 
+public:
+    ReadAhead() : thread([this](const std::stop_token &tk)
+                         { Loop(tk); }) {}
+
+    ReadAhead(const ReadAhead &) = delete;
+    ReadAhead(ReadAhead &&) = delete;
+    ReadAhead &operator=(const ReadAhead &) = delete;
+    ReadAhead &operator=(ReadAhead &&) = delete;
+
+    void Hint(const std::filesystem::path &path)
+    {
+        {
+            std::lock_guard lock(mtx);
+            queue.push_back(path);
+            while (queue.size() > Depth)
+                queue.pop_front();
+        }
+        cv.notify_one();
+    }
+};
+
+inline bool IsImage(const std::filesystem::path &file)
+{
+    static std::unordered_set<std::string> extensions{
+        ".jpg", ".jpeg", ".jpe", ".png", ".tga", ".bmp",
+        ".psd", ".gif", ".hdr", ".pic", ".ppm", ".pgm",
+        ".qoi", ".pam", ".pfm"};
+    return extensions.contains(String::ToLower(file.extension().u8string()));
+}
+
+inline bool IsImageMagic(const std::filesystem::path &file)
+{
+    std::array<uint8_t, 12> head{};
+    std::ifstream fs(file, std::ios::in | std::ios::binary);
+    if (!fs)
+        return false;
+    fs.read(reinterpret_cast<char *>(head.data()), head.size());
+    const auto len = static_cast<size_t>(fs.gcount());
+
+    const auto match = [&](const std::initializer_list<uint8_t> sig)
+    {
+        return len >= sig.size() && std::equal(sig.begin(), sig.end(), head.begin());
+    };
+
+    // tga has no signature, trust the extension
+    static std::unordered_set<std::string> noMagic{".tga"};
+    if (noMagic.contains(String::ToLower(file.extension().u8string())))
+        return true;
+
+    return match({0xFF, 0xD8, 0xFF}) ||                               // jpg
+           match({0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'}) ||    // png
+           match({'B', 'M'}) ||                                       // bmp
+           match({'G', 'I', 'F', '8'}) ||                             // gif
+           match({'8', 'B', 'P', 'S'}) ||                             // psd
+           match({'#', '?', 'R'}) ||                                  // hdr
+           match({0x53, 0x80, 0xF6, 0x34}) ||                         // pic
+           match({'P', '5'}) || match({'P', '6'}) ||                  // pgm, ppm
+           match({'q', 'o', 'i', 'f'}) ||                             // qoi
+           match({'P', '7'}) ||                                       // pam
+           match({'P', 'F'}) || match({'P', 'f'});                    // pfm
+}
+
+// Walks directories on a small pool of threads and hands files out as soon as
+// they are found, so the consumer can start working before the walk is done.
+// Entry types come from the directory listing itself (FindNextFile / d_type),
+// no per-file stat is issued.
+class FileScanner
+{
+public:
+    struct Entry
+    {
+        std::filesystem::path Root;
+        std::filesystem::path Path;
+    };
+
+    struct Options
+    {
+        bool Recursive = true;
+        bool CheckMagic = false;
+        uint32_t Threads = 0;
+        size_t Batch = 256;
+    };
+
+private:
+    Options opt{};
+
+    std::mutex mtx{};
+    std::condition_variable dirCv{};
+    std::condition_variable fileCv{};
+    std::deque<Entry> dirs{};
+    std::deque<Entry> files{};
+    size_t busy = 0;
+    std::atomic_bool stopped = false;
+    bool finished = false;
+    std::atomic_uint64_t found = 0;
+
+    std::vector<std::jthread> workers{};
+
+    [[nodiscard]] bool Accept(const std::filesystem::path &file) const
+    {
+        if (!IsImage(file))
+            return false;
+        return !opt.CheckMagic || IsImageMagic(file);
+    }
+
+    void Push(std::vector<Entry> &subDirs, std::vector<Entry> &subFiles)
+    {
+        if (subDirs.empty() && subFiles.empty())
+            return;
+
+        {
+            std::lock_guard lock(mtx);
+            std::ranges::move(subDirs, std::back_inserter(dirs));
+            std::ranges::move(subFiles, std::back_inserter(files));
+        }
+        found += subFiles.size();
+        if (!subDirs.empty())
+            dirCv.notify_all();
+        if (!subFiles.empty())
+            fileCv.notify_all();
+        subDirs.clear();
+        subFiles.clear();
+    }
+
+    void Walk(const Entry &dir)
+    {
+        std::vector<Entry> subDirs{};
+        std::vector<Entry> subFiles{};
+
+        std::error_code ec;
+        for (std::filesystem::directory_iterator it(dir.Path, std::filesystem::directory_options::skip_permission_denied, ec), end;
+             !ec && it != end; it.increment(ec))
+        {
+            if (stopped)
+                return;
+
+            const auto &entry = *it;
+            std::error_code tec;
+            if (entry.is_directory(tec))
+            {
+                if (opt.Recursive && !entry.is_symlink(tec))
+                    subDirs.push_back({dir.Root, entry.path()});
+            }
+            else if (entry.is_regular_file(tec) && Accept(entry.path()))
+            {
+                subFiles.push_back({dir.Root, entry.path()});
+            }
+
+            if (subDirs.size() + subFiles.size() >= opt.Batch)
+                Push(subDirs, subFiles);
+        }
+
+        Push(subDirs, subFiles);
+    }
+
+    void Worker()
+    {
+        while (true)
+        {
+            Entry dir;
+            {
+                std::unique_lock lock(mtx);
+                dirCv.wait(lock, [&]
+                           { return stopped || !dirs.empty() || busy == 0; });
+                if (stopped || dirs.empty())
+                {
+                    finished = true;
+                    dirCv.notify_all();
+                    fileCv.notify_all();
+                    return;
+                }
+                dir = std::move(dirs.front());
+                dirs.pop_front();
+                ++busy;
+            }
+
+            Walk(dir);
+
+            {
+                std::lock_guard lock(mtx);
+                --busy;
+            }
+            dirCv.notify_all();
+        }
+    }
+
+public:
+    explicit FileScanner(const std::vector<std::filesystem::path> &paths) : FileScanner(paths, Options{}) {}
+
+    FileScanner(const std::vector<std::filesystem::path> &paths, const Options &options) : opt(options)
+    {
+        for (const auto &path : paths)
+        {
+            std::error_code ec;
+            const auto st = status(path, ec);
+            if (is_regular_file(st))
+            {
+                files.push_back({path.parent_path(), path});
+                ++found;
+            }
+            else if (is_directory(st))
+            {
+                dirs.push_back({path, path});
+            }
+        }
+
+        const auto threads = opt.Threads ? opt.Threads : std::clamp(std::thread::hardware_concurrency(), 2u, 8u);
+        for (uint32_t i = 0; i < threads; ++i)
+            workers.emplace_back([this]
+                                 { Worker(); });
+    }
+
+    FileScanner(const FileScanner &) = delete;
+    FileScanner(FileScanner &&) = delete;
+    FileScanner &operator=(const FileScanner &) = delete;
+    FileScanner &operator=(FileScanner &&) = delete;
+
+    ~FileScanner()
+    {
+        Stop();
+    }
+
+    void Stop()
+    {
+        {
+            std::lock_guard lock(mtx);
+            stopped = true;
+        }
+        dirCv.notify_all();
+        fileCv.notify_all();
+    }
+
+    // blocks until a file is available, returns nullopt once the walk is done and drained
+    std::optional<Entry> Next()
+    {
+        std::unique_lock lock(mtx);
+        fileCv.wait(lock, [&]
+                    { return stopped || finished || !files.empty(); });
+        if (stopped || files.empty())
+            return std::nullopt;
+
+        auto entry = std::move(files.front());
+        files.pop_front();
+        return entry;
+    }
+
+    [[nodiscard]] uint64_t Found() const { return found; }
+};
+
+template <std::ranges::range R>
+static Generator<std::filesystem::path> GetFilesFromPaths(R &&paths, const bool recursive = false)
+{
+    FileScanner scanner(std::vector<std::filesystem::path>(std::ranges::begin(paths), std::ranges::end(paths)),
+                        {.Recursive = recursive});
+
+    while (auto entry = scanner.Next())
+    {
+        co_yield std::move(entry->Path);
+    }
+
     co_return;
 }
 
@@ -0,0 +1,345 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ItException.hpp"
+#include "ItLog.hpp"
+#include "ItUtility.hpp"
+
+// Watches directory trees with ReadDirectoryChangesW and yields image files
+// once they are finished: no change notification for the quiet period and
+// the file can be opened without sharing, i.e. the writer has closed it.
+// Files wait in the pending set while the ready queue is full, so a burst
+// never blocks the notification loop and each file is queued once.
+// All directories complete on one I/O completion port, so the number of
+// roots is not bound by MAXIMUM_WAIT_OBJECTS.
+class FolderWatcher
+{
+public:
+    using Entry = FileScanner::Entry;
+
+    struct Options
+    {
+        bool Recursive = true;
+        std::chrono::milliseconds Quiet{1000};
+        size_t Capacity = 256;
+        // rejects files that should not be picked up, e.g. outputs written into a watched tree
+        std::function<bool(const std::filesystem::path &)> Accept{};
+    };
+
+private:
+    struct Dir
+    {
+        std::filesystem::path Root{};
+        HANDLE Handle = INVALID_HANDLE_VALUE;
+        OVERLAPPED Overlapped{};
+        std::vector<DWORD> Buffer = std::vector<DWORD>(16 * 1024);
+        // a read is pending into Buffer, it must finish before Buffer is freed
+        bool Armed = false;
+        // failed reads in a row, see MaxFailures
+        int Failures = 0;
+    };
+
+    struct PendingFile
+    {
+        std::filesystem::path Root{};
+        std::chrono::steady_clock::time_point Last{};
+    };
+
+    // completion key that tells the loop to quit, directories use their index
+    static constexpr ULONG_PTR StopKey = ~ULONG_PTR{0};
+    // a directory whose reads keep failing, e.g. it was removed, is dropped
+    static constexpr int MaxFailures = 3;
+
+    Options opt{};
+    std::vector<Dir> dirs{};
+    HANDLE port = nullptr;
+
+    std::mutex mtx{};
+    std::condition_variable_any cv{};
+    std::map<std::filesystem::path, PendingFile> pending{};
+    std::deque<Entry> ready{};
+    // set when the loop died, Next reports it instead of waiting forever
+    std::optional<std::string> error{};
+
+    std::jthread thread{};
+
+    void Arm(Dir &dir) const
+    {
+        constexpr DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME |
+                                 FILE_NOTIFY_CHANGE_LAST_WRITE |
+                                 FILE_NOTIFY_CHANGE_SIZE;
+        if (!ReadDirectoryChangesW(dir.Handle, dir.Buffer.data(),
+                                   static_cast<DWORD>(dir.Buffer.size() * sizeof(DWORD)),
+                                   opt.Recursive, filter, nullptr, &dir.Overlapped, nullptr))
+            throw Ex(WinApiException, "ReadDirectoryChangesW: {}: {}", ToImString(dir.Root), GetLastError());
+        dir.Armed = true;
+    }
+
+    // Cancels the pending read and waits for it, so the kernel no longer
+    // writes into the buffer, then closes the directory.
+    static void Close(Dir &dir)
+    {
+        if (dir.Handle == INVALID_HANDLE_VALUE)
+            return;
+        if (dir.Armed)
+        {
+            CancelIoEx(dir.Handle, &dir.Overlapped);
+            DWORD bytes = 0;
+            GetOverlappedResult(dir.Handle, &dir.Overlapped, &bytes, TRUE);
+            dir.Armed = false;
+        }
+        CloseHandle(dir.Handle);
+        dir.Handle = INVALID_HANDLE_VALUE;
+    }
+
+    void CloseAll()
+    {
+        for (auto &dir : dirs)
+            Close(dir);
+        if (port)
+            CloseHandle(port);
+        port = nullptr;
+    }
+
+    void Touch(const std::filesystem::path &root, const std::filesystem::path &file)
+    {
+        if (!IsImage(file) || (opt.Accept && !opt.Accept(file)))
+            return;
+        std::lock_guard lock(mtx);
+        pending.insert_or_assign(file, PendingFile{root, std::chrono::steady_clock::now()});
+    }
+
+    void Drain(Dir &dir, const DWORD bytes)
+    {
+        if (bytes == 0)
+        {
+            // buffer overflowed, changes were dropped: look at everything again
+            LogWarn("[Watch] change buffer overflow: {}", dir.Root);
+            for (FileScanner scanner({dir.Root}, {.Recursive = opt.Recursive}); const auto file = scanner.Next();)
+                Touch(dir.Root, file->Path);
+        }
+        else
+        {
+            auto ptr = reinterpret_cast<const uint8_t *>(dir.Buffer.data());
+            while (true)
+            {
+                const auto info = reinterpret_cast<const FILE_NOTIFY_INFORMATION *>(ptr);
+                if (info->Action == FILE_ACTION_ADDED ||
+                    info->Action == FILE_ACTION_MODIFIED ||
+                    info->Action == FILE_ACTION_RENAMED_NEW_NAME)
+                {
+                    const std::wstring_view name(info->FileName, info->FileNameLength / sizeof(wchar_t));
+                    Touch(dir.Root, dir.Root / name);
+                }
+                if (info->NextEntryOffset == 0)
+                    break;
+                ptr += info->NextEntryOffset;
+            }
+        }
+
+        Arm(dir);
+    }
+
+    static bool IsFinished(const std::filesystem::path &file)
+    {
+        const auto handle = CreateFileW(file.c_str(), GENERIC_READ, 0, nullptr,
+                                        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (handle == INVALID_HANDLE_VALUE)
+            return false;
+        CloseHandle(handle);
+        return true;
+    }
+
+    void Settle()
+    {
+        const auto now = std::chrono::steady_clock::now();
+        bool notify = false;
+
+        std::lock_guard lock(mtx);
+        for (auto it = pending.begin(); it != pending.end() && ready.size() < opt.Capacity;)
+        {
+            auto &[file, item] = *it;
+            if (now - item.Last < opt.Quiet)
+            {
+                ++it;
+                continue;
+            }
+
+            std::error_code ec;
+            if (!is_regular_file(file, ec))
+            {
+                it = pending.erase(it);
+                continue;
+            }
+            if (!IsFinished(file))
+            {
+                item.Last = now;
+                ++it;
+                continue;
+            }
+
+            ready.push_back({item.Root, file});
+            it = pending.erase(it);
+            notify = true;
+        }
+
+        if (notify)
+            cv.notify_all();
+    }
+
+    // Re-arms a directory after a failed read, backing off a little longer each
+    // time, and stops watching it once MaxFailures reads failed in a row.
+    void Fail(Dir &dir, const DWORD err)
+    {
+        LogErr("[Watch] ReadDirectoryChangesW: {}: {}", dir.Root, err);
+        if (++dir.Failures >= MaxFailures)
+        {
+            LogErr("[Watch] stop watching {} after {} failed reads", dir.Root, dir.Failures);
+            Close(dir);
+            return;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100) * dir.Failures);
+        try
+        {
+            Arm(dir);
+        }
+        catch (const std::exception &ex)
+        {
+            LogErr("[Watch] stop watching {}: {}", dir.Root, LogMsg::LogException(ex));
+            Close(dir);
+        }
+    }
+
+    void Loop()
+    {
+        const auto tick = static_cast<DWORD>(std::clamp<int64_t>(opt.Quiet.count() / 4, 10, 250));
+        while (true)
+        {
+            DWORD bytes = 0;
+            ULONG_PTR key = 0;
+            OVERLAPPED *overlapped = nullptr;
+            const auto ok = GetQueuedCompletionStatus(port, &bytes, &key, &overlapped, tick);
+            const auto err = ok ? ERROR_SUCCESS : GetLastError();
+
+            if (!overlapped && err != ERROR_SUCCESS && err != WAIT_TIMEOUT)
+            {
+                // the port itself failed, nothing will be reported from here on
+                std::lock_guard lock(mtx);
+                error = std::format("GetQueuedCompletionStatus: {}", err);
+                cv.notify_all();
+                return;
+            }
+            if (key == StopKey)
+                break;
+
+            try
+            {
+                if (overlapped)
+                {
+                    auto &dir = dirs[key];
+                    dir.Armed = false;
+                    if (err == ERROR_SUCCESS || err == ERROR_NOTIFY_ENUM_DIR)
+                    {
+                        dir.Failures = 0;
+                        Drain(dir, err == ERROR_SUCCESS ? bytes : 0);
+                    }
+                    else
+                        Fail(dir, err);
+                }
+                Settle();
+            }
+            catch (const std::exception &ex)
+            {
+                LogErr("[Watch] {}", LogMsg::LogException(ex));
+            }
+        }
+    }
+
+public:
+    FolderWatcher(const std::vector<std::filesystem::path> &roots, const Options &opt) : opt(opt)
+    {
+        port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+        if (!port)
+            throw Ex(WinApiException, "CreateIoCompletionPort: {}", GetLastError());
+
+        // the destructor does not run for a throwing constructor, the reads
+        // already armed would otherwise land in freed buffers
+        try
+        {
+            dirs.resize(roots.size());
+            for (size_t i = 0; i < roots.size(); ++i)
+            {
+                auto &dir = dirs[i];
+                dir.Root = roots[i];
+                dir.Handle = CreateFileW(dir.Root.c_str(), FILE_LIST_DIRECTORY,
+                                         FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                                         OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+                if (dir.Handle == INVALID_HANDLE_VALUE)
+                    throw Ex(WinApiException, "CreateFileW: {}: {}", ToImString(dir.Root), GetLastError());
+                if (!CreateIoCompletionPort(dir.Handle, port, i, 0))
+                    throw Ex(WinApiException, "CreateIoCompletionPort: {}: {}", ToImString(dir.Root), GetLastError());
+                Arm(dir);
+            }
+        }
+        catch (...)
+        {
+            CloseAll();
+            throw;
+        }
+
+        thread = std::jthread([this]
+                              { Loop(); });
+    }
+
+    FolderWatcher(const FolderWatcher &) = delete;
+    FolderWatcher(FolderWatcher &&) = delete;
+    FolderWatcher &operator=(const FolderWatcher &) = delete;
+    FolderWatcher &operator=(FolderWatcher &&) = delete;
+
+    ~FolderWatcher()
+    {
+        if (port)
+            PostQueuedCompletionStatus(port, 0, StopKey, nullptr);
+        if (thread.joinable())
+            thread.join();
+
+        CloseAll();
+    }
+
+    // Blocks until a finished file is available; nullopt once stop is requested.
+    // Throws once the watch loop has failed and every ready file was taken.
+    std::optional<Entry> Next(const std::stop_token &tk)
+    {
+        std::unique_lock lock(mtx);
+        if (!cv.wait(lock, tk, [&]
+                     { return !ready.empty() || error; }))
+            return std::nullopt;
+        if (ready.empty())
+            throw Ex(WinApiException, "{}", *error);
+
+        auto entry = std::move(ready.front());
+        ready.pop_front();
+        return entry;
+    }
+
+    [[nodiscard]] size_t Pending()
+    {
+        std::lock_guard lock(mtx);
+        return pending.size() + ready.size();
+    }
+};
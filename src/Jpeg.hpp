@@ -0,0 +1,966 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <execution>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <numbers>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+#include "Simd.hpp"
+
+// Baseline JPEG writer. The image is cut into slices of whole MCU rows that are
+// encoded in parallel, each starting with fresh DC predictors, and joined with
+// restart markers. Tables are the Annex K ones, quantizers scaled the IJG way.
+// Also a reduced size decoder for sequential files, for previews.
+namespace Jpeg
+{
+    class Exception : public std::runtime_error
+    {
+        using std::runtime_error::runtime_error;
+    };
+
+#define __Jpeg_Ex__(fmt, ...) Exception(                             \
+    std::format("[{}:{}] [{}] [{}] {}",                              \
+                std::filesystem::path(__FILE__).filename().string(), \
+                __LINE__,                                            \
+                __FUNCTION__,                                        \
+                "Jpeg::Exception",                                   \
+                std::format(fmt, __VA_ARGS__)))
+
+    // chroma resolution: full, half horizontally, half both ways
+    enum class Subsampling
+    {
+        Yuv444,
+        Yuv422,
+        Yuv420
+    };
+
+    struct Options
+    {
+        // 1 ~ 100
+        int Quality = 90;
+        Jpeg::Subsampling Subsampling = Jpeg::Subsampling::Yuv420;
+    };
+
+    // MCU rows per restart slice
+    static constexpr int SliceRows = 16;
+
+    namespace __Detail
+    {
+        // natural index of each zigzag position
+        constexpr uint8_t ZigZag[64]{
+            0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+            12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+            35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+            58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+
+        constexpr uint8_t LumaQuant[64]{
+            16, 11, 10, 16, 24, 40, 51, 61, 12, 12, 14, 19, 26, 58, 60, 55,
+            14, 13, 16, 24, 40, 57, 69, 56, 14, 17, 22, 29, 51, 87, 80, 62,
+            18, 22, 37, 56, 68, 109, 103, 77, 24, 35, 55, 64, 81, 104, 113, 92,
+            49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99};
+
+        constexpr uint8_t ChromaQuant[64]{
+            17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99,
+            24, 26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99,
+            99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+            99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99};
+
+        constexpr uint8_t DcLumaBits[16]{0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+        constexpr uint8_t DcChromaBits[16]{0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0};
+        constexpr uint8_t DcValues[12]{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+
+        constexpr uint8_t AcLumaBits[16]{0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d};
+        constexpr uint8_t AcLumaValues[162]{
+            0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+            0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+            0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+            0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+            0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+            0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+            0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+            0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+            0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+            0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+            0xf9, 0xfa};
+
+        constexpr uint8_t AcChromaBits[16]{0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77};
+        constexpr uint8_t AcChromaValues[162]{
+            0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+            0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+            0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+            0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+            0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+            0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+            0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+            0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+            0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+            0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+            0xf9, 0xfa};
+
+        struct HuffmanTable
+        {
+            uint16_t Code[256]{};
+            uint8_t Length[256]{};
+
+            HuffmanTable(const uint8_t (&bits)[16], const uint8_t *values)
+            {
+                uint16_t code = 0;
+                for (int len = 1, k = 0; len <= 16; ++len, code <<= 1)
+                    for (int i = 0; i < bits[len - 1]; ++i, ++k, ++code)
+                    {
+                        Code[values[k]] = code;
+                        Length[values[k]] = static_cast<uint8_t>(len);
+                    }
+            }
+        };
+
+        inline const HuffmanTable &DcLuma()
+        {
+            static const HuffmanTable t(DcLumaBits, DcValues);
+            return t;
+        }
+
+        inline const HuffmanTable &DcChroma()
+        {
+            static const HuffmanTable t(DcChromaBits, DcValues);
+            return t;
+        }
+
+        inline const HuffmanTable &AcLuma()
+        {
+            static const HuffmanTable t(AcLumaBits, AcLumaValues);
+            return t;
+        }
+
+        inline const HuffmanTable &AcChroma()
+        {
+            static const HuffmanTable t(AcChromaBits, AcChromaValues);
+            return t;
+        }
+
+        inline std::array<uint8_t, 64> ScaleQuant(const uint8_t (&base)[64], int quality)
+        {
+            quality = std::clamp(quality, 1, 100);
+            const auto scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+            std::array<uint8_t, 64> q{};
+            for (int i = 0; i < 64; ++i)
+                q[i] = static_cast<uint8_t>(std::clamp((base[i] * scale + 50) / 100, 1, 255));
+            return q;
+        }
+
+        // entropy coded bytes with 0xff stuffing
+        class BitWriter
+        {
+            uint64_t acc = 0;
+            int bits = 0;
+
+        public:
+            std::vector<uint8_t> Bytes{};
+
+            // bytes leave the accumulator 4 at a time, len <= 16 keeps it under 48 bits
+            void Put(const uint32_t code, const int len)
+            {
+                acc = acc << len | (code & ((1u << len) - 1));
+                bits += len;
+                if (bits < 32)
+                    return;
+                bits -= 32;
+                const auto word = static_cast<uint32_t>(acc >> bits);
+                const uint8_t bytes[4]{static_cast<uint8_t>(word >> 24), static_cast<uint8_t>(word >> 16),
+                                       static_cast<uint8_t>(word >> 8), static_cast<uint8_t>(word)};
+                // any 0xff byte in the word
+                if ((((word & 0x7f7f7f7f) + 0x01010101) & word & 0x80808080) == 0)
+                    Bytes.insert(Bytes.end(), bytes, bytes + 4);
+                else
+                    for (const auto byte : bytes)
+                    {
+                        Bytes.push_back(byte);
+                        if (byte == 0xff)
+                            Bytes.push_back(0);
+                    }
+            }
+
+            // pad with ones to a byte boundary, as before a restart marker or EOI
+            void Flush()
+            {
+                if (const auto pad = (8 - bits % 8) % 8)
+                    Put(0x7f, pad);
+                for (; bits > 0; bits -= 8)
+                {
+                    const auto byte = static_cast<uint8_t>(acc >> (bits - 8));
+                    Bytes.push_back(byte);
+                    if (byte == 0xff)
+                        Bytes.push_back(0);
+                }
+            }
+        };
+
+        // magnitude category of a coefficient
+        inline int BitLength(const int v)
+        {
+            return static_cast<int>(std::bit_width(static_cast<unsigned>(std::abs(v))));
+        }
+
+        inline void EncodeBlock(BitWriter &bw, const int16_t *coef, int &dcPred,
+                                const HuffmanTable &dc, const HuffmanTable &ac)
+        {
+            const auto diff = coef[0] - dcPred;
+            dcPred = coef[0];
+            const auto dcLen = BitLength(diff);
+            bw.Put(dc.Code[dcLen], dc.Length[dcLen]);
+            if (dcLen)
+                bw.Put(static_cast<uint32_t>(diff < 0 ? diff - 1 : diff), dcLen);
+
+            int run = 0;
+            for (int k = 1; k < 64; ++k)
+            {
+                const int v = coef[ZigZag[k]];
+                if (v == 0)
+                {
+                    ++run;
+                    continue;
+                }
+                for (; run >= 16; run -= 16)
+                    bw.Put(ac.Code[0xf0], ac.Length[0xf0]);
+                const auto len = BitLength(v);
+                const auto sym = run << 4 | len;
+                bw.Put(ac.Code[sym], ac.Length[sym]);
+                bw.Put(static_cast<uint32_t>(v < 0 ? v - 1 : v), len);
+                run = 0;
+            }
+            if (run)
+                bw.Put(ac.Code[0], ac.Length[0]);
+        }
+
+        struct Encoder
+        {
+            const uint8_t *Rgba;
+            int Width;
+            int Height;
+            int Hs; // luma blocks per MCU horizontally
+            int Vs; // and vertically
+            std::array<float, 64> LumaScale{};
+            std::array<float, 64> ChromaScale{};
+
+            // MCU at (mx, my): Y, Cb, Cr of its 8 Hs x 8 Vs pixels, level shifted,
+            // edge pixels repeated
+            void EncodeMcu(BitWriter &bw, const int mx, const int my, int (&pred)[3]) const
+            {
+                alignas(32) float y[16 * 16], cb[16 * 16], cr[16 * 16];
+                const auto w = 8 * Hs, h = 8 * Vs;
+                const auto x0 = mx * w;
+                const auto inside = x0 + w <= Width;
+                alignas(16) uint8_t edge[16 * 4];
+                for (int j = 0; j < h; ++j)
+                {
+                    const auto sy = std::min(my * h + j, Height - 1);
+                    const auto row = Rgba + static_cast<size_t>(sy) * Width * 4;
+                    auto src = row + static_cast<size_t>(x0) * 4;
+                    if (!inside)
+                    {
+                        for (int i = 0; i < w; ++i)
+                            std::copy_n(row + std::min(x0 + i, Width - 1) * 4, 4, edge + i * 4);
+                        src = edge;
+                    }
+                    Simd::RgbaToYCbCr(src, w, y + j * w, cb + j * w, cr + j * w);
+                }
+
+                alignas(32) float block[64];
+                alignas(32) int16_t coef[64];
+                for (int by = 0; by < Vs; ++by)
+                    for (int bx = 0; bx < Hs; ++bx)
+                    {
+                        for (int j = 0; j < 8; ++j)
+                            std::copy_n(y + (by * 8 + j) * w + bx * 8, 8, block + j * 8);
+                        Simd::ForwardDctQuantize(block, LumaScale.data(), coef);
+                        EncodeBlock(bw, coef, pred[0], DcLuma(), AcLuma());
+                    }
+
+                // chroma is the box average of Hs x Vs pixels
+                const auto norm = 1.f / static_cast<float>(Hs * Vs);
+                for (int c = 0; c < 2; ++c)
+                {
+                    const auto plane = c == 0 ? cb : cr;
+                    for (int j = 0; j < 8; ++j)
+                        for (int i = 0; i < 8; ++i)
+                        {
+                            float sum = 0;
+                            for (int dy = 0; dy < Vs; ++dy)
+                                for (int dx = 0; dx < Hs; ++dx)
+                                    sum += plane[(j * Vs + dy) * w + i * Hs + dx];
+                            block[j * 8 + i] = sum * norm;
+                        }
+                    Simd::ForwardDctQuantize(block, ChromaScale.data(), coef);
+                    EncodeBlock(bw, coef, pred[1 + c], DcChroma(), AcChroma());
+                }
+            }
+        };
+
+        inline void PutMarker(std::vector<uint8_t> &out, const uint8_t marker, const std::initializer_list<uint8_t> payload)
+        {
+            const auto len = payload.size() + 2;
+            out.insert(out.end(), {0xff, marker, static_cast<uint8_t>(len >> 8), static_cast<uint8_t>(len)});
+            out.insert(out.end(), payload);
+        }
+
+        inline void PutHuffman(std::vector<uint8_t> &out, const uint8_t tableClassId,
+                               const uint8_t (&bits)[16], const uint8_t *values)
+        {
+            const auto count = std::accumulate(std::begin(bits), std::end(bits), 0);
+            const auto len = 2 + 1 + 16 + count;
+            out.insert(out.end(), {0xff, 0xc4, static_cast<uint8_t>(len >> 8), static_cast<uint8_t>(len), tableClassId});
+            out.insert(out.end(), std::begin(bits), std::end(bits));
+            out.insert(out.end(), values, values + count);
+        }
+    }
+
+    // Writes width x height RGBA8 pixels as a baseline YCbCr JPEG, alpha is dropped.
+    inline void Save(const std::filesystem::path &path, const uint8_t *rgba, const int width, const int height,
+                     const Options &opt)
+    {
+        if (!rgba || width <= 0 || height <= 0 || width > 65535 || height > 65535)
+            throw __Jpeg_Ex__("invalid image: {}x{}", width, height);
+
+        const auto lumaQuant = __Detail::ScaleQuant(__Detail::LumaQuant, opt.Quality);
+        const auto chromaQuant = __Detail::ScaleQuant(__Detail::ChromaQuant, opt.Quality);
+
+        __Detail::Encoder enc{rgba, width, height,
+                              opt.Subsampling == Subsampling::Yuv444 ? 1 : 2,
+                              opt.Subsampling == Subsampling::Yuv420 ? 2 : 1};
+        for (int i = 0; i < 64; ++i)
+        {
+            enc.LumaScale[i] = 1.f / lumaQuant[i];
+            enc.ChromaScale[i] = 1.f / chromaQuant[i];
+        }
+
+        const auto mcuW = (width + 8 * enc.Hs - 1) / (8 * enc.Hs);
+        const auto mcuH = (height + 8 * enc.Vs - 1) / (8 * enc.Vs);
+        // the restart interval counts MCUs in 16 bits
+        const auto sliceRows = std::max(1, std::min(SliceRows, 65535 / mcuW));
+        const auto slices = mcuW <= 65535 ? (mcuH + sliceRows - 1) / sliceRows : 1;
+        const auto rowsPerSlice = slices == 1 ? mcuH : sliceRows;
+
+        std::vector<__Detail::BitWriter> data(slices);
+        std::vector<int> ids(slices);
+        std::iota(ids.begin(), ids.end(), 0);
+        std::for_each(std::execution::par, ids.begin(), ids.end(), [&](const int s)
+                      {
+                          auto &bw = data[s];
+                          int pred[3]{};
+                          const auto end = std::min(mcuH, (s + 1) * rowsPerSlice);
+                          for (int my = s * rowsPerSlice; my < end; ++my)
+                              for (int mx = 0; mx < mcuW; ++mx)
+                                  enc.EncodeMcu(bw, mx, my, pred);
+                          bw.Flush();
+                      });
+
+        std::vector<uint8_t> out{0xff, 0xd8};
+        __Detail::PutMarker(out, 0xe0, {'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0});
+
+        for (int t = 0; t < 2; ++t)
+        {
+            const auto &q = t == 0 ? lumaQuant : chromaQuant;
+            out.insert(out.end(), {0xff, 0xdb, 0, 67, static_cast<uint8_t>(t)});
+            for (int k = 0; k < 64; ++k)
+                out.push_back(q[__Detail::ZigZag[k]]);
+        }
+
+        const auto sampling = static_cast<uint8_t>(enc.Hs << 4 | enc.Vs);
+        __Detail::PutMarker(out, 0xc0, {8, static_cast<uint8_t>(height >> 8), static_cast<uint8_t>(height),
+                                        static_cast<uint8_t>(width >> 8), static_cast<uint8_t>(width), 3,
+                                        1, sampling, 0, 2, 0x11, 1, 3, 0x11, 1});
+
+        __Detail::PutHuffman(out, 0x00, __Detail::DcLumaBits, __Detail::DcValues);
+        __Detail::PutHuffman(out, 0x10, __Detail::AcLumaBits, __Detail::AcLumaValues);
+        __Detail::PutHuffman(out, 0x01, __Detail::DcChromaBits, __Detail::DcValues);
+        __Detail::PutHuffman(out, 0x11, __Detail::AcChromaBits, __Detail::AcChromaValues);
+
+        if (slices > 1)
+        {
+            const auto interval = mcuW * rowsPerSlice;
+            __Detail::PutMarker(out, 0xdd, {static_cast<uint8_t>(interval >> 8), static_cast<uint8_t>(interval)});
+        }
+
+        __Detail::PutMarker(out, 0xda, {3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0});
+
+        std::ofstream fs(path, std::ios::out | std::ios::binary);
+        if (!fs)
+            throw __Jpeg_Ex__("open file failed: {}", path.string());
+
+        fs.write(reinterpret_cast<const char *>(out.data()), static_cast<std::streamsize>(out.size()));
+        for (int s = 0; s < slices; ++s)
+        {
+            const auto &bytes = data[s].Bytes;
+            fs.write(reinterpret_cast<const char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+            if (s + 1 < slices)
+            {
+                const char rst[]{static_cast<char>(0xff), static_cast<char>(0xd0 + s % 8)};
+                fs.write(rst, 2);
+            }
+        }
+        fs.write("\xff\xd9", 2);
+
+        if (!fs)
+            throw __Jpeg_Ex__("write file failed: {}", path.string());
+    }
+
+#pragma region Decoder
+    // what Probe finds up to the frame header
+    struct FrameInfo
+    {
+        int Width = 0;
+        int Height = 0;
+        int Components = 0;
+        int Precision = 0; // bits per sample
+        // sequential Huffman, 8 bit samples, gray or three components: DecodeReduced takes it
+        bool Reducible = false;
+    };
+
+    // size of an extent decoded at 1 / scale
+    inline int ReducedExtent(const int extent, const int scale)
+    {
+        return (extent + scale - 1) / scale;
+    }
+
+    namespace __Detail
+    {
+        inline uint16_t GetBe16(const uint8_t *p)
+        {
+            return static_cast<uint16_t>(p[0] << 8 | p[1]);
+        }
+
+        class HuffmanDecoder
+        {
+            static constexpr int FastBits = 9;
+
+            // len << 8 | symbol for every FastBits prefix of a code that short, else 0
+            uint16_t fast[1 << FastBits]{};
+            // largest code of each length, -1 if there is none
+            int32_t maxCode[18]{};
+            // symbol index minus first code of each length
+            int32_t valPtr[17]{};
+            uint8_t values[256]{};
+
+        public:
+            // bits and values as stored in a DHT segment, count values in total
+            void Build(const uint8_t *bits, const uint8_t *vals, const int count)
+            {
+                std::fill(std::begin(fast), std::end(fast), uint16_t{0});
+                std::copy_n(vals, count, values);
+                int32_t code = 0;
+                for (int len = 1, k = 0; len <= 16; ++len, code <<= 1)
+                {
+                    // the codes of a length must fit in it with the all ones code to spare, like jdhuff checks
+                    if (code + bits[len - 1] >= 1 << len)
+                        throw __Jpeg_Ex__("bad huffman table: {} codes of length {}", bits[len - 1], len);
+                    valPtr[len] = k - code;
+                    for (int i = 0; i < bits[len - 1]; ++i, ++k, ++code)
+                        if (len <= FastBits)
+                        {
+                            const auto shift = FastBits - len;
+                            std::fill_n(fast + (code << shift), 1 << shift, static_cast<uint16_t>(len << 8 | vals[k]));
+                        }
+                    maxCode[len] = bits[len - 1] ? code - 1 : -1;
+                }
+                maxCode[17] = INT32_MAX;
+            }
+
+            template <typename Reader>
+            uint8_t Decode(Reader &reader) const
+            {
+                reader.Need(16);
+                if (const auto e = fast[reader.Peek(FastBits)])
+                {
+                    reader.Skip(e >> 8);
+                    return static_cast<uint8_t>(e);
+                }
+                for (int len = FastBits + 1; len <= 16; ++len)
+                    if (const auto code = static_cast<int32_t>(reader.Peek(len)); code <= maxCode[len])
+                    {
+                        reader.Skip(len);
+                        return values[(valPtr[len] + code) & 0xff];
+                    }
+                throw __Jpeg_Ex__("bad huffman code at {}", reader.Pos());
+            }
+        };
+
+        // entropy coded bits, stops in front of any marker and reads zeros past it
+        class BitReader
+        {
+            const uint8_t *data;
+            size_t size;
+            size_t pos;
+            uint64_t acc = 0;
+            int bits = 0;
+            bool marker = false;
+
+        public:
+            BitReader(const uint8_t *data, const size_t size, const size_t pos) : data(data), size(size), pos(pos) {}
+
+            [[nodiscard]] size_t Pos() const { return pos; }
+
+            void Fill()
+            {
+                while (bits <= 56)
+                {
+                    uint64_t b = 0;
+                    if (!marker && pos < size)
+                    {
+                        b = data[pos];
+                        if (b != 0xff)
+                            ++pos;
+                        else if (pos + 1 < size && data[pos + 1] == 0)
+                            pos += 2;
+                        else
+                        {
+                            marker = true;
+                            b = 0;
+                        }
+                    }
+                    acc |= b << (56 - bits);
+                    bits += 8;
+                }
+            }
+
+            // refills only when fewer than n (<= 16) bits are left, a refill leaves at least 57
+            void Need(const int n)
+            {
+                if (bits < n)
+                    Fill();
+            }
+
+            [[nodiscard]] uint32_t Peek(const int n) const { return static_cast<uint32_t>(acc >> (64 - n)); }
+
+            void Skip(const int n)
+            {
+                acc <<= n;
+                bits -= n;
+            }
+
+            // n (<= 16) more bits as the signed value of magnitude category n
+            int Receive(const int n)
+            {
+                if (n == 0)
+                    return 0;
+                Need(n);
+                const auto v = static_cast<int>(Peek(n));
+                Skip(n);
+                return v < 1 << (n - 1) ? v - (1 << n) + 1 : v;
+            }
+
+            // drops the partial byte and steps over the next RSTn
+            void Restart()
+            {
+                acc = 0;
+                bits = 0;
+                marker = false;
+                while (pos + 1 < size && !(data[pos] == 0xff && data[pos + 1] >= 0xd0 && data[pos + 1] <= 0xd7))
+                    ++pos;
+                pos = std::min(size, pos + 2);
+            }
+
+            // where the marker ending the scan starts
+            [[nodiscard]] size_t MarkerPos() const
+            {
+                auto p = pos;
+                while (p + 1 < size && !(data[p] == 0xff && data[p + 1] != 0 && (data[p + 1] < 0xd0 || data[p + 1] > 0xd7)))
+                    ++p;
+                return p;
+            }
+        };
+
+        // n x n IDCT of the top left n x n coefficients, which is the 8 x 8 IDCT
+        // followed by an (8 / n)^2 box average; rows are [x * n + u]
+        inline const float *ReducedIdctBasis(const int n)
+        {
+            static const auto tables = []
+            {
+                std::array<std::array<float, 64>, 4> t{};
+                for (int i = 0; i < 4; ++i)
+                {
+                    const auto m = 1 << i;
+                    for (int x = 0; x < m; ++x)
+                        for (int u = 0; u < m; ++u)
+                        {
+                            const auto c = u == 0 ? std::sqrt(1. / m) : std::sqrt(2. / m);
+                            t[i][x * m + u] = static_cast<float>(c * std::sqrt(m / 8.) *
+                                                                 std::cos((2 * x + 1) * u * std::numbers::pi / (2 * m)));
+                        }
+                }
+                return t;
+            }();
+            return tables[std::countr_zero(static_cast<unsigned>(n))].data();
+        }
+
+        struct DecodeComponent
+        {
+            int Id = 0;
+            int H = 1;
+            int V = 1;
+            int Quant = 0;
+            int Dc = 0;
+            int Ac = 0;
+            int Pred = 0;
+            int Stride = 0; // of the reduced plane
+            std::vector<uint8_t> Plane{};
+        };
+
+        struct Decoder
+        {
+            const uint8_t *Data;
+            size_t Size;
+            int Scale;
+            int N; // 8 / Scale, samples per block edge
+
+            uint16_t Quant[4][64]{}; // natural order
+            HuffmanDecoder Dc[4]{}, Ac[4]{};
+            std::vector<DecodeComponent> Comps{};
+            int Width = 0, Height = 0, Hmax = 1, Vmax = 1, McusX = 0, McusY = 0;
+            int RestartInterval = 0;
+            int Transform = -1; // Adobe APP14 color transform, -1 without one
+
+            void DecodeBlock(BitReader &reader, DecodeComponent &comp, const int bx, const int by) const
+            {
+                alignas(32) float coef[64]{};
+                const auto &q = Quant[comp.Quant];
+
+                const auto s = Dc[comp.Dc].Decode(reader);
+                if (s > 11)
+                    throw __Jpeg_Ex__("bad dc category {} at {}", s, reader.Pos());
+                comp.Pred += reader.Receive(s);
+                coef[0] = static_cast<float>(comp.Pred * q[0]);
+
+                for (int k = 1; k < 64;)
+                {
+                    const auto rs = Ac[comp.Ac].Decode(reader);
+                    const auto r = rs >> 4, size = rs & 15;
+                    if (size == 0)
+                    {
+                        if (r != 15)
+                            break;
+                        k += 16;
+                        continue;
+                    }
+                    k += r;
+                    if (k > 63)
+                        throw __Jpeg_Ex__("coefficient past the block at {}", reader.Pos());
+                    const auto v = reader.Receive(size);
+                    // only the low frequencies survive the reduction
+                    if (const auto z = ZigZag[k]; (z & 7) < N && (z >> 3) < N)
+                        coef[(z >> 3) * N + (z & 7)] = static_cast<float>(v * q[z]);
+                    ++k;
+                }
+
+                auto dst = comp.Plane.data() + static_cast<size_t>(by) * N * comp.Stride + bx * N;
+                if (N == 1)
+                {
+                    *dst = static_cast<uint8_t>(std::clamp(coef[0] / 8.f + 128.5f, 0.f, 255.f));
+                    return;
+                }
+
+                // coef is N x N here, rows by vertical frequency
+                const auto t = ReducedIdctBasis(N);
+                float tmp[64];
+                for (int v = 0; v < N; ++v)
+                    for (int x = 0; x < N; ++x)
+                    {
+                        float sum = 0;
+                        for (int u = 0; u < N; ++u)
+                            sum += t[x * N + u] * coef[v * N + u];
+                        tmp[v * N + x] = sum;
+                    }
+                for (int y = 0; y < N; ++y, dst += comp.Stride)
+                    for (int x = 0; x < N; ++x)
+                    {
+                        float sum = 128.5f;
+                        for (int v = 0; v < N; ++v)
+                            sum += t[y * N + v] * tmp[v * N + x];
+                        dst[x] = static_cast<uint8_t>(std::clamp(sum, 0.f, 255.f));
+                    }
+            }
+
+            // returns the position after the scan
+            size_t Scan(size_t pos)
+            {
+                const auto len = GetBe16(Data + pos);
+                if (len < 8 || pos + len > Size)
+                    throw __Jpeg_Ex__("truncated scan header at {}", pos);
+                const auto ns = Data[pos + 2];
+                if (ns < 1 || ns > 4 || len != 6 + 2 * ns)
+                    throw __Jpeg_Ex__("bad scan header at {}", pos);
+                std::vector<DecodeComponent *> scan{};
+                for (int i = 0; i < ns; ++i)
+                {
+                    const auto id = Data[pos + 3 + i * 2], tables = Data[pos + 4 + i * 2];
+                    const auto it = std::ranges::find(Comps, id, &DecodeComponent::Id);
+                    if (it == Comps.end() || (tables >> 4) > 3 || (tables & 15) > 3)
+                        throw __Jpeg_Ex__("bad scan component {} at {}", id, pos);
+                    it->Dc = tables >> 4;
+                    it->Ac = tables & 15;
+                    it->Pred = 0;
+                    scan.push_back(&*it);
+                }
+
+                BitReader reader(Data, Size, pos + len);
+                int mcus = 0;
+                const auto restart = [&]
+                {
+                    if (RestartInterval && mcus > 0 && mcus % RestartInterval == 0)
+                    {
+                        reader.Restart();
+                        for (const auto comp : scan)
+                            comp->Pred = 0;
+                    }
+                    ++mcus;
+                };
+
+                if (ns == 1)
+                {
+                    // a single component scan walks its own blocks, not MCUs
+                    auto &comp = *scan[0];
+                    const auto bw = ((Width * comp.H + Hmax - 1) / Hmax + 7) / 8;
+                    const auto bh = ((Height * comp.V + Vmax - 1) / Vmax + 7) / 8;
+                    for (int by = 0; by < bh; ++by)
+                        for (int bx = 0; bx < bw; ++bx)
+                        {
+                            restart();
+                            DecodeBlock(reader, comp, bx, by);
+                        }
+                }
+                else
+                {
+                    for (int my = 0; my < McusY; ++my)
+                        for (int mx = 0; mx < McusX; ++mx)
+                        {
+                            restart();
+                            for (const auto comp : scan)
+                                for (int v = 0; v < comp->V; ++v)
+                                    for (int h = 0; h < comp->H; ++h)
+                                        DecodeBlock(reader, *comp, mx * comp->H + h, my * comp->V + v);
+                        }
+                }
+                return reader.MarkerPos();
+            }
+
+            void Frame(const size_t pos)
+            {
+                const auto len = GetBe16(Data + pos);
+                if (len < 8 || pos + len > Size)
+                    throw __Jpeg_Ex__("truncated frame header at {}", pos);
+                if (!Comps.empty())
+                    throw __Jpeg_Ex__("second frame header at {}", pos);
+                const auto nf = Data[pos + 7];
+                if (len < 8 + 3 * nf)
+                    throw __Jpeg_Ex__("truncated frame header at {}", pos);
+                Height = GetBe16(Data + pos + 3);
+                Width = GetBe16(Data + pos + 5);
+                if (Width == 0 || Height == 0)
+                    throw __Jpeg_Ex__("unsupported size: {}x{}", Width, Height);
+                for (int i = 0; i < nf; ++i)
+                {
+                    const auto p = Data + pos + 8 + i * 3;
+                    DecodeComponent comp{.Id = p[0], .H = p[1] >> 4, .V = p[1] & 15, .Quant = p[2] & 3};
+                    if (comp.H < 1 || comp.H > 4 || comp.V < 1 || comp.V > 4)
+                        throw __Jpeg_Ex__("bad sampling {}x{}", comp.H, comp.V);
+                    Hmax = std::max(Hmax, comp.H);
+                    Vmax = std::max(Vmax, comp.V);
+                    Comps.push_back(std::move(comp));
+                }
+                McusX = (Width + 8 * Hmax - 1) / (8 * Hmax);
+                McusY = (Height + 8 * Vmax - 1) / (8 * Vmax);
+                for (auto &comp : Comps)
+                {
+                    comp.Stride = McusX * comp.H * N;
+                    comp.Plane.assign(static_cast<size_t>(comp.Stride) * McusY * comp.V * N, 0);
+                }
+            }
+
+            void Tables(const uint8_t marker, size_t pos, const size_t end)
+            {
+                if (marker == 0xdb)
+                    while (pos < end)
+                    {
+                        const auto pq = Data[pos] >> 4, tq = Data[pos] & 3;
+                        const auto bytes = pq ? 2 : 1;
+                        if (pos + 1 + 64 * bytes > end)
+                            throw __Jpeg_Ex__("truncated quantization table at {}", pos);
+                        for (int k = 0; k < 64; ++k)
+                            Quant[tq][ZigZag[k]] = pq ? GetBe16(Data + pos + 1 + k * 2) : Data[pos + 1 + k];
+                        pos += 1 + 64 * bytes;
+                    }
+                else
+                    while (pos < end)
+                    {
+                        const auto tc = Data[pos] >> 4, th = Data[pos] & 3;
+                        if (pos + 17 > end)
+                            throw __Jpeg_Ex__("truncated huffman table at {}", pos);
+                        const auto bits = Data + pos + 1;
+                        const auto count = std::accumulate(bits, bits + 16, 0);
+                        if (count > 256 || pos + 17 + count > end)
+                            throw __Jpeg_Ex__("bad huffman table at {}", pos);
+                        (tc ? Ac : Dc)[th].Build(bits, Data + pos + 17, count);
+                        pos += 17 + count;
+                    }
+            }
+
+            void Run()
+            {
+                for (size_t pos = 2; pos + 4 <= Size;)
+                {
+                    if (Data[pos] != 0xff)
+                        throw __Jpeg_Ex__("expected a marker at {}", pos);
+                    const auto marker = Data[pos + 1];
+                    if (marker == 0xff)
+                    {
+                        ++pos;
+                        continue;
+                    }
+                    if (marker == 0xd9)
+                        break;
+                    const auto len = GetBe16(Data + pos + 2);
+                    const auto body = pos + 4, end = pos + 2 + len;
+                    if (len < 2 || end > Size)
+                        throw __Jpeg_Ex__("truncated segment {:x} at {}", marker, pos);
+
+                    switch (marker)
+                    {
+                    case 0xc0:
+                    case 0xc1:
+                        Frame(pos + 2);
+                        break;
+                    case 0xc4:
+                    case 0xdb:
+                        Tables(marker, body, end);
+                        break;
+                    case 0xdd:
+                        if (len < 4)
+                            throw __Jpeg_Ex__("truncated restart interval at {}", pos);
+                        RestartInterval = GetBe16(Data + body);
+                        break;
+                    case 0xee:
+                        if (len >= 14 && std::equal(Data + body, Data + body + 5, "Adobe"))
+                            Transform = Data[body + 11];
+                        break;
+                    case 0xda:
+                        if (Comps.empty())
+                            throw __Jpeg_Ex__("scan before frame at {}", pos);
+                        pos = Scan(pos + 2);
+                        continue;
+                    default:
+                        break;
+                    }
+                    pos = end;
+                }
+            }
+
+            void Output(uint8_t *rgba) const
+            {
+                const auto w = ReducedExtent(Width, Scale), h = ReducedExtent(Height, Scale);
+                const auto rgb = Comps.size() == 3 &&
+                                 (Transform == 0 || (Transform < 0 && Comps[0].Id == 'R' && Comps[1].Id == 'G' && Comps[2].Id == 'B'));
+                std::vector<int> rows(h);
+                std::iota(rows.begin(), rows.end(), 0);
+                std::for_each(std::execution::par_unseq, rows.begin(), rows.end(), [&](const int y)
+                              {
+                                  const auto sample = [&](const DecodeComponent &c, const int x)
+                                  {
+                                      return c.Plane[static_cast<size_t>(y * c.V / Vmax) * c.Stride + x * c.H / Hmax];
+                                  };
+                                  auto dst = rgba + static_cast<size_t>(y) * w * 4;
+                                  for (int x = 0; x < w; ++x, dst += 4)
+                                  {
+                                      dst[3] = 255;
+                                      if (Comps.size() == 1)
+                                      {
+                                          dst[0] = dst[1] = dst[2] = sample(Comps[0], x);
+                                          continue;
+                                      }
+                                      const float c0 = sample(Comps[0], x), c1 = sample(Comps[1], x), c2 = sample(Comps[2], x);
+                                      if (rgb)
+                                      {
+                                          dst[0] = static_cast<uint8_t>(c0);
+                                          dst[1] = static_cast<uint8_t>(c1);
+                                          dst[2] = static_cast<uint8_t>(c2);
+                                          continue;
+                                      }
+                                      const auto cb = c1 - 128.f, cr = c2 - 128.f;
+                                      dst[0] = static_cast<uint8_t>(std::clamp(c0 + 1.402f * cr + .5f, 0.f, 255.f));
+                                      dst[1] = static_cast<uint8_t>(std::clamp(c0 - .344136f * cb - .714136f * cr + .5f, 0.f, 255.f));
+                                      dst[2] = static_cast<uint8_t>(std::clamp(c0 + 1.772f * cb + .5f, 0.f, 255.f));
+                                  } });
+            }
+        };
+    }
+
+    inline bool IsJpeg(const uint8_t *data, const size_t size)
+    {
+        return size >= 3 && data[0] == 0xff && data[1] == 0xd8 && data[2] == 0xff;
+    }
+
+    // Walks the markers up to the frame header, nullopt if there is none.
+    inline std::optional<FrameInfo> Probe(const uint8_t *data, const size_t size)
+    {
+        if (!IsJpeg(data, size))
+            return std::nullopt;
+        for (size_t pos = 2; pos + 4 <= size;)
+        {
+            if (data[pos] != 0xff)
+                return std::nullopt;
+            const auto marker = data[pos + 1];
+            if (marker == 0xff)
+            {
+                ++pos;
+                continue;
+            }
+            const auto len = __Detail::GetBe16(data + pos + 2);
+            const auto isSof = marker >= 0xc0 && marker <= 0xcf && marker != 0xc4 && marker != 0xc8 && marker != 0xcc;
+            if (isSof)
+            {
+                if (pos + 10 > size)
+                    return std::nullopt;
+                FrameInfo info{.Width = __Detail::GetBe16(data + pos + 7),
+                               .Height = __Detail::GetBe16(data + pos + 5),
+                               .Components = data[pos + 9],
+                               .Precision = data[pos + 4]};
+                info.Reducible = (marker == 0xc0 || marker == 0xc1) && info.Precision == 8 &&
+                                 (info.Components == 1 || info.Components == 3) && info.Width > 0 && info.Height > 0;
+                return info;
+            }
+            if (marker == 0xda || marker == 0xd9 || len < 2)
+                return std::nullopt;
+            pos += 2 + len;
+        }
+        return std::nullopt;
+    }
+
+    // Decodes a Reducible JPEG at 1 / scale (1, 2, 4 or 8) of its size in the DCT
+    // domain: only the low n x n coefficients of a block go through an n x n IDCT,
+    // n = 8 / scale. Writes ReducedExtent(width, scale) x ReducedExtent(height, scale)
+    // RGBA8 pixels, chroma is upsampled by repetition.
+    inline void DecodeReduced(const uint8_t *data, const size_t size, const int scale, uint8_t *rgba)
+    {
+        if (scale != 1 && scale != 2 && scale != 4 && scale != 8)
+            throw __Jpeg_Ex__("invalid scale: {}", scale);
+        const auto info = Probe(data, size);
+        if (!info || !info->Reducible)
+            throw __Jpeg_Ex__("unsupported jpeg: {} bytes", size);
+
+        __Detail::Decoder dec{data, size, scale, 8 / scale};
+        dec.Run();
+        if (dec.Comps.size() != static_cast<size_t>(info->Components))
+            throw __Jpeg_Ex__("frame mismatch: {} components", dec.Comps.size());
+        dec.Output(rgba);
+    }
+#pragma endregion Decoder
+}
@@ -0,0 +1,423 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <execution>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Uncompressed PAM (P7) and PFM readers and writers. Both are a short text
+// header followed by the raw samples, so reading is a copy or a convert per
+// sample. PAM headers written here are padded with a comment so the samples
+// start on a DataAlign boundary and a mapped file can be used in place.
+// PFM holds linear float RGB or gray without alpha, bottom row first; it is
+// mapped to and from 8 bit by clamping to [0, 1] with no transfer function.
+namespace Netpbm
+{
+    class Exception : public std::runtime_error
+    {
+        using std::runtime_error::runtime_error;
+    };
+
+#define __Netpbm_Ex__(fmt, ...) Exception(                           \
+    std::format("[{}:{}] [{}] [{}] {}",                              \
+                std::filesystem::path(__FILE__).filename().string(), \
+                __LINE__,                                            \
+                __FUNCTION__,                                        \
+                "Netpbm::Exception",                                 \
+                std::format(fmt, __VA_ARGS__)))
+
+    // offset alignment of the PAM samples
+    static constexpr size_t DataAlign = 64;
+
+    // what a header describes
+    struct Layout
+    {
+        int Width = 0;
+        int Height = 0;
+        int Depth = 0;  // samples per pixel, 1 ~ 4
+        int MaxVal = 0; // PAM only, 2 byte big endian samples above 255
+        bool LittleEndian = true; // PFM only
+        size_t Offset = 0;        // of the first sample
+    };
+
+    namespace __Detail
+    {
+        class Reader
+        {
+            const uint8_t *data;
+            size_t size;
+            size_t pos = 0;
+
+        public:
+            Reader(const uint8_t *data, const size_t size, const size_t pos) : data(data), size(size), pos(pos) {}
+
+            [[nodiscard]] size_t Pos() const { return pos; }
+
+            // one line without the terminator
+            std::string_view Line()
+            {
+                const auto begin = pos;
+                while (pos < size && data[pos] != '\n')
+                    ++pos;
+                if (pos >= size)
+                    throw __Netpbm_Ex__("unterminated header at {}", begin);
+                return {reinterpret_cast<const char *>(data + begin), pos++ - begin};
+            }
+
+            // whitespace separated token
+            std::string_view Token()
+            {
+                while (pos < size && std::isspace(data[pos]))
+                    ++pos;
+                const auto begin = pos;
+                while (pos < size && !std::isspace(data[pos]))
+                    ++pos;
+                if (begin == pos)
+                    throw __Netpbm_Ex__("unexpected end of header at {}", begin);
+                return {reinterpret_cast<const char *>(data + begin), pos - begin};
+            }
+
+            // the single whitespace ending a header
+            void Terminator()
+            {
+                if (pos >= size || !std::isspace(data[pos]))
+                    throw __Netpbm_Ex__("bad header terminator at {}", pos);
+                ++pos;
+            }
+        };
+
+        template <typename T>
+        T Number(const std::string_view str)
+        {
+            T v{};
+            const auto [end, ec] = std::from_chars(str.data(), str.data() + str.size(), v);
+            if (ec != std::errc{} || end != str.data() + str.size())
+                throw __Netpbm_Ex__("bad number: {}", str);
+            return v;
+        }
+
+        inline void CheckSize(const Layout &layout, const size_t sampleBytes, const size_t size)
+        {
+            if (layout.Width <= 0 || layout.Height <= 0 || layout.Depth < 1 || layout.Depth > 4)
+                throw __Netpbm_Ex__("invalid image: {}x{}x{}", layout.Width, layout.Height, layout.Depth);
+            const auto need = static_cast<uint64_t>(layout.Width) * layout.Height * layout.Depth * sampleBytes;
+            if (layout.Offset > size || size - layout.Offset < need)
+                throw __Netpbm_Ex__("truncated: {} of {} bytes", size - std::min(size, layout.Offset), need);
+        }
+
+        inline uint8_t ToByte(const float v)
+        {
+            return static_cast<uint8_t>(std::clamp(v, 0.f, 1.f) * 255.f + .5f);
+        }
+
+        // expands depth 1 ~ 4 samples of one pixel to RGBA
+        inline void Expand(const uint8_t *s, const int depth, uint8_t *dst)
+        {
+            switch (depth)
+            {
+            case 1:
+                dst[0] = dst[1] = dst[2] = s[0];
+                dst[3] = 255;
+                break;
+            case 2:
+                dst[0] = dst[1] = dst[2] = s[0];
+                dst[3] = s[1];
+                break;
+            case 3:
+                std::copy_n(s, 3, dst);
+                dst[3] = 255;
+                break;
+            default:
+                std::copy_n(s, 4, dst);
+            }
+        }
+
+        inline std::vector<int> Rows(const int height)
+        {
+            std::vector<int> rows(height);
+            std::iota(rows.begin(), rows.end(), 0);
+            return rows;
+        }
+
+        inline void Write(const std::filesystem::path &path, const std::string &header,
+                          const uint8_t *body, const size_t size)
+        {
+            std::ofstream fs(path, std::ios::out | std::ios::binary);
+            if (!fs)
+                throw __Netpbm_Ex__("open file failed: {}", path.string());
+            fs.write(header.data(), static_cast<std::streamsize>(header.size()));
+            fs.write(reinterpret_cast<const char *>(body), static_cast<std::streamsize>(size));
+            if (!fs)
+                throw __Netpbm_Ex__("write file failed: {}", path.string());
+        }
+    }
+
+    inline bool IsPam(const uint8_t *data, const size_t size)
+    {
+        return size >= 3 && data[0] == 'P' && data[1] == '7' && std::isspace(data[2]);
+    }
+
+    inline bool IsPfm(const uint8_t *data, const size_t size)
+    {
+        return size >= 3 && data[0] == 'P' && (data[1] == 'F' || data[1] == 'f') && std::isspace(data[2]);
+    }
+
+    // checkSize off reads the header alone, data may then be just a prefix of the file
+    inline Layout PamLayout(const uint8_t *data, const size_t size, const bool checkSize = true)
+    {
+        if (!IsPam(data, size))
+            throw __Netpbm_Ex__("not a pam image: {} bytes", size);
+
+        Layout layout{};
+        __Detail::Reader reader(data, size, 3);
+        while (true)
+        {
+            const auto line = reader.Line();
+            if (line.empty() || line.front() == '#')
+                continue;
+            const auto split = line.find_first_of(" \t\r");
+            const auto key = line.substr(0, split);
+            auto value = split == std::string_view::npos ? std::string_view{} : line.substr(split + 1);
+            value.remove_prefix(std::min(value.find_first_not_of(" \t"), value.size()));
+            value = value.substr(0, value.find_last_not_of(" \t\r") + 1);
+            if (key == "ENDHDR")
+                break;
+            if (key == "WIDTH")
+                layout.Width = __Detail::Number<int>(value);
+            else if (key == "HEIGHT")
+                layout.Height = __Detail::Number<int>(value);
+            else if (key == "DEPTH")
+                layout.Depth = __Detail::Number<int>(value);
+            else if (key == "MAXVAL")
+                layout.MaxVal = __Detail::Number<int>(value);
+            // TUPLTYPE only names what DEPTH already says
+        }
+        layout.Offset = reader.Pos();
+
+        if (layout.MaxVal < 1 || layout.MaxVal > 65535)
+            throw __Netpbm_Ex__("invalid maxval: {}", layout.MaxVal);
+        if (checkSize)
+            __Detail::CheckSize(layout, layout.MaxVal > 255 ? 2 : 1, size);
+        return layout;
+    }
+
+    inline Layout PfmLayout(const uint8_t *data, const size_t size, const bool checkSize = true)
+    {
+        if (!IsPfm(data, size))
+            throw __Netpbm_Ex__("not a pfm image: {} bytes", size);
+
+        Layout layout{};
+        layout.Depth = data[1] == 'F' ? 3 : 1;
+        __Detail::Reader reader(data, size, 2);
+        layout.Width = __Detail::Number<int>(reader.Token());
+        layout.Height = __Detail::Number<int>(reader.Token());
+        const auto scale = __Detail::Number<float>(reader.Token());
+        reader.Terminator();
+        if (scale == 0 || !std::isfinite(scale))
+            throw __Netpbm_Ex__("invalid scale: {}", scale);
+        layout.LittleEndian = scale < 0;
+        layout.Offset = reader.Pos();
+
+        if (checkSize)
+            __Detail::CheckSize(layout, sizeof(float), size);
+        return layout;
+    }
+
+    // header of either format, see PamLayout
+    inline Layout Header(const uint8_t *data, const size_t size)
+    {
+        return IsPfm(data, size) ? PfmLayout(data, size, false) : PamLayout(data, size, false);
+    }
+
+    // dimensions from the header of either format
+    inline void Info(const uint8_t *data, const size_t size, int &width, int &height)
+    {
+        const auto layout = IsPfm(data, size) ? PfmLayout(data, size) : PamLayout(data, size);
+        width = layout.Width;
+        height = layout.Height;
+    }
+
+    // decodes a PAM or PFM into width x height RGBA8 pixels, see Info
+    inline void Decode(const uint8_t *data, const size_t size, uint8_t *rgba)
+    {
+        using namespace __Detail;
+
+        const auto pfm = IsPfm(data, size);
+        const auto layout = pfm ? PfmLayout(data, size) : PamLayout(data, size);
+        const auto w = static_cast<size_t>(layout.Width);
+        const auto depth = layout.Depth;
+        const auto samples = data + layout.Offset;
+        const auto rows = Rows(layout.Height);
+
+        if (pfm)
+        {
+            const auto swap = layout.LittleEndian != (std::endian::native == std::endian::little);
+            std::for_each(std::execution::par_unseq, rows.begin(), rows.end(), [&](const int y)
+                          {
+                              // bottom row first
+                              const auto src = samples + (layout.Height - 1 - y) * w * depth * sizeof(float);
+                              const auto dst = rgba + y * w * 4;
+                              for (size_t i = 0; i < w; ++i)
+                              {
+                                  uint8_t px[4];
+                                  for (int c = 0; c < depth; ++c)
+                                  {
+                                      uint32_t bits;
+                                      std::memcpy(&bits, src + (i * depth + c) * sizeof(float), sizeof(float));
+                                      if (swap)
+                                          bits = std::byteswap(bits);
+                                      px[c] = ToByte(std::bit_cast<float>(bits));
+                                  }
+                                  Expand(px, depth, dst + i * 4);
+                              } });
+            return;
+        }
+
+        const auto wide = layout.MaxVal > 255;
+        const auto maxVal = static_cast<uint32_t>(layout.MaxVal);
+        std::for_each(std::execution::par_unseq, rows.begin(), rows.end(), [&](const int y)
+                      {
+                          const auto src = samples + y * w * depth * (wide ? 2 : 1);
+                          const auto dst = rgba + y * w * 4;
+                          if (!wide && maxVal == 255)
+                          {
+                              if (depth == 4)
+                                  std::copy_n(src, w * 4, dst);
+                              else
+                                  for (size_t i = 0; i < w; ++i)
+                                      Expand(src + i * depth, depth, dst + i * 4);
+                              return;
+                          }
+                          for (size_t i = 0; i < w; ++i)
+                          {
+                              uint8_t px[4];
+                              for (int c = 0; c < depth; ++c)
+                              {
+                                  const auto k = i * depth + c;
+                                  const auto v = wide ? static_cast<uint32_t>(src[k * 2]) << 8 | src[k * 2 + 1] : src[k];
+                                  px[c] = static_cast<uint8_t>((std::min(v, maxVal) * 255 + maxVal / 2) / maxVal);
+                              }
+                              Expand(px, depth, dst + i * 4);
+                          } });
+    }
+
+    // Decodes a PAM or PFM keeping its samples: Depth channels of uint8_t up to
+    // MAXVAL 255, uint16_t above it and float for PFM, top row first in native
+    // byte order. A MAXVAL short of the type's range is scaled up to it.
+    inline void DecodeNative(const uint8_t *data, const size_t size, uint8_t *out)
+    {
+        using namespace __Detail;
+
+        const auto pfm = IsPfm(data, size);
+        const auto layout = pfm ? PfmLayout(data, size) : PamLayout(data, size);
+        const auto n = static_cast<size_t>(layout.Width) * layout.Depth;
+        const auto samples = data + layout.Offset;
+        const auto rows = Rows(layout.Height);
+
+        if (pfm)
+        {
+            const auto swap = layout.LittleEndian != (std::endian::native == std::endian::little);
+            std::for_each(std::execution::par_unseq, rows.begin(), rows.end(), [&](const int y)
+                          {
+                              // bottom row first
+                              const auto src = samples + (layout.Height - 1 - y) * n * sizeof(float);
+                              const auto dst = out + y * n * sizeof(float);
+                              if (!swap)
+                              {
+                                  std::memcpy(dst, src, n * sizeof(float));
+                                  return;
+                              }
+                              for (size_t k = 0; k < n; ++k)
+                              {
+                                  uint32_t bits;
+                                  std::memcpy(&bits, src + k * sizeof(float), sizeof(float));
+                                  bits = std::byteswap(bits);
+                                  std::memcpy(dst + k * sizeof(float), &bits, sizeof(float));
+                              } });
+            return;
+        }
+
+        const auto wide = layout.MaxVal > 255;
+        const auto maxVal = static_cast<uint32_t>(layout.MaxVal);
+        const auto full = wide ? 65535u : 255u;
+        std::for_each(std::execution::par_unseq, rows.begin(), rows.end(), [&](const int y)
+                      {
+                          if (!wide)
+                          {
+                              const auto src = samples + y * n;
+                              const auto dst = out + y * n;
+                              if (maxVal == full)
+                                  std::memcpy(dst, src, n);
+                              else
+                                  for (size_t k = 0; k < n; ++k)
+                                      dst[k] = static_cast<uint8_t>((std::min<uint32_t>(src[k], maxVal) * full + maxVal / 2) / maxVal);
+                              return;
+                          }
+                          const auto src = samples + y * n * 2;
+                          const auto dst = out + y * n * 2;
+                          for (size_t k = 0; k < n; ++k)
+                          {
+                              auto v = static_cast<uint32_t>(src[k * 2]) << 8 | src[k * 2 + 1];
+                              if (maxVal != full)
+                                  v = (std::min(v, maxVal) * full + maxVal / 2) / maxVal;
+                              const auto s = static_cast<uint16_t>(v);
+                              std::memcpy(dst + k * 2, &s, 2);
+                          } });
+    }
+
+    // Writes width x height RGBA8 pixels as an RGB_ALPHA PAM, samples aligned to DataAlign.
+    inline void SavePam(const std::filesystem::path &path, const uint8_t *rgba, const int width, const int height)
+    {
+        if (!rgba || width <= 0 || height <= 0)
+            throw __Netpbm_Ex__("invalid image: {}x{}", width, height);
+
+        auto header = std::format("P7\nWIDTH {}\nHEIGHT {}\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\n", width, height);
+        constexpr std::string_view end = "ENDHDR\n";
+        // a comment line of at least "#\n" fills up to the boundary
+        const auto used = header.size() + end.size() + 2;
+        const auto fill = (DataAlign - used % DataAlign) % DataAlign;
+        header += '#';
+        header.append(fill, ' ');
+        header += '\n';
+        header += end;
+
+        __Detail::Write(path, header, rgba, static_cast<size_t>(width) * height * 4);
+    }
+
+    // Writes the RGB of width x height RGBA8 pixels as a little endian PFM, alpha is dropped.
+    inline void SavePfm(const std::filesystem::path &path, const uint8_t *rgba, const int width, const int height)
+    {
+        if (!rgba || width <= 0 || height <= 0)
+            throw __Netpbm_Ex__("invalid image: {}x{}", width, height);
+
+        const auto w = static_cast<size_t>(width);
+        std::vector<float> body(w * height * 3);
+        const auto rows = __Detail::Rows(height);
+        std::for_each(std::execution::par_unseq, rows.begin(), rows.end(), [&](const int y)
+                      {
+                          const auto src = rgba + y * w * 4;
+                          const auto dst = body.data() + (height - 1 - y) * w * 3;
+                          for (size_t i = 0; i < w; ++i)
+                              for (int c = 0; c < 3; ++c)
+                                  dst[i * 3 + c] = static_cast<float>(src[i * 4 + c]) * (1.f / 255.f);
+                      });
+        if constexpr (std::endian::native != std::endian::little)
+            for (auto &v : body)
+                v = std::bit_cast<float>(std::byteswap(std::bit_cast<uint32_t>(v)));
+
+        __Detail::Write(path, std::format("PF\n{} {}\n-1.0\n", width, height),
+                        reinterpret_cast<const uint8_t *>(body.data()), body.size() * sizeof(float));
+    }
+}
@@ -0,0 +1,281 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <execution>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include <zlib.h>
+
+#include "Simd.hpp"
+
+// PNG writer. Every row gets the filter with the smallest sum of absolute
+// residuals; the filtered stream is cut into chunks that are deflated in
+// parallel, each primed with the 32K before it and ended on a byte boundary
+// with a sync flush, so the concatenation is one valid zlib stream (as pigz
+// does). Opaque images are written as RGB.
+namespace Png
+{
+    class Exception : public std::runtime_error
+    {
+        using std::runtime_error::runtime_error;
+    };
+
+#define __Png_Ex__(fmt, ...) Exception(                              \
+    std::format("[{}:{}] [{}] [{}] {}",                              \
+                std::filesystem::path(__FILE__).filename().string(), \
+                __LINE__,                                            \
+                __FUNCTION__,                                        \
+                "Png::Exception",                                    \
+                std::format(fmt, __VA_ARGS__)))
+
+    // zlib levels 0, 1, 6 and 9; Store also skips filtering
+    enum class Level
+    {
+        Store,
+        Fast,
+        Default,
+        Max
+    };
+
+    struct Options
+    {
+        Png::Level Level = Png::Level::Default;
+    };
+
+    // uncompressed bytes per deflate chunk, large enough that the sync flushes cost nothing
+    static constexpr size_t ChunkBytes = 512 * 1024;
+
+    namespace __Detail
+    {
+        enum Filter : uint8_t
+        {
+            None,
+            Sub,
+            Up,
+            Average,
+            Paeth
+        };
+
+        inline void PutBe32(uint8_t *p, const uint32_t v)
+        {
+            p[0] = static_cast<uint8_t>(v >> 24);
+            p[1] = static_cast<uint8_t>(v >> 16);
+            p[2] = static_cast<uint8_t>(v >> 8);
+            p[3] = static_cast<uint8_t>(v);
+        }
+
+        inline int ZLevel(const Level level)
+        {
+            switch (level)
+            {
+            case Level::Store:
+                return 0;
+            case Level::Fast:
+                return 1;
+            case Level::Max:
+                return 9;
+            default:
+                return 6;
+            }
+        }
+
+        inline void PackRow(const uint8_t *rgba, const size_t width, const int channels, uint8_t *dst)
+        {
+            if (channels == 4)
+            {
+                std::copy_n(rgba, width * 4, dst);
+                return;
+            }
+            for (size_t x = 0; x < width; ++x)
+                std::copy_n(rgba + x * 4, 3, dst + x * 3);
+        }
+
+        // Filter type byte and filtered bytes of every row, rows are independent
+        // since the filters only read the unfiltered image.
+        inline std::vector<uint8_t> FilterImage(const uint8_t *rgba, const int width, const int height,
+                                                const int channels, const bool adaptive)
+        {
+            const auto n = static_cast<size_t>(width) * channels;
+            const auto bpp = static_cast<size_t>(channels);
+            std::vector<uint8_t> out((n + 1) * height);
+
+            std::vector<int> rows(height);
+            std::iota(rows.begin(), rows.end(), 0);
+            std::for_each(std::execution::par_unseq, rows.begin(), rows.end(), [&](const int y)
+                          {
+                              thread_local std::vector<uint8_t> raw{}, prior{}, candidates{};
+                              raw.resize(n);
+                              prior.assign(n, 0);
+                              candidates.resize(n * 5);
+
+                              const auto stride = static_cast<size_t>(width) * 4;
+                              PackRow(rgba + y * stride, width, channels, raw.data());
+                              if (y > 0)
+                                  PackRow(rgba + (y - 1) * stride, width, channels, prior.data());
+
+                              auto dst = out.data() + y * (n + 1);
+                              if (!adaptive)
+                              {
+                                  dst[0] = None;
+                                  std::copy_n(raw.data(), n, dst + 1);
+                                  return;
+                              }
+
+                              const auto sub = candidates.data() + n, up = sub + n, avg = up + n, paeth = avg + n;
+                              for (size_t i = 0; i < n; ++i)
+                              {
+                                  const int a = i >= bpp ? raw[i - bpp] : 0;
+                                  sub[i] = static_cast<uint8_t>(raw[i] - a);
+                                  up[i] = static_cast<uint8_t>(raw[i] - prior[i]);
+                                  avg[i] = static_cast<uint8_t>(raw[i] - ((a + prior[i]) >> 1));
+                              }
+                              Simd::PaethFilter(raw.data(), prior.data(), n, bpp, paeth);
+
+                              std::copy_n(raw.data(), n, candidates.data());
+                              auto best = None;
+                              auto bestSum = Simd::SumAbsSigned(raw.data(), n);
+                              for (const auto f : {Sub, Up, Average, Paeth})
+                                  if (const auto sum = Simd::SumAbsSigned(candidates.data() + f * n, n); sum < bestSum)
+                                  {
+                                      best = f;
+                                      bestSum = sum;
+                                  }
+
+                              dst[0] = best;
+                              std::copy_n(candidates.data() + best * n, n, dst + 1);
+                          });
+            return out;
+        }
+
+        struct Chunk
+        {
+            std::vector<uint8_t> Data{};
+            uint32_t Adler = 0;
+            size_t Length = 0;
+        };
+
+        inline Chunk DeflateChunk(const uint8_t *data, const size_t begin, const size_t end, const bool last,
+                                  const int level)
+        {
+            z_stream zs{};
+            if (deflateInit2(&zs, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+                throw __Png_Ex__("deflateInit2 failed: level {}", level);
+
+            Chunk chunk{};
+            try
+            {
+                if (begin > 0)
+                {
+                    const auto dict = std::min<size_t>(begin, 32768);
+                    if (deflateSetDictionary(&zs, data + begin - dict, static_cast<uInt>(dict)) != Z_OK)
+                        throw __Png_Ex__("deflateSetDictionary failed: {}", begin);
+                }
+
+                const auto length = end - begin;
+                // room for the sync flush marker on top of the bound
+                chunk.Data.resize(deflateBound(&zs, static_cast<uLong>(length)) + 16);
+                zs.next_in = const_cast<Bytef *>(data + begin);
+                zs.avail_in = static_cast<uInt>(length);
+                zs.next_out = chunk.Data.data();
+                zs.avail_out = static_cast<uInt>(chunk.Data.size());
+
+                const auto ret = deflate(&zs, last ? Z_FINISH : Z_SYNC_FLUSH);
+                if ((last && ret != Z_STREAM_END) || (!last && (ret != Z_OK || zs.avail_in != 0)))
+                    throw __Png_Ex__("deflate failed: {}", ret);
+
+                chunk.Data.resize(zs.total_out);
+                chunk.Adler = adler32(adler32(0, nullptr, 0), data + begin, static_cast<uInt>(length));
+                chunk.Length = length;
+            }
+            catch (...)
+            {
+                deflateEnd(&zs);
+                throw;
+            }
+            deflateEnd(&zs);
+            return chunk;
+        }
+
+        inline void WriteChunk(std::ofstream &fs, const char (&type)[5], const uint8_t *data, const size_t size)
+        {
+            uint8_t head[8];
+            PutBe32(head, static_cast<uint32_t>(size));
+            std::copy_n(type, 4, head + 4);
+            auto crc = crc32(0, head + 4, 4);
+            if (size > 0)
+                crc = crc32(crc, data, static_cast<uInt>(size));
+            uint8_t tail[4];
+            PutBe32(tail, static_cast<uint32_t>(crc));
+
+            fs.write(reinterpret_cast<const char *>(head), 8);
+            fs.write(reinterpret_cast<const char *>(data), static_cast<std::streamsize>(size));
+            fs.write(reinterpret_cast<const char *>(tail), 4);
+        }
+    }
+
+    // Writes width x height RGBA8 pixels as an 8 bit RGBA, or RGB when every pixel is opaque, PNG.
+    inline void Save(const std::filesystem::path &path, const uint8_t *rgba, const int width, const int height,
+                     const Options &opt)
+    {
+        if (!rgba || width <= 0 || height <= 0)
+            throw __Png_Ex__("invalid image: {}x{}", width, height);
+
+        const auto pixels = static_cast<size_t>(width) * height;
+        bool opaque = true;
+        for (size_t i = 0; i < pixels && opaque; ++i)
+            opaque = rgba[i * 4 + 3] == 255;
+        const auto channels = opaque ? 3 : 4;
+
+        const auto filtered = __Detail::FilterImage(rgba, width, height, channels, opt.Level != Level::Store);
+
+        const auto count = std::max<size_t>(1, (filtered.size() + ChunkBytes - 1) / ChunkBytes);
+        std::vector<__Detail::Chunk> chunks(count);
+        std::vector<size_t> ids(count);
+        std::iota(ids.begin(), ids.end(), size_t{0});
+        const auto level = __Detail::ZLevel(opt.Level);
+        std::for_each(std::execution::par, ids.begin(), ids.end(), [&](const size_t i)
+                      {
+                          const auto begin = i * ChunkBytes;
+                          const auto end = std::min(filtered.size(), begin + ChunkBytes);
+                          chunks[i] = __Detail::DeflateChunk(filtered.data(), begin, end, i + 1 == count, level);
+                      });
+
+        auto adler = chunks[0].Adler;
+        for (size_t i = 1; i < count; ++i)
+            adler = adler32_combine(adler, chunks[i].Adler, static_cast<z_off_t>(chunks[i].Length));
+
+        // zlib header: deflate with a 32K window, the level hint and check bits
+        static constexpr uint8_t levelFlags[]{0x01, 0x01, 0x9c, 0xda};
+        chunks.front().Data.insert(chunks.front().Data.begin(), {0x78, levelFlags[static_cast<int>(opt.Level)]});
+        uint8_t trailer[4];
+        __Detail::PutBe32(trailer, static_cast<uint32_t>(adler));
+        chunks.back().Data.insert(chunks.back().Data.end(), trailer, trailer + 4);
+
+        std::ofstream fs(path, std::ios::out | std::ios::binary);
+        if (!fs)
+            throw __Png_Ex__("open file failed: {}", path.string());
+
+        static constexpr uint8_t signature[]{0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+        fs.write(reinterpret_cast<const char *>(signature), sizeof(signature));
+
+        uint8_t ihdr[13]{};
+        __Detail::PutBe32(ihdr, static_cast<uint32_t>(width));
+        __Detail::PutBe32(ihdr + 4, static_cast<uint32_t>(height));
+        ihdr[8] = 8;
+        ihdr[9] = opaque ? 2 : 6;
+        __Detail::WriteChunk(fs, "IHDR", ihdr, sizeof(ihdr));
+
+        for (const auto &chunk : chunks)
+            __Detail::WriteChunk(fs, "IDAT", chunk.Data.data(), chunk.Data.size());
+        __Detail::WriteChunk(fs, "IEND", nullptr, 0);
+
+        if (!fs)
+            throw __Png_Ex__("write file failed: {}", path.string());
+    }
+}
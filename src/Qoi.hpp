@@ -0,0 +1,267 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+// QOI (https://qoiformat.org) reader and writer. Lossless and one pass over
+// the pixels each way, meant for intermediates where encode and decode time
+// matter more than size. Opaque images are flagged as 3 channel; pixels are
+// RGBA8 in memory either way.
+namespace Qoi
+{
+    class Exception : public std::runtime_error
+    {
+        using std::runtime_error::runtime_error;
+    };
+
+#define __Qoi_Ex__(fmt, ...) Exception(                              \
+    std::format("[{}:{}] [{}] [{}] {}",                              \
+                std::filesystem::path(__FILE__).filename().string(), \
+                __LINE__,                                            \
+                __FUNCTION__,                                        \
+                "Qoi::Exception",                                    \
+                std::format(fmt, __VA_ARGS__)))
+
+    namespace __Detail
+    {
+        constexpr uint8_t OpIndex = 0x00;
+        constexpr uint8_t OpDiff = 0x40;
+        constexpr uint8_t OpLuma = 0x80;
+        constexpr uint8_t OpRun = 0xc0;
+        constexpr uint8_t OpRgb = 0xfe;
+        constexpr uint8_t OpRgba = 0xff;
+        constexpr uint8_t OpMask = 0xc0;
+
+        constexpr size_t HeaderBytes = 14;
+        constexpr uint8_t Padding[8]{0, 0, 0, 0, 0, 0, 0, 1};
+
+        struct Pixel
+        {
+            uint8_t R, G, B, A;
+
+            bool operator==(const Pixel &) const = default;
+        };
+
+        inline int Hash(const Pixel &p)
+        {
+            return (p.R * 3 + p.G * 5 + p.B * 7 + p.A * 11) % 64;
+        }
+
+        inline uint32_t GetBe32(const uint8_t *p)
+        {
+            return static_cast<uint32_t>(p[0]) << 24 | static_cast<uint32_t>(p[1]) << 16 |
+                   static_cast<uint32_t>(p[2]) << 8 | p[3];
+        }
+
+        inline void PutBe32(uint8_t *p, const uint32_t v)
+        {
+            p[0] = static_cast<uint8_t>(v >> 24);
+            p[1] = static_cast<uint8_t>(v >> 16);
+            p[2] = static_cast<uint8_t>(v >> 8);
+            p[3] = static_cast<uint8_t>(v);
+        }
+    }
+
+    inline bool IsQoi(const uint8_t *data, const size_t size)
+    {
+        return size >= __Detail::HeaderBytes && std::memcmp(data, "qoif", 4) == 0;
+    }
+
+    // dimensions from the header
+    inline void Info(const uint8_t *data, const size_t size, int &width, int &height)
+    {
+        if (!IsQoi(data, size))
+            throw __Qoi_Ex__("not a qoi image: {} bytes", size);
+        const auto w = __Detail::GetBe32(data + 4), h = __Detail::GetBe32(data + 8);
+        // the limit the format sets on the pixel count
+        if (w == 0 || h == 0 || static_cast<uint64_t>(w) * h > 400'000'000)
+            throw __Qoi_Ex__("invalid size: {}x{}", w, h);
+        width = static_cast<int>(w);
+        height = static_cast<int>(h);
+    }
+
+    // 3 or 4 as the header says, the pixels decode to RGBA8 either way
+    inline int Channels(const uint8_t *data, const size_t size)
+    {
+        if (!IsQoi(data, size))
+            throw __Qoi_Ex__("not a qoi image: {} bytes", size);
+        if (data[12] != 3 && data[12] != 4)
+            throw __Qoi_Ex__("invalid channels: {}", data[12]);
+        return data[12];
+    }
+
+    // decodes into width x height RGBA8 pixels, see Info
+    inline void Decode(const uint8_t *data, const size_t size, uint8_t *rgba)
+    {
+        using namespace __Detail;
+
+        int width, height;
+        Info(data, size, width, height);
+        const auto pixels = static_cast<size_t>(width) * height;
+        // the last op can not reach into the end marker
+        const auto end = size >= HeaderBytes + sizeof(Padding) ? size - sizeof(Padding) : HeaderBytes;
+
+        Pixel index[64]{};
+        Pixel px{0, 0, 0, 255};
+        size_t pos = HeaderBytes;
+        int run = 0;
+        for (size_t i = 0; i < pixels; ++i)
+        {
+            if (run > 0)
+                --run;
+            else if (pos < end)
+            {
+                const auto b1 = data[pos++];
+                if (b1 == OpRgb)
+                {
+                    if (pos + 3 > end)
+                        throw __Qoi_Ex__("truncated at pixel {}", i);
+                    px.R = data[pos];
+                    px.G = data[pos + 1];
+                    px.B = data[pos + 2];
+                    pos += 3;
+                }
+                else if (b1 == OpRgba)
+                {
+                    if (pos + 4 > end)
+                        throw __Qoi_Ex__("truncated at pixel {}", i);
+                    px = {data[pos], data[pos + 1], data[pos + 2], data[pos + 3]};
+                    pos += 4;
+                }
+                else if ((b1 & OpMask) == OpIndex)
+                    px = index[b1];
+                else if ((b1 & OpMask) == OpDiff)
+                {
+                    px.R += static_cast<uint8_t>((b1 >> 4 & 3) - 2);
+                    px.G += static_cast<uint8_t>((b1 >> 2 & 3) - 2);
+                    px.B += static_cast<uint8_t>((b1 & 3) - 2);
+                }
+                else if ((b1 & OpMask) == OpLuma)
+                {
+                    if (pos >= end)
+                        throw __Qoi_Ex__("truncated at pixel {}", i);
+                    const auto b2 = data[pos++];
+                    const auto vg = (b1 & 0x3f) - 32;
+                    px.R += static_cast<uint8_t>(vg - 8 + (b2 >> 4 & 0x0f));
+                    px.G += static_cast<uint8_t>(vg);
+                    px.B += static_cast<uint8_t>(vg - 8 + (b2 & 0x0f));
+                }
+                else
+                    run = b1 & 0x3f;
+
+                index[Hash(px)] = px;
+            }
+            else
+                throw __Qoi_Ex__("truncated at pixel {}", i);
+
+            std::memcpy(rgba + i * 4, &px, 4);
+        }
+    }
+
+    inline std::vector<uint8_t> Encode(const uint8_t *rgba, const int width, const int height)
+    {
+        using namespace __Detail;
+
+        if (!rgba || width <= 0 || height <= 0)
+            throw __Qoi_Ex__("invalid image: {}x{}", width, height);
+
+        const auto pixels = static_cast<size_t>(width) * height;
+        bool opaque = true;
+        for (size_t i = 0; i < pixels && opaque; ++i)
+            opaque = rgba[i * 4 + 3] == 255;
+
+        // worst case every pixel is an OpRgba
+        std::vector<uint8_t> out(HeaderBytes + pixels * 5 + sizeof(Padding));
+        auto dst = out.data();
+        std::memcpy(dst, "qoif", 4);
+        PutBe32(dst + 4, static_cast<uint32_t>(width));
+        PutBe32(dst + 8, static_cast<uint32_t>(height));
+        dst[12] = opaque ? 3 : 4;
+        dst[13] = 0; // sRGB with linear alpha
+        dst += HeaderBytes;
+
+        Pixel index[64]{};
+        Pixel prev{0, 0, 0, 255};
+        int run = 0;
+        for (size_t i = 0; i < pixels; ++i)
+        {
+            Pixel px;
+            std::memcpy(&px, rgba + i * 4, 4);
+
+            if (px == prev)
+            {
+                if (++run == 62 || i + 1 == pixels)
+                {
+                    *dst++ = static_cast<uint8_t>(OpRun | (run - 1));
+                    run = 0;
+                }
+                continue;
+            }
+
+            if (run > 0)
+            {
+                *dst++ = static_cast<uint8_t>(OpRun | (run - 1));
+                run = 0;
+            }
+
+            const auto h = Hash(px);
+            if (index[h] == px)
+                *dst++ = static_cast<uint8_t>(OpIndex | h);
+            else
+            {
+                index[h] = px;
+                if (px.A == prev.A)
+                {
+                    const auto vr = static_cast<int8_t>(px.R - prev.R);
+                    const auto vg = static_cast<int8_t>(px.G - prev.G);
+                    const auto vb = static_cast<int8_t>(px.B - prev.B);
+                    const auto vgr = vr - vg, vgb = vb - vg;
+                    if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2)
+                        *dst++ = static_cast<uint8_t>(OpDiff | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+                    else if (vgr > -9 && vgr < 8 && vg > -33 && vg < 32 && vgb > -9 && vgb < 8)
+                    {
+                        *dst++ = static_cast<uint8_t>(OpLuma | (vg + 32));
+                        *dst++ = static_cast<uint8_t>((vgr + 8) << 4 | (vgb + 8));
+                    }
+                    else
+                    {
+                        *dst++ = OpRgb;
+                        *dst++ = px.R;
+                        *dst++ = px.G;
+                        *dst++ = px.B;
+                    }
+                }
+                else
+                {
+                    *dst++ = OpRgba;
+                    std::memcpy(dst, &px, 4);
+                    dst += 4;
+                }
+            }
+            prev = px;
+        }
+
+        dst = std::copy(std::begin(Padding), std::end(Padding), dst);
+        out.resize(dst - out.data());
+        return out;
+    }
+
+    // Writes width x height RGBA8 pixels as QOI.
+    inline void Save(const std::filesystem::path &path, const uint8_t *rgba, const int width, const int height)
+    {
+        const auto bytes = Encode(rgba, width, height);
+
+        std::ofstream fs(path, std::ios::out | std::ios::binary);
+        if (!fs)
+            throw __Qoi_Ex__("open file failed: {}", path.string());
+        fs.write(reinterpret_cast<const char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        if (!fs)
+            throw __Qoi_Ex__("write file failed: {}", path.string());
+    }
+}
@@ -0,0 +1,1557 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define __SIMD_X64__ 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+#endif
+
+// MSVC emits any intrinsic anywhere, gcc/clang need the target enabled per function
+#if defined(__SIMD_X64__) && !defined(_MSC_VER)
+#define __SIMD_TARGET__(t) __attribute__((target(t)))
+#else
+#define __SIMD_TARGET__(t)
+#endif
+
+namespace Simd
+{
+    enum class Level
+    {
+        Scalar,
+        Sse2,
+        Avx2,
+        Avx512
+    };
+
+    namespace __Detail
+    {
+#ifdef __SIMD_X64__
+        inline void CpuId(int out[4], const int leaf, const int sub)
+        {
+#ifdef _MSC_VER
+            __cpuidex(out, leaf, sub);
+#else
+            unsigned a, b, c, d;
+            __cpuid_count(leaf, sub, a, b, c, d);
+            out[0] = static_cast<int>(a);
+            out[1] = static_cast<int>(b);
+            out[2] = static_cast<int>(c);
+            out[3] = static_cast<int>(d);
+#endif
+        }
+
+        inline uint64_t XGetBv()
+        {
+#ifdef _MSC_VER
+            return _xgetbv(0);
+#else
+            uint32_t lo, hi;
+            __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+            return static_cast<uint64_t>(hi) << 32 | lo;
+#endif
+        }
+
+        // the cpu must have the instructions and the os must save the registers
+        inline Level Detect()
+        {
+            int info[4]{};
+            CpuId(info, 0, 0);
+            const auto maxLeaf = info[0];
+
+            CpuId(info, 1, 0);
+            const bool fma = info[2] & (1 << 12);
+            const bool osxsave = info[2] & (1 << 27);
+            const bool avx = info[2] & (1 << 28);
+            if (!osxsave || !avx || maxLeaf < 7)
+                return Level::Sse2;
+
+            const auto xcr0 = XGetBv();
+            if ((xcr0 & 0x6) != 0x6)
+                return Level::Sse2;
+
+            CpuId(info, 7, 0);
+            const bool avx2 = info[1] & (1 << 5);
+            const bool avx512f = info[1] & (1 << 16);
+            const bool avx512bw = info[1] & (1 << 30);
+
+            if (avx512f && avx512bw && (xcr0 & 0xe6) == 0xe6)
+                return Level::Avx512;
+            if (avx2 && fma)
+                return Level::Avx2;
+            return Level::Sse2;
+        }
+        // outside the levels: every x64 cpu has SSE2, nearly every one SSSE3
+        inline bool DetectSsse3()
+        {
+            int info[4]{};
+            CpuId(info, 1, 0);
+            return info[2] & (1 << 9);
+        }
+#else
+        inline Level Detect() { return Level::Scalar; }
+        inline bool DetectSsse3() { return false; }
+#endif
+
+        // b == nullptr adds the 4 byte pattern to every pixel instead of a second row
+        inline void AddSaturateScalar(const uint8_t *a, const uint8_t *b, const uint32_t pattern,
+                                      uint8_t *dst, const size_t n)
+        {
+            const uint8_t color[4] = {static_cast<uint8_t>(pattern), static_cast<uint8_t>(pattern >> 8),
+                                      static_cast<uint8_t>(pattern >> 16), static_cast<uint8_t>(pattern >> 24)};
+            for (size_t i = 0; i < n; ++i)
+            {
+                const auto v = a[i] + (b ? b[i] : color[i & 3]);
+                dst[i] = static_cast<uint8_t>(v > 255 ? 255 : v);
+            }
+        }
+
+        // Branch-free forms of Image::RgbToHsl / HslToRgb. The hue of a grey pixel is 0,
+        // on ties the first maximum of r, g, b picks the sector like max_element does.
+        // HslToRgb uses f(n) = l - a * max(-1, min(k - 3, 9 - k, 1)), k = (n + h / 30) mod 12,
+        // a = s * min(l, 1 - l), which is the sector table of the scalar version.
+
+        inline void RgbToHslScalar(const float *r, const float *g, const float *b,
+                                   float *h, float *s, float *l, const size_t n)
+        {
+            for (size_t i = 0; i < n; ++i)
+            {
+                const auto cMax = std::max(r[i], std::max(g[i], b[i]));
+                const auto cMin = std::min(r[i], std::min(g[i], b[i]));
+                const auto d = cMax - cMin;
+                const auto inv = d > 0.f ? 1.f / d : 0.f;
+
+                auto hr = (g[i] - b[i]) * inv;
+                hr = hr < 0.f ? hr + 6.f : hr;
+                const auto hg = (b[i] - r[i]) * inv + 2.f;
+                const auto hb = (r[i] - g[i]) * inv + 4.f;
+                const auto hh = r[i] == cMax ? hr : g[i] == cMax ? hg : hb;
+
+                const auto ll = (cMax + cMin) * .5f;
+                const auto den = 1.f - std::abs(2.f * ll - 1.f);
+                h[i] = d > 0.f ? hh * 60.f : 0.f;
+                s[i] = d > 0.f ? d / den : 0.f;
+                l[i] = ll;
+            }
+        }
+
+        inline void HslToRgbScalar(const float *h, const float *s, const float *l,
+                                   float *r, float *g, float *b, const size_t n)
+        {
+            for (size_t i = 0; i < n; ++i)
+            {
+                const auto a = s[i] * std::min(l[i], 1.f - l[i]);
+                const auto h30 = h[i] / 30.f;
+                const auto f = [&](const float off)
+                {
+                    auto k = off + h30;
+                    k = k >= 12.f ? k - 12.f : k;
+                    return l[i] - a * std::max(-1.f, std::min({k - 3.f, 9.f - k, 1.f}));
+                };
+                r[i] = f(0.f);
+                g[i] = f(8.f);
+                b[i] = f(4.f);
+            }
+        }
+
+        inline void PackNormalsScalar(const float *dx, const float *dy, const float dz,
+                                      const uint8_t *src, uint8_t *dst, const size_t n)
+        {
+            const auto cvt = [](const float v)
+            { return static_cast<uint8_t>(std::clamp(std::round(v * 127.5f + 127.5f), 0.f, 255.f)); };
+            for (size_t i = 0; i < n; ++i, src += 4, dst += 4)
+            {
+                const auto inv = 1.f / std::sqrt(dx[i] * dx[i] + dy[i] * dy[i] + dz * dz);
+                dst[0] = cvt(dx[i] * inv);
+                dst[1] = cvt(dy[i] * inv);
+                dst[2] = cvt(dz * inv);
+                dst[3] = src[3];
+            }
+        }
+
+        inline void AxpyScalar(float *acc, const float *x, const float w, const size_t n)
+        {
+            for (size_t i = 0; i < n; ++i)
+                acc[i] += w * x[i];
+        }
+
+        inline void ChannelToFloatScalar(const uint8_t *px, const int channel, const float scale, float *out, const size_t n)
+        {
+            for (size_t i = 0; i < n; ++i)
+                out[i] = static_cast<float>(px[i * 4 + channel]) * scale;
+        }
+
+        inline void RgbaToYCbCrScalar(const uint8_t *px, const size_t n, float *y, float *cb, float *cr)
+        {
+            for (size_t i = 0; i < n; ++i)
+            {
+                const float r = px[i * 4], g = px[i * 4 + 1], b = px[i * 4 + 2];
+                y[i] = .299f * r + .587f * g + .114f * b - 128.f;
+                cb[i] = -.168736f * r - .331264f * g + .5f * b;
+                cr[i] = .5f * r - .418688f * g - .081312f * b;
+            }
+        }
+
+        inline void FilterRowsScalar(const uint8_t *src, const size_t stride, const float *weights, const int taps,
+                                     float *dst, const size_t n)
+        {
+            for (size_t i = 0; i < n; ++i)
+            {
+                float acc = 0;
+                for (int k = 0; k < taps; ++k)
+                    acc += weights[k] * static_cast<float>(src[k * stride + i]);
+                dst[i] = acc;
+            }
+        }
+
+        inline void ResampleRowScalar(const float *src, const int32_t *start, const float *weights, const int taps,
+                                      uint8_t *dst, const size_t n)
+        {
+            for (size_t x = 0; x < n; ++x, dst += 4)
+            {
+                const auto s = src + static_cast<size_t>(start[x]) * 4;
+                const auto w = weights + x * taps;
+                float acc[4]{};
+                for (int k = 0; k < taps; ++k)
+                    for (int c = 0; c < 4; ++c)
+                        acc[c] += w[k] * s[k * 4 + c];
+                for (int c = 0; c < 4; ++c)
+                    dst[c] = static_cast<uint8_t>(std::clamp(std::nearbyint(acc[c]), 0.f, 255.f));
+            }
+        }
+
+        // Fixed point resampling: weights are 2.14 and come in pairs packed into an
+        // int32 (low half first) for pmaddwd, an odd tap count pairs the last tap with
+        // a zero weight. The vertical pass leaves 9.6 fixed point in int16.
+        inline void FilterRowsFixedScalar(const uint8_t *src, const size_t stride, const int32_t *pairs, const int taps,
+                                          int16_t *dst, const size_t n)
+        {
+            for (size_t i = 0; i < n; ++i)
+            {
+                int32_t acc = 0;
+                for (int k = 0; k < taps; ++k)
+                    acc += static_cast<int16_t>(pairs[k / 2] >> (k & 1) * 16) * src[k * stride + i];
+                dst[i] = static_cast<int16_t>(std::clamp((acc + (1 << 7)) >> 8, -32768, 32767));
+            }
+        }
+
+        inline void ResampleRowFixedScalar(const int16_t *src, const int32_t *start, const int32_t *pairs, const int taps,
+                                           uint8_t *dst, const size_t n)
+        {
+            const auto stride = (taps + 1) / 2;
+            for (size_t x = 0; x < n; ++x, dst += 4)
+            {
+                const auto s = src + static_cast<size_t>(start[x]) * 4;
+                const auto w = pairs + x * stride;
+                int32_t acc[4]{};
+                for (int k = 0; k < taps; ++k)
+                    for (int c = 0; c < 4; ++c)
+                        acc[c] += static_cast<int16_t>(w[k / 2] >> (k & 1) * 16) * s[k * 4 + c];
+                for (int c = 0; c < 4; ++c)
+                    dst[c] = static_cast<uint8_t>(std::clamp((acc[c] + (1 << 19)) >> 20, 0, 255));
+            }
+        }
+
+        // 2x2 box: each output pixel is the rounded mean of a 2x2 block of a and b
+        inline void HalveScalar(const uint8_t *a, const uint8_t *b, uint8_t *dst, const size_t n)
+        {
+            for (size_t x = 0; x < n; ++x, a += 8, b += 8, dst += 4)
+                for (int c = 0; c < 4; ++c)
+                    dst[c] = static_cast<uint8_t>((a[c] + a[c + 4] + b[c] + b[c + 4] + 2) >> 2);
+        }
+
+        // index of the closest of n RGBA palette entries for each of 16 RGBA pixels by
+        // squared distance, ties go to the lower index; returns the summed error
+        inline uint32_t NearestPaletteScalar(const uint8_t *px, const uint8_t *palette, const int n, uint8_t idx[16])
+        {
+            uint32_t total = 0;
+            for (int i = 0; i < 16; ++i, px += 4)
+            {
+                uint32_t best = UINT32_MAX;
+                for (int j = 0; j < n; ++j)
+                {
+                    uint32_t err = 0;
+                    for (int c = 0; c < 4; ++c)
+                    {
+                        const auto d = px[c] - palette[j * 4 + c];
+                        err += static_cast<uint32_t>(d * d);
+                    }
+                    if (err < best)
+                    {
+                        best = err;
+                        idx[i] = static_cast<uint8_t>(j);
+                    }
+                }
+                total += best;
+            }
+            return total;
+        }
+
+        // the same for 16 single channel values against n levels
+        inline uint32_t NearestLevelScalar(const uint8_t *v, const uint8_t *levels, const int n, uint8_t idx[16])
+        {
+            uint32_t total = 0;
+            for (int i = 0; i < 16; ++i)
+            {
+                int best = INT32_MAX;
+                for (int j = 0; j < n; ++j)
+                {
+                    const auto d = std::abs(v[i] - levels[j]);
+                    if (d < best)
+                    {
+                        best = d;
+                        idx[i] = static_cast<uint8_t>(j);
+                    }
+                }
+                total += static_cast<uint32_t>(best * best);
+            }
+            return total;
+        }
+
+        inline uint8_t PaethPredictor(const int a, const int b, const int c)
+        {
+            const auto pa = std::abs(b - c), pb = std::abs(a - c), pc = std::abs(a + b - 2 * c);
+            return static_cast<uint8_t>(pa <= pb && pa <= pc ? a : pb <= pc ? b : c);
+        }
+
+        // from byte `start` on, the first bpp bytes have no left neighbour
+        inline void PaethFilterScalar(const uint8_t *row, const uint8_t *prior, const size_t start, const size_t n,
+                                      const size_t bpp, uint8_t *dst)
+        {
+            for (size_t i = start; i < n; ++i)
+            {
+                const int a = i >= bpp ? row[i - bpp] : 0;
+                const int c = i >= bpp ? prior[i - bpp] : 0;
+                dst[i] = static_cast<uint8_t>(row[i] - PaethPredictor(a, prior[i], c));
+            }
+        }
+
+        inline uint64_t SumAbsSignedScalar(const uint8_t *v, const size_t n)
+        {
+            uint64_t sum = 0;
+            for (size_t i = 0; i < n; ++i)
+                sum += static_cast<uint64_t>(std::abs(static_cast<int8_t>(v[i])));
+            return sum;
+        }
+
+        // transposed orthonormal 8 point DCT-II basis: DctBasisT()[n * 8 + k] is basis k at sample n
+        inline const float *DctBasisT()
+        {
+            static const auto basis = []
+            {
+                std::array<float, 64> m{};
+                for (int k = 0; k < 8; ++k)
+                    for (int n = 0; n < 8; ++n)
+                        m[n * 8 + k] = static_cast<float>((k == 0 ? std::sqrt(1. / 8) : .5) *
+                                                          std::cos((2 * n + 1) * k * 3.14159265358979323846 / 16));
+                return m;
+            }();
+            return basis.data();
+        }
+
+        // Y = C X C^T as two passes of the same row product: each pass multiplies the
+        // rows by C^T and writes the result transposed
+        inline void ForwardDctQuantizeScalar(const float *in, const float *scale, int16_t *out)
+        {
+            const auto ct = DctBasisT();
+            float t[64], y[64];
+            for (int i = 0; i < 8; ++i)
+                for (int k = 0; k < 8; ++k)
+                {
+                    float acc = 0;
+                    for (int n = 0; n < 8; ++n)
+                        acc += in[i * 8 + n] * ct[n * 8 + k];
+                    t[k * 8 + i] = acc;
+                }
+            for (int i = 0; i < 8; ++i)
+                for (int k = 0; k < 8; ++k)
+                {
+                    float acc = 0;
+                    for (int n = 0; n < 8; ++n)
+                        acc += t[i * 8 + n] * ct[n * 8 + k];
+                    y[k * 8 + i] = acc;
+                }
+            for (int i = 0; i < 64; ++i)
+                out[i] = static_cast<int16_t>(std::lrint(y[i] * scale[i]));
+        }
+
+        // order[c] is the source byte of output channel c inside a pixel, >= 4 gives 0;
+        // fill is or'ed into every pixel afterwards
+        inline void SwizzleScalar(const uint8_t *src, const uint8_t order[4], const uint32_t fill,
+                                  uint8_t *dst, const size_t n)
+        {
+            for (size_t i = 0; i < n; ++i, src += 4, dst += 4)
+            {
+                uint8_t px[4];
+                for (int c = 0; c < 4; ++c)
+                    px[c] = static_cast<uint8_t>((order[c] < 4 ? src[order[c]] : 0) | fill >> c * 8);
+                std::copy_n(px, 4, dst);
+            }
+        }
+
+#ifdef __SIMD_X64__
+        inline void AddSaturateSse2(const uint8_t *a, const uint8_t *b, const uint32_t pattern,
+                                    uint8_t *dst, const size_t n)
+        {
+            size_t i = 0;
+            if (b)
+            {
+                for (; i + 16 <= n; i += 16)
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+                                     _mm_adds_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i)),
+                                                   _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i))));
+            }
+            else
+            {
+                const auto y = _mm_set1_epi32(static_cast<int>(pattern));
+                for (; i + 16 <= n; i += 16)
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+                                     _mm_adds_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i)), y));
+            }
+            AddSaturateScalar(a + i, b ? b + i : nullptr, pattern, dst + i, n - i);
+        }
+
+        __SIMD_TARGET__("avx2")
+        inline void AddSaturateAvx2(const uint8_t *a, const uint8_t *b, const uint32_t pattern,
+                                    uint8_t *dst, const size_t n)
+        {
+            size_t i = 0;
+            if (b)
+            {
+                for (; i + 32 <= n; i += 32)
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i),
+                                        _mm256_adds_epu8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i)),
+                                                         _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i))));
+            }
+            else
+            {
+                const auto y = _mm256_set1_epi32(static_cast<int>(pattern));
+                for (; i + 32 <= n; i += 32)
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i),
+                                        _mm256_adds_epu8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i)), y));
+            }
+            AddSaturateSse2(a + i, b ? b + i : nullptr, pattern, dst + i, n - i);
+        }
+
+        __SIMD_TARGET__("avx512f,avx512bw")
+        inline void AddSaturateAvx512(const uint8_t *a, const uint8_t *b, const uint32_t pattern,
+                                      uint8_t *dst, const size_t n)
+        {
+            size_t i = 0;
+            if (b)
+            {
+                for (; i + 64 <= n; i += 64)
+                    _mm512_storeu_si512(dst + i, _mm512_adds_epu8(_mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i)));
+            }
+            else
+            {
+                const auto y = _mm512_set1_epi32(static_cast<int>(pattern));
+                for (; i + 64 <= n; i += 64)
+                    _mm512_storeu_si512(dst + i, _mm512_adds_epu8(_mm512_loadu_si512(a + i), y));
+            }
+            AddSaturateAvx2(a + i, b ? b + i : nullptr, pattern, dst + i, n - i);
+        }
+
+        inline void RgbToHslSse2(const float *r, const float *g, const float *b,
+                                 float *h, float *s, float *l, const size_t n)
+        {
+            const auto zero = _mm_setzero_ps();
+            const auto one = _mm_set1_ps(1.f);
+            const auto absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+            const auto sel = [](const __m128 m, const __m128 x, const __m128 y)
+            { return _mm_or_ps(_mm_and_ps(m, x), _mm_andnot_ps(m, y)); };
+
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4)
+            {
+                const auto vr = _mm_loadu_ps(r + i), vg = _mm_loadu_ps(g + i), vb = _mm_loadu_ps(b + i);
+                const auto cMax = _mm_max_ps(vr, _mm_max_ps(vg, vb));
+                const auto cMin = _mm_min_ps(vr, _mm_min_ps(vg, vb));
+                const auto d = _mm_sub_ps(cMax, cMin);
+                const auto grey = _mm_cmple_ps(d, zero);
+                const auto inv = _mm_andnot_ps(grey, _mm_div_ps(one, sel(grey, one, d)));
+
+                auto hr = _mm_mul_ps(_mm_sub_ps(vg, vb), inv);
+                hr = _mm_add_ps(hr, _mm_and_ps(_mm_cmplt_ps(hr, zero), _mm_set1_ps(6.f)));
+                const auto hg = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(vb, vr), inv), _mm_set1_ps(2.f));
+                const auto hb = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(vr, vg), inv), _mm_set1_ps(4.f));
+                const auto hh = sel(_mm_cmpeq_ps(vr, cMax), hr, sel(_mm_cmpeq_ps(vg, cMax), hg, hb));
+
+                const auto ll = _mm_mul_ps(_mm_add_ps(cMax, cMin), _mm_set1_ps(.5f));
+                const auto den = _mm_sub_ps(one, _mm_and_ps(absMask, _mm_sub_ps(_mm_add_ps(ll, ll), one)));
+
+                _mm_storeu_ps(h + i, _mm_andnot_ps(grey, _mm_mul_ps(hh, _mm_set1_ps(60.f))));
+                _mm_storeu_ps(s + i, _mm_andnot_ps(grey, _mm_div_ps(d, sel(grey, one, den))));
+                _mm_storeu_ps(l + i, ll);
+            }
+            RgbToHslScalar(r + i, g + i, b + i, h + i, s + i, l + i, n - i);
+        }
+
+        inline void HslToRgbSse2(const float *h, const float *s, const float *l,
+                                 float *r, float *g, float *b, const size_t n)
+        {
+            const auto one = _mm_set1_ps(1.f);
+            const auto twelve = _mm_set1_ps(12.f);
+
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4)
+            {
+                const auto vh = _mm_loadu_ps(h + i), vs = _mm_loadu_ps(s + i), vl = _mm_loadu_ps(l + i);
+                const auto a = _mm_mul_ps(vs, _mm_min_ps(vl, _mm_sub_ps(one, vl)));
+                const auto h30 = _mm_div_ps(vh, _mm_set1_ps(30.f));
+                const auto f = [&](const float off)
+                {
+                    auto k = _mm_add_ps(_mm_set1_ps(off), h30);
+                    k = _mm_sub_ps(k, _mm_and_ps(_mm_cmpge_ps(k, twelve), twelve));
+                    const auto t = _mm_min_ps(_mm_min_ps(_mm_sub_ps(k, _mm_set1_ps(3.f)),
+                                                         _mm_sub_ps(_mm_set1_ps(9.f), k)),
+                                              one);
+                    return _mm_sub_ps(vl, _mm_mul_ps(a, _mm_max_ps(_mm_set1_ps(-1.f), t)));
+                };
+                _mm_storeu_ps(r + i, f(0.f));
+                _mm_storeu_ps(g + i, f(8.f));
+                _mm_storeu_ps(b + i, f(4.f));
+            }
+            HslToRgbScalar(h + i, s + i, l + i, r + i, g + i, b + i, n - i);
+        }
+
+        __SIMD_TARGET__("avx2")
+        inline void RgbToHslAvx2(const float *r, const float *g, const float *b,
+                                 float *h, float *s, float *l, const size_t n)
+        {
+            const auto zero = _mm256_setzero_ps();
+            const auto one = _mm256_set1_ps(1.f);
+            const auto absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8)
+            {
+                const auto vr = _mm256_loadu_ps(r + i), vg = _mm256_loadu_ps(g + i), vb = _mm256_loadu_ps(b + i);
+                const auto cMax = _mm256_max_ps(vr, _mm256_max_ps(vg, vb));
+                const auto cMin = _mm256_min_ps(vr, _mm256_min_ps(vg, vb));
+                const auto d = _mm256_sub_ps(cMax, cMin);
+                const auto grey = _mm256_cmp_ps(d, zero, _CMP_LE_OQ);
+                const auto inv = _mm256_andnot_ps(grey, _mm256_div_ps(one, _mm256_blendv_ps(d, one, grey)));
+
+                auto hr = _mm256_mul_ps(_mm256_sub_ps(vg, vb), inv);
+                hr = _mm256_add_ps(hr, _mm256_and_ps(_mm256_cmp_ps(hr, zero, _CMP_LT_OQ), _mm256_set1_ps(6.f)));
+                const auto hg = _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(vb, vr), inv), _mm256_set1_ps(2.f));
+                const auto hb = _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(vr, vg), inv), _mm256_set1_ps(4.f));
+                const auto hh = _mm256_blendv_ps(_mm256_blendv_ps(hb, hg, _mm256_cmp_ps(vg, cMax, _CMP_EQ_OQ)),
+                                                 hr, _mm256_cmp_ps(vr, cMax, _CMP_EQ_OQ));
+
+                const auto ll = _mm256_mul_ps(_mm256_add_ps(cMax, cMin), _mm256_set1_ps(.5f));
+                const auto den = _mm256_sub_ps(one, _mm256_and_ps(absMask, _mm256_sub_ps(_mm256_add_ps(ll, ll), one)));
+
+                _mm256_storeu_ps(h + i, _mm256_andnot_ps(grey, _mm256_mul_ps(hh, _mm256_set1_ps(60.f))));
+                _mm256_storeu_ps(s + i, _mm256_andnot_ps(grey, _mm256_div_ps(d, _mm256_blendv_ps(den, one, grey))));
+                _mm256_storeu_ps(l + i, ll);
+            }
+            RgbToHslSse2(r + i, g + i, b + i, h + i, s + i, l + i, n - i);
+        }
+
+        __SIMD_TARGET__("avx2")
+        inline void HslToRgbAvx2(const float *h, const float *s, const float *l,
+                                 float *r, float *g, float *b, const size_t n)
+        {
+            const auto one = _mm256_set1_ps(1.f);
+            const auto twelve = _mm256_set1_ps(12.f);
+
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8)
+            {
+                const auto vh = _mm256_loadu_ps(h + i), vs = _mm256_loadu_ps(s + i), vl = _mm256_loadu_ps(l + i);
+                const auto a = _mm256_mul_ps(vs, _mm256_min_ps(vl, _mm256_sub_ps(one, vl)));
+                const auto h30 = _mm256_div_ps(vh, _mm256_set1_ps(30.f));
+                __m256 out[3];
+                constexpr float offs[3] = {0.f, 8.f, 4.f};
+                for (int c = 0; c < 3; ++c)
+                {
+                    auto k = _mm256_add_ps(_mm256_set1_ps(offs[c]), h30);
+                    k = _mm256_sub_ps(k, _mm256_and_ps(_mm256_cmp_ps(k, twelve, _CMP_GE_OQ), twelve));
+                    const auto t = _mm256_min_ps(_mm256_min_ps(_mm256_sub_ps(k, _mm256_set1_ps(3.f)),
+                                                               _mm256_sub_ps(_mm256_set1_ps(9.f), k)),
+                                                 one);
+                    out[c] = _mm256_sub_ps(vl, _mm256_mul_ps(a, _mm256_max_ps(_mm256_set1_ps(-1.f), t)));
+                }
+                _mm256_storeu_ps(r + i, out[0]);
+                _mm256_storeu_ps(g + i, out[1]);
+                _mm256_storeu_ps(b + i, out[2]);
+            }
+            HslToRgbSse2(h + i, s + i, l + i, r + i, g + i, b + i, n - i);
+        }
+
+        // rsqrt refined by one Newton step, ~23 bits, plenty for 8-bit output
+        inline void PackNormalsSse2(const float *dx, const float *dy, const float dz,
+                                    const uint8_t *src, uint8_t *dst, const size_t n)
+        {
+            const auto vz = _mm_set1_ps(dz);
+            const auto zz = _mm_set1_ps(dz * dz);
+            const auto half = _mm_set1_ps(.5f), threeHalves = _mm_set1_ps(1.5f);
+            const auto scale = _mm_set1_ps(127.5f);
+            const auto alpha = _mm_set1_epi32(static_cast<int>(0xff000000));
+
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4)
+            {
+                const auto x = _mm_loadu_ps(dx + i), y = _mm_loadu_ps(dy + i);
+                const auto len2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), zz);
+                auto inv = _mm_rsqrt_ps(len2);
+                inv = _mm_mul_ps(inv, _mm_sub_ps(threeHalves, _mm_mul_ps(_mm_mul_ps(half, len2), _mm_mul_ps(inv, inv))));
+
+                const auto s = _mm_mul_ps(inv, scale);
+                const auto r = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(x, s), scale));
+                const auto g = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(y, s), scale));
+                const auto b = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(vz, s), scale));
+
+                const auto a = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4)), alpha);
+                const auto px = _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)), _mm_or_si128(_mm_slli_epi32(b, 16), a));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 4), px);
+            }
+            PackNormalsScalar(dx + i, dy + i, dz, src + i * 4, dst + i * 4, n - i);
+        }
+
+        __SIMD_TARGET__("avx2,fma")
+        inline void PackNormalsAvx2(const float *dx, const float *dy, const float dz,
+                                    const uint8_t *src, uint8_t *dst, const size_t n)
+        {
+            const auto vz = _mm256_set1_ps(dz);
+            const auto zz = _mm256_set1_ps(dz * dz);
+            const auto half = _mm256_set1_ps(.5f), threeHalves = _mm256_set1_ps(1.5f);
+            const auto scale = _mm256_set1_ps(127.5f);
+            const auto alpha = _mm256_set1_epi32(static_cast<int>(0xff000000));
+
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8)
+            {
+                const auto x = _mm256_loadu_ps(dx + i), y = _mm256_loadu_ps(dy + i);
+                const auto len2 = _mm256_fmadd_ps(x, x, _mm256_fmadd_ps(y, y, zz));
+                auto inv = _mm256_rsqrt_ps(len2);
+                inv = _mm256_mul_ps(inv, _mm256_fnmadd_ps(_mm256_mul_ps(half, len2), _mm256_mul_ps(inv, inv), threeHalves));
+
+                const auto s = _mm256_mul_ps(inv, scale);
+                const auto r = _mm256_cvtps_epi32(_mm256_fmadd_ps(x, s, scale));
+                const auto g = _mm256_cvtps_epi32(_mm256_fmadd_ps(y, s, scale));
+                const auto b = _mm256_cvtps_epi32(_mm256_fmadd_ps(vz, s, scale));
+
+                const auto a = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i * 4)), alpha);
+                const auto px = _mm256_or_si256(_mm256_or_si256(r, _mm256_slli_epi32(g, 8)), _mm256_or_si256(_mm256_slli_epi32(b, 16), a));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i * 4), px);
+            }
+            PackNormalsSse2(dx + i, dy + i, dz, src + i * 4, dst + i * 4, n - i);
+        }
+
+        inline void AxpySse2(float *acc, const float *x, const float w, const size_t n)
+        {
+            const auto vw = _mm_set1_ps(w);
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4)
+                _mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), _mm_mul_ps(vw, _mm_loadu_ps(x + i))));
+            AxpyScalar(acc + i, x + i, w, n - i);
+        }
+
+        __SIMD_TARGET__("avx2,fma")
+        inline void AxpyAvx2(float *acc, const float *x, const float w, const size_t n)
+        {
+            const auto vw = _mm256_set1_ps(w);
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8)
+                _mm256_storeu_ps(acc + i, _mm256_fmadd_ps(vw, _mm256_loadu_ps(x + i), _mm256_loadu_ps(acc + i)));
+            AxpySse2(acc + i, x + i, w, n - i);
+        }
+
+        inline void ChannelToFloatSse2(const uint8_t *px, const int channel, const float scale, float *out, const size_t n)
+        {
+            const auto mask = _mm_set1_epi32(0xff);
+            const auto shift = _mm_cvtsi32_si128(channel * 8);
+            const auto vs = _mm_set1_ps(scale);
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4)
+            {
+                const auto v = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(px + i * 4)), shift), mask);
+                _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(v), vs));
+            }
+            ChannelToFloatScalar(px + i * 4, channel, scale, out + i, n - i);
+        }
+
+        __SIMD_TARGET__("avx2,fma")
+        inline void ChannelToFloatAvx2(const uint8_t *px, const int channel, const float scale, float *out, const size_t n)
+        {
+            const auto mask = _mm256_set1_epi32(0xff);
+            const auto shift = _mm_cvtsi32_si128(channel * 8);
+            const auto vs = _mm256_set1_ps(scale);
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8)
+            {
+                const auto v = _mm256_and_si256(_mm256_srl_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(px + i * 4)), shift), mask);
+                _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), vs));
+            }
+            ChannelToFloatSse2(px + i * 4, channel, scale, out + i, n - i);
+        }
+
+        inline void RgbaToYCbCrSse2(const uint8_t *px, const size_t n, float *y, float *cb, float *cr)
+        {
+            const auto mask = _mm_set1_epi32(0xff);
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4)
+            {
+                const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(px + i * 4));
+                const auto r = _mm_cvtepi32_ps(_mm_and_si128(v, mask));
+                const auto g = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(v, 8), mask));
+                const auto b = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(v, 16), mask));
+                _mm_storeu_ps(y + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, _mm_set1_ps(.299f)), _mm_mul_ps(g, _mm_set1_ps(.587f))),
+                                                _mm_add_ps(_mm_mul_ps(b, _mm_set1_ps(.114f)), _mm_set1_ps(-128.f))));
+                _mm_storeu_ps(cb + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, _mm_set1_ps(-.168736f)), _mm_mul_ps(g, _mm_set1_ps(-.331264f))),
+                                                 _mm_mul_ps(b, _mm_set1_ps(.5f))));
+                _mm_storeu_ps(cr + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, _mm_set1_ps(.5f)), _mm_mul_ps(g, _mm_set1_ps(-.418688f))),
+                                                 _mm_mul_ps(b, _mm_set1_ps(-.081312f))));
+            }
+            RgbaToYCbCrScalar(px + i * 4, n - i, y + i, cb + i, cr + i);
+        }
+
+        __SIMD_TARGET__("avx2,fma")
+        inline void RgbaToYCbCrAvx2(const uint8_t *px, const size_t n, float *y, float *cb, float *cr)
+        {
+            const auto mask = _mm256_set1_epi32(0xff);
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8)
+            {
+                const auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(px + i * 4));
+                const auto r = _mm256_cvtepi32_ps(_mm256_and_si256(v, mask));
+                const auto g = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(v, 8), mask));
+                const auto b = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(v, 16), mask));
+                _mm256_storeu_ps(y + i, _mm256_fmadd_ps(r, _mm256_set1_ps(.299f),
+                                                        _mm256_fmadd_ps(g, _mm256_set1_ps(.587f),
+                                                                        _mm256_fmadd_ps(b, _mm256_set1_ps(.114f), _mm256_set1_ps(-128.f)))));
+                _mm256_storeu_ps(cb + i, _mm256_fmadd_ps(r, _mm256_set1_ps(-.168736f),
+                                                         _mm256_fmadd_ps(g, _mm256_set1_ps(-.331264f),
+                                                                         _mm256_mul_ps(b, _mm256_set1_ps(.5f)))));
+                _mm256_storeu_ps(cr + i, _mm256_fmadd_ps(r, _mm256_set1_ps(.5f),
+                                                         _mm256_fmadd_ps(g, _mm256_set1_ps(-.418688f),
+                                                                         _mm256_mul_ps(b, _mm256_set1_ps(-.081312f)))));
+            }
+            RgbaToYCbCrSse2(px + i * 4, n - i, y + i, cb + i, cr + i);
+        }
+
+        // 16 bytes of every row at a time, the sums stay in registers over all taps
+        inline void FilterRowsSse2(const uint8_t *src, const size_t stride, const float *weights, const int taps,
+                                   float *dst, const size_t n)
+        {
+            const auto zero = _mm_setzero_si128();
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16)
+            {
+                __m128 acc[4] = {_mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps()};
+                for (int k = 0; k < taps; ++k)
+                {
+                    const auto w = _mm_set1_ps(weights[k]);
+                    const auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + k * stride + i));
+                    const auto lo = _mm_unpacklo_epi8(b, zero), hi = _mm_unpackhi_epi8(b, zero);
+                    acc[0] = _mm_add_ps(acc[0], _mm_mul_ps(w, _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero))));
+                    acc[1] = _mm_add_ps(acc[1], _mm_mul_ps(w, _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero))));
+                    acc[2] = _mm_add_ps(acc[2], _mm_mul_ps(w, _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero))));
+                    acc[3] = _mm_add_ps(acc[3], _mm_mul_ps(w, _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero))));
+                }
+                for (int j = 0; j < 4; ++j)
+                    _mm_storeu_ps(dst + i + j * 4, acc[j]);
+            }
+            FilterRowsScalar(src + i, stride, weights, taps, dst + i, n - i);
+        }
+
+        __SIMD_TARGET__("avx2,fma")
+        inline void FilterRowsAvx2(const uint8_t *src, const size_t stride, const float *weights, const int taps,
+                                   float *dst, const size_t n)
+        {
+            size_t i = 0;
+            for (; i + 32 <= n; i += 32)
+            {
+                __m256 acc[4] = {_mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps()};
+                for (int k = 0; k < taps; ++k)
+                {
+                    const auto w = _mm256_set1_ps(weights[k]);
+                    const auto p = src + k * stride + i;
+                    for (int j = 0; j < 4; ++j)
+                    {
+                        const auto b = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(p + j * 8));
+                        acc[j] = _mm256_fmadd_ps(w, _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(b)), acc[j]);
+                    }
+                }
+                for (int j = 0; j < 4; ++j)
+                    _mm256_storeu_ps(dst + i + j * 8, acc[j]);
+            }
+            FilterRowsSse2(src + i, stride, weights, taps, dst + i, n - i);
+        }
+
+        // one RGBA pixel is one xmm: broadcast the weight, accumulate, round and saturate to bytes
+        inline void ResampleRowSse2(const float *src, const int32_t *start, const float *weights, const int taps,
+                                    uint8_t *dst, const size_t n)
+        {
+            for (size_t x = 0; x < n; ++x)
+            {
+                const auto s = src + static_cast<size_t>(start[x]) * 4;
+                const auto w = weights + x * taps;
+                auto acc = _mm_setzero_ps();
+                for (int k = 0; k < taps; ++k)
+                    acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(w[k]), _mm_loadu_ps(s + k * 4)));
+                auto v = _mm_cvtps_epi32(acc);
+                v = _mm_packus_epi16(_mm_packs_epi32(v, v), v);
+                const auto px = _mm_cvtsi128_si32(v);
+                std::memcpy(dst + x * 4, &px, 4);
+            }
+        }
+
+        // two taps (two source pixels) per ymm, the halves are summed at the end
+        __SIMD_TARGET__("avx2,fma")
+        inline void ResampleRowAvx2(const float *src, const int32_t *start, const float *weights, const int taps,
+                                    uint8_t *dst, const size_t n)
+        {
+            const auto pair = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+            for (size_t x = 0; x < n; ++x)
+            {
+                const auto s = src + static_cast<size_t>(start[x]) * 4;
+                const auto w = weights + x * taps;
+                auto acc = _mm256_setzero_ps();
+                int k = 0;
+                for (; k + 2 <= taps; k += 2)
+                {
+                    const auto w2 = _mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(w + k)));
+                    acc = _mm256_fmadd_ps(_mm256_permutevar8x32_ps(_mm256_castps128_ps256(w2), pair),
+                                          _mm256_loadu_ps(s + k * 4), acc);
+                }
+                auto sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+                if (k < taps)
+                    sum = _mm_fmadd_ps(_mm_set1_ps(w[k]), _mm_loadu_ps(s + k * 4), sum);
+                auto v = _mm_cvtps_epi32(sum);
+                v = _mm_packus_epi16(_mm_packs_epi32(v, v), v);
+                const auto px = _mm_cvtsi128_si32(v);
+                std::memcpy(dst + x * 4, &px, 4);
+            }
+        }
+
+        // interleaving two rows byte by byte and widening gives (a, b) int16 pairs,
+        // one pmaddwd then applies two taps to every byte position
+        inline void FilterRowsFixedSse2(const uint8_t *src, const size_t stride, const int32_t *pairs, const int taps,
+                                        int16_t *dst, const size_t n)
+        {
+            const auto zero = _mm_setzero_si128();
+            const auto round = _mm_set1_epi32(1 << 7);
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16)
+            {
+                __m128i acc[4] = {zero, zero, zero, zero};
+                for (int k = 0; k < taps; k += 2)
+                {
+                    const auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + k * stride + i));
+                    const auto b = k + 1 < taps ? _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + (k + 1) * stride + i)) : a;
+                    const auto w = _mm_set1_epi32(pairs[k / 2]);
+                    const auto lo = _mm_unpacklo_epi8(a, b), hi = _mm_unpackhi_epi8(a, b);
+                    acc[0] = _mm_add_epi32(acc[0], _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), w));
+                    acc[1] = _mm_add_epi32(acc[1], _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), w));
+                    acc[2] = _mm_add_epi32(acc[2], _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), w));
+                    acc[3] = _mm_add_epi32(acc[3], _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), w));
+                }
+                for (auto &v : acc)
+                    v = _mm_srai_epi32(_mm_add_epi32(v, round), 8);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packs_epi32(acc[0], acc[1]));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i + 8), _mm_packs_epi32(acc[2], acc[3]));
+            }
+            FilterRowsFixedScalar(src + i, stride, pairs, taps, dst + i, n - i);
+        }
+
+        __SIMD_TARGET__("avx2")
+        inline void FilterRowsFixedAvx2(const uint8_t *src, const size_t stride, const int32_t *pairs, const int taps,
+                                        int16_t *dst, const size_t n)
+        {
+            const auto round = _mm256_set1_epi32(1 << 7);
+            size_t i = 0;
+            for (; i + 32 <= n; i += 32)
+            {
+                __m256i acc[4] = {_mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256()};
+                for (int k = 0; k < taps; k += 2)
+                {
+                    const auto pa = src + k * stride + i;
+                    const auto pb = k + 1 < taps ? pa + stride : pa;
+                    const auto w = _mm256_set1_epi32(pairs[k / 2]);
+                    for (int j = 0; j < 2; ++j)
+                    {
+                        const auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pa + j * 16));
+                        const auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pb + j * 16));
+                        acc[j * 2] = _mm256_add_epi32(acc[j * 2], _mm256_madd_epi16(_mm256_cvtepu8_epi16(_mm_unpacklo_epi8(a, b)), w));
+                        acc[j * 2 + 1] = _mm256_add_epi32(acc[j * 2 + 1], _mm256_madd_epi16(_mm256_cvtepu8_epi16(_mm_unpackhi_epi8(a, b)), w));
+                    }
+                }
+                for (auto &v : acc)
+                    v = _mm256_srai_epi32(_mm256_add_epi32(v, round), 8);
+                // packs works per lane, put the quadwords back in order
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i),
+                                    _mm256_permute4x64_epi64(_mm256_packs_epi32(acc[0], acc[1]), 0xd8));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i + 16),
+                                    _mm256_permute4x64_epi64(_mm256_packs_epi32(acc[2], acc[3]), 0xd8));
+            }
+            FilterRowsFixedSse2(src + i, stride, pairs, taps, dst + i, n - i);
+        }
+
+        // two int16 RGBA pixels unpacked against each other are (r0, r1, g0, g1, ...),
+        // so pmaddwd with a weight pair gives two taps of all four channels
+        inline void ResampleRowFixedSse2(const int16_t *src, const int32_t *start, const int32_t *pairs, const int taps,
+                                         uint8_t *dst, const size_t n)
+        {
+            const auto stride = (taps + 1) / 2;
+            const auto round = _mm_set1_epi32(1 << 19);
+            for (size_t x = 0; x < n; ++x)
+            {
+                const auto s = src + static_cast<size_t>(start[x]) * 4;
+                const auto w = pairs + x * stride;
+                auto acc = round;
+                for (int j = 0; j < stride; ++j)
+                {
+                    const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + j * 8));
+                    acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi16(v, _mm_srli_si128(v, 8)), _mm_set1_epi32(w[j])));
+                }
+                auto v = _mm_srai_epi32(acc, 20);
+                v = _mm_packus_epi16(_mm_packs_epi32(v, v), v);
+                const auto px = _mm_cvtsi128_si32(v);
+                std::memcpy(dst + x * 4, &px, 4);
+            }
+        }
+
+        // four taps per ymm, one weight pair per lane
+        __SIMD_TARGET__("avx2")
+        inline void ResampleRowFixedAvx2(const int16_t *src, const int32_t *start, const int32_t *pairs, const int taps,
+                                         uint8_t *dst, const size_t n)
+        {
+            const auto stride = (taps + 1) / 2;
+            const auto lanes = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+            for (size_t x = 0; x < n; ++x)
+            {
+                const auto s = src + static_cast<size_t>(start[x]) * 4;
+                const auto w = pairs + x * stride;
+                auto acc = _mm256_setzero_si256();
+                int j = 0;
+                for (; j + 2 <= stride; j += 2)
+                {
+                    const auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + j * 8));
+                    const auto w2 = _mm256_permutevar8x32_epi32(
+                        _mm256_castsi128_si256(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(w + j))), lanes);
+                    acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_unpacklo_epi16(v, _mm256_srli_si256(v, 8)), w2));
+                }
+                auto sum = _mm_add_epi32(_mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1)),
+                                         _mm_set1_epi32(1 << 19));
+                if (j < stride)
+                {
+                    const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + j * 8));
+                    sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpacklo_epi16(v, _mm_srli_si128(v, 8)), _mm_set1_epi32(w[j])));
+                }
+                auto v = _mm_srai_epi32(sum, 20);
+                v = _mm_packus_epi16(_mm_packs_epi32(v, v), v);
+                const auto px = _mm_cvtsi128_si32(v);
+                std::memcpy(dst + x * 4, &px, 4);
+            }
+        }
+
+        // rows are summed as int16, then the two pixels of a pair sit in the low and
+        // high quadwords and one more add finishes the block
+        inline void HalveSse2(const uint8_t *a, const uint8_t *b, uint8_t *dst, const size_t n)
+        {
+            const auto zero = _mm_setzero_si128();
+            const auto two = _mm_set1_epi16(2);
+            size_t x = 0;
+            for (; x + 4 <= n; x += 4)
+            {
+                __m128i sums[4];
+                for (int j = 0; j < 2; ++j)
+                {
+                    const auto va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + x * 8 + j * 16));
+                    const auto vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + x * 8 + j * 16));
+                    sums[j * 2] = _mm_add_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero));
+                    sums[j * 2 + 1] = _mm_add_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero));
+                }
+                const auto lo = _mm_add_epi16(_mm_unpacklo_epi64(sums[0], sums[1]), _mm_unpackhi_epi64(sums[0], sums[1]));
+                const auto hi = _mm_add_epi16(_mm_unpacklo_epi64(sums[2], sums[3]), _mm_unpackhi_epi64(sums[2], sums[3]));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 4),
+                                 _mm_packus_epi16(_mm_srli_epi16(_mm_add_epi16(lo, two), 2),
+                                                  _mm_srli_epi16(_mm_add_epi16(hi, two), 2)));
+            }
+            HalveScalar(a + x * 8, b + x * 8, dst + x * 4, n - x);
+        }
+
+        __SIMD_TARGET__("avx2")
+        inline void HalveAvx2(const uint8_t *a, const uint8_t *b, uint8_t *dst, const size_t n)
+        {
+            const auto zero = _mm256_setzero_si256();
+            const auto two = _mm256_set1_epi16(2);
+            size_t x = 0;
+            for (; x + 8 <= n; x += 8)
+            {
+                __m256i sums[4];
+                for (int j = 0; j < 2; ++j)
+                {
+                    const auto va = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + x * 8 + j * 32));
+                    const auto vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + x * 8 + j * 32));
+                    sums[j * 2] = _mm256_add_epi16(_mm256_unpacklo_epi8(va, zero), _mm256_unpacklo_epi8(vb, zero));
+                    sums[j * 2 + 1] = _mm256_add_epi16(_mm256_unpackhi_epi8(va, zero), _mm256_unpackhi_epi8(vb, zero));
+                }
+                // per lane like the Sse2 version, the pack order is undone at the end
+                const auto lo = _mm256_add_epi16(_mm256_unpacklo_epi64(sums[0], sums[1]), _mm256_unpackhi_epi64(sums[0], sums[1]));
+                const auto hi = _mm256_add_epi16(_mm256_unpacklo_epi64(sums[2], sums[3]), _mm256_unpackhi_epi64(sums[2], sums[3]));
+                const auto px = _mm256_packus_epi16(_mm256_srli_epi16(_mm256_add_epi16(lo, two), 2),
+                                                    _mm256_srli_epi16(_mm256_add_epi16(hi, two), 2));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x * 4), _mm256_permute4x64_epi64(px, 0xd8));
+            }
+            HalveSse2(a + x * 8, b + x * 8, dst + x * 4, n - x);
+        }
+
+        // four pixels per step: madd of the int16 difference with itself sums channel
+        // pairs, two shuffles gather the pairs of each pixel
+        inline uint32_t NearestPaletteSse2(const uint8_t *px, const uint8_t *palette, const int n, uint8_t idx[16])
+        {
+            const auto zero = _mm_setzero_si128();
+            auto total = _mm_setzero_si128();
+            for (int i = 0; i < 16; i += 4)
+            {
+                const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(px + i * 4));
+                const auto lo = _mm_unpacklo_epi8(v, zero), hi = _mm_unpackhi_epi8(v, zero);
+                auto best = _mm_set1_epi32(INT32_MAX);
+                auto bestIdx = _mm_setzero_si128();
+                for (int j = 0; j < n; ++j)
+                {
+                    int32_t color;
+                    std::memcpy(&color, palette + j * 4, 4);
+                    const auto p = _mm_unpacklo_epi8(_mm_set1_epi32(color), zero);
+                    const auto dl = _mm_sub_epi16(lo, p), dh = _mm_sub_epi16(hi, p);
+                    const auto a = _mm_castsi128_ps(_mm_madd_epi16(dl, dl));
+                    const auto b = _mm_castsi128_ps(_mm_madd_epi16(dh, dh));
+                    const auto err = _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(a, b, 0x88)),
+                                                   _mm_castps_si128(_mm_shuffle_ps(a, b, 0xdd)));
+                    const auto lt = _mm_cmplt_epi32(err, best);
+                    best = _mm_or_si128(_mm_and_si128(lt, err), _mm_andnot_si128(lt, best));
+                    bestIdx = _mm_or_si128(_mm_and_si128(lt, _mm_set1_epi32(j)), _mm_andnot_si128(lt, bestIdx));
+                }
+                total = _mm_add_epi32(total, best);
+                const auto packed = _mm_packus_epi16(_mm_packs_epi32(bestIdx, zero), zero);
+                const auto bytes = _mm_cvtsi128_si32(packed);
+                std::memcpy(idx + i, &bytes, 4);
+            }
+            total = _mm_add_epi32(total, _mm_shuffle_epi32(total, 0x4e));
+            total = _mm_add_epi32(total, _mm_shuffle_epi32(total, 0xb1));
+            return static_cast<uint32_t>(_mm_cvtsi128_si32(total));
+        }
+
+        // within each 128 bit lane the shuffles give pixels in order, so eight at a time
+        __SIMD_TARGET__("avx2")
+        inline uint32_t NearestPaletteAvx2(const uint8_t *px, const uint8_t *palette, const int n, uint8_t idx[16])
+        {
+            const auto zero = _mm256_setzero_si256();
+            auto total = _mm256_setzero_si256();
+            for (int i = 0; i < 16; i += 8)
+            {
+                const auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(px + i * 4));
+                const auto lo = _mm256_unpacklo_epi8(v, zero), hi = _mm256_unpackhi_epi8(v, zero);
+                auto best = _mm256_set1_epi32(INT32_MAX);
+                auto bestIdx = _mm256_setzero_si256();
+                for (int j = 0; j < n; ++j)
+                {
+                    int32_t color;
+                    std::memcpy(&color, palette + j * 4, 4);
+                    const auto p = _mm256_unpacklo_epi8(_mm256_set1_epi32(color), zero);
+                    const auto dl = _mm256_sub_epi16(lo, p), dh = _mm256_sub_epi16(hi, p);
+                    const auto a = _mm256_castsi256_ps(_mm256_madd_epi16(dl, dl));
+                    const auto b = _mm256_castsi256_ps(_mm256_madd_epi16(dh, dh));
+                    const auto err = _mm256_add_epi32(_mm256_castps_si256(_mm256_shuffle_ps(a, b, 0x88)),
+                                                      _mm256_castps_si256(_mm256_shuffle_ps(a, b, 0xdd)));
+                    const auto lt = _mm256_cmpgt_epi32(best, err);
+                    best = _mm256_min_epi32(best, err);
+                    bestIdx = _mm256_blendv_epi8(bestIdx, _mm256_set1_epi32(j), lt);
+                }
+                total = _mm256_add_epi32(total, best);
+                const auto words = _mm256_packs_epi32(bestIdx, zero);
+                const auto bytes = _mm256_packus_epi16(words, zero);
+                const auto low = _mm_cvtsi128_si32(_mm256_castsi256_si128(bytes));
+                const auto high = _mm_cvtsi128_si32(_mm256_extracti128_si256(bytes, 1));
+                std::memcpy(idx + i, &low, 4);
+                std::memcpy(idx + i + 4, &high, 4);
+            }
+            auto sum = _mm_add_epi32(_mm256_castsi256_si128(total), _mm256_extracti128_si256(total, 1));
+            sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4e));
+            sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xb1));
+            return static_cast<uint32_t>(_mm_cvtsi128_si32(sum));
+        }
+
+        // the 16 values fit one register: absolute differences via two saturating
+        // subtractions, the error is summed as int16 squares
+        inline uint32_t NearestLevelSse2(const uint8_t *v, const uint8_t *levels, const int n, uint8_t idx[16])
+        {
+            const auto x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(v));
+            auto best = _mm_set1_epi8(-1);
+            auto bestIdx = _mm_setzero_si128();
+            for (int j = 0; j < n; ++j)
+            {
+                const auto l = _mm_set1_epi8(static_cast<char>(levels[j]));
+                const auto d = _mm_or_si128(_mm_subs_epu8(x, l), _mm_subs_epu8(l, x));
+                const auto lt = _mm_andnot_si128(_mm_cmpeq_epi8(d, best), _mm_cmpeq_epi8(_mm_min_epu8(d, best), d));
+                best = _mm_min_epu8(d, best);
+                bestIdx = _mm_or_si128(_mm_and_si128(lt, _mm_set1_epi8(static_cast<char>(j))), _mm_andnot_si128(lt, bestIdx));
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(idx), bestIdx);
+
+            const auto zero = _mm_setzero_si128();
+            const auto lo = _mm_unpacklo_epi8(best, zero), hi = _mm_unpackhi_epi8(best, zero);
+            auto sum = _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi));
+            sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4e));
+            sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xb1));
+            return static_cast<uint32_t>(_mm_cvtsi128_si32(sum));
+        }
+
+        // eight bytes at a time as int16; the predictor only reads the unfiltered rows,
+        // so unlike decoding there is no dependency along the row
+        inline void PaethFilterSse2(const uint8_t *row, const uint8_t *prior, const size_t n, const size_t bpp,
+                                    uint8_t *dst)
+        {
+            PaethFilterScalar(row, prior, 0, std::min(bpp, n), bpp, dst);
+
+            const auto zero = _mm_setzero_si128();
+            const auto load = [&](const uint8_t *p)
+            { return _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p)), zero); };
+            const auto abs16 = [](const __m128i v)
+            { return _mm_max_epi16(v, _mm_sub_epi16(_mm_setzero_si128(), v)); };
+
+            size_t i = bpp;
+            for (; i + 8 <= n; i += 8)
+            {
+                const auto a = load(row + i - bpp), b = load(prior + i), c = load(prior + i - bpp);
+                const auto pa = abs16(_mm_sub_epi16(b, c));
+                const auto pb = abs16(_mm_sub_epi16(a, c));
+                const auto pc = abs16(_mm_sub_epi16(_mm_add_epi16(a, b), _mm_add_epi16(c, c)));
+                // pa <= pb && pa <= pc picks a, else pb <= pc picks b, else c
+                const auto useA = _mm_andnot_si128(_mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc)),
+                                                   _mm_set1_epi16(-1));
+                const auto useB = _mm_andnot_si128(_mm_cmpgt_epi16(pb, pc), _mm_set1_epi16(-1));
+                const auto bc = _mm_or_si128(_mm_and_si128(useB, b), _mm_andnot_si128(useB, c));
+                const auto pred = _mm_or_si128(_mm_and_si128(useA, a), _mm_andnot_si128(useA, bc));
+                const auto x = load(row + i);
+                const auto out = _mm_packus_epi16(_mm_and_si128(_mm_sub_epi16(x, pred), _mm_set1_epi16(0xff)), zero);
+                _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + i), out);
+            }
+            PaethFilterScalar(row, prior, i, n, bpp, dst);
+        }
+
+        // |x| of a signed byte is min(x, -x) read unsigned, psadbw sums it
+        inline uint64_t SumAbsSignedSse2(const uint8_t *v, const size_t n)
+        {
+            const auto zero = _mm_setzero_si128();
+            auto acc = _mm_setzero_si128();
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16)
+            {
+                const auto x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(v + i));
+                acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_min_epu8(x, _mm_sub_epi8(zero, x)), zero));
+            }
+            const auto sum = static_cast<uint64_t>(_mm_cvtsi128_si64(acc)) +
+                             static_cast<uint64_t>(_mm_cvtsi128_si64(_mm_unpackhi_epi64(acc, acc)));
+            return sum + SumAbsSignedScalar(v + i, n - i);
+        }
+
+        // Rows stay in registers and no transpose is needed: T = C X takes row k of T
+        // as the sum of the rows of X times the broadcast C[k][i], Y = T C^T the sum of
+        // the rows of C^T times the broadcast T[k][n].
+        inline void ForwardDctQuantizeSse2(const float *in, const float *scale, int16_t *out)
+        {
+            const auto ct = DctBasisT();
+            alignas(16) float t[64];
+            for (int k = 0; k < 8; ++k)
+            {
+                auto lo = _mm_setzero_ps(), hi = _mm_setzero_ps();
+                for (int i = 0; i < 8; ++i)
+                {
+                    const auto c = _mm_set1_ps(ct[i * 8 + k]);
+                    lo = _mm_add_ps(lo, _mm_mul_ps(c, _mm_loadu_ps(in + i * 8)));
+                    hi = _mm_add_ps(hi, _mm_mul_ps(c, _mm_loadu_ps(in + i * 8 + 4)));
+                }
+                _mm_store_ps(t + k * 8, lo);
+                _mm_store_ps(t + k * 8 + 4, hi);
+            }
+            for (int k = 0; k < 8; ++k)
+            {
+                auto lo = _mm_setzero_ps(), hi = _mm_setzero_ps();
+                for (int n = 0; n < 8; ++n)
+                {
+                    const auto v = _mm_set1_ps(t[k * 8 + n]);
+                    lo = _mm_add_ps(lo, _mm_mul_ps(v, _mm_loadu_ps(ct + n * 8)));
+                    hi = _mm_add_ps(hi, _mm_mul_ps(v, _mm_loadu_ps(ct + n * 8 + 4)));
+                }
+                const auto a = _mm_cvtps_epi32(_mm_mul_ps(lo, _mm_loadu_ps(scale + k * 8)));
+                const auto b = _mm_cvtps_epi32(_mm_mul_ps(hi, _mm_loadu_ps(scale + k * 8 + 4)));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out + k * 8), _mm_packs_epi32(a, b));
+            }
+        }
+
+        __SIMD_TARGET__("avx2,fma")
+        inline void ForwardDctQuantizeAvx2(const float *in, const float *scale, int16_t *out)
+        {
+            const auto ct = DctBasisT();
+            __m256 x[8], basis[8];
+            for (int i = 0; i < 8; ++i)
+            {
+                x[i] = _mm256_loadu_ps(in + i * 8);
+                basis[i] = _mm256_loadu_ps(ct + i * 8);
+            }
+
+            alignas(32) float t[64];
+            for (int k = 0; k < 8; ++k)
+            {
+                auto acc = _mm256_setzero_ps();
+                for (int i = 0; i < 8; ++i)
+                    acc = _mm256_fmadd_ps(_mm256_broadcast_ss(ct + i * 8 + k), x[i], acc);
+                _mm256_store_ps(t + k * 8, acc);
+            }
+
+            __m256i rows[8];
+            for (int k = 0; k < 8; ++k)
+            {
+                auto acc = _mm256_setzero_ps();
+                for (int n = 0; n < 8; ++n)
+                    acc = _mm256_fmadd_ps(_mm256_broadcast_ss(t + k * 8 + n), basis[n], acc);
+                rows[k] = _mm256_cvtps_epi32(_mm256_mul_ps(acc, _mm256_loadu_ps(scale + k * 8)));
+            }
+            // packs works per lane, the permute restores the order
+            for (int k = 0; k < 8; k += 2)
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + k * 8),
+                                    _mm256_permute4x64_epi64(_mm256_packs_epi32(rows[k], rows[k + 1]), 0xd8));
+        }
+
+        // pshufb only shuffles inside 16 byte lanes, enough since a pixel never crosses one
+        __SIMD_TARGET__("ssse3")
+        inline void SwizzleSsse3(const uint8_t *src, const uint8_t order[4], const uint32_t fill,
+                                 uint8_t *dst, const size_t n)
+        {
+            alignas(16) uint8_t mask[16];
+            for (int i = 0; i < 16; ++i)
+                mask[i] = order[i & 3] < 4 ? static_cast<uint8_t>((i & ~3) + order[i & 3]) : 0x80;
+            const auto m = _mm_load_si128(reinterpret_cast<const __m128i *>(mask));
+            const auto f = _mm_set1_epi32(static_cast<int>(fill));
+
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4)
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 4),
+                                 _mm_or_si128(_mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4)), m), f));
+            SwizzleScalar(src + i * 4, order, fill, dst + i * 4, n - i);
+        }
+
+        __SIMD_TARGET__("avx2")
+        inline void SwizzleAvx2(const uint8_t *src, const uint8_t order[4], const uint32_t fill,
+                                uint8_t *dst, const size_t n)
+        {
+            alignas(16) uint8_t mask[16];
+            for (int i = 0; i < 16; ++i)
+                mask[i] = order[i & 3] < 4 ? static_cast<uint8_t>((i & ~3) + order[i & 3]) : 0x80;
+            const auto m = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(mask)));
+            const auto f = _mm256_set1_epi32(static_cast<int>(fill));
+
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16)
+            {
+                const auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i * 4));
+                const auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i * 4 + 32));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i * 4), _mm256_or_si256(_mm256_shuffle_epi8(a, m), f));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i * 4 + 32), _mm256_or_si256(_mm256_shuffle_epi8(b, m), f));
+            }
+            SwizzleSsse3(src + i * 4, order, fill, dst + i * 4, n - i);
+        }
+
+        __SIMD_TARGET__("avx512f,avx512bw")
+        inline void SwizzleAvx512(const uint8_t *src, const uint8_t order[4], const uint32_t fill,
+                                  uint8_t *dst, const size_t n)
+        {
+            alignas(16) uint8_t mask[16];
+            for (int i = 0; i < 16; ++i)
+                mask[i] = order[i & 3] < 4 ? static_cast<uint8_t>((i & ~3) + order[i & 3]) : 0x80;
+            const auto m = _mm512_broadcast_i32x4(_mm_load_si128(reinterpret_cast<const __m128i *>(mask)));
+            const auto f = _mm512_set1_epi32(static_cast<int>(fill));
+
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16)
+                _mm512_storeu_si512(dst + i * 4, _mm512_or_si512(_mm512_shuffle_epi8(_mm512_loadu_si512(src + i * 4), m), f));
+            SwizzleAvx2(src + i * 4, order, fill, dst + i * 4, n - i);
+        }
+#endif
+    }
+
+    // Detected once, the widest instruction set both cpu and os support.
+    inline Level CpuLevel()
+    {
+        static const Level level = __Detail::Detect();
+        return level;
+    }
+
+    namespace __Detail
+    {
+        inline void AddSaturate(const uint8_t *a, const uint8_t *b, const uint32_t pattern,
+                                uint8_t *dst, const size_t n)
+        {
+#ifdef __SIMD_X64__
+            switch (CpuLevel())
+            {
+            case Level::Avx512:
+                return AddSaturateAvx512(a, b, pattern, dst, n);
+            case Level::Avx2:
+                return AddSaturateAvx2(a, b, pattern, dst, n);
+            case Level::Sse2:
+                return AddSaturateSse2(a, b, pattern, dst, n);
+            default:
+                break;
+            }
+#endif
+            AddSaturateScalar(a, b, pattern, dst, n);
+        }
+    }
+
+    // dst[i] = min(a[i] + b[i], 255), dst may alias a
+    inline void AddSaturate(const uint8_t *a, const uint8_t *b, uint8_t *dst, const size_t n)
+    {
+        __Detail::AddSaturate(a, b, 0, dst, n);
+    }
+
+    // the same with one RGBA color added to every pixel, n counts bytes
+    inline void AddSaturateColor(const uint8_t *a, const uint8_t color[4], uint8_t *dst, const size_t n)
+    {
+        const auto pattern = static_cast<uint32_t>(color[0]) |
+                             static_cast<uint32_t>(color[1]) << 8 |
+                             static_cast<uint32_t>(color[2]) << 16 |
+                             static_cast<uint32_t>(color[3]) << 24;
+        __Detail::AddSaturate(a, nullptr, pattern, dst, n);
+    }
+
+    // Image::RgbToHsl over n pixels in planar (SoA) layout, h in degrees [0, 360)
+    inline void RgbToHsl(const float *r, const float *g, const float *b,
+                         float *h, float *s, float *l, const size_t n)
+    {
+#ifdef __SIMD_X64__
+        if (CpuLevel() >= Level::Avx2)
+            return __Detail::RgbToHslAvx2(r, g, b, h, s, l, n);
+        if (CpuLevel() == Level::Sse2)
+            return __Detail::RgbToHslSse2(r, g, b, h, s, l, n);
+#endif
+        __Detail::RgbToHslScalar(r, g, b, h, s, l, n);
+    }
+
+    // Image::HslToRgb over n pixels in planar (SoA) layout
+    inline void HslToRgb(const float *h, const float *s, const float *l,
+                         float *r, float *g, float *b, const size_t n)
+    {
+#ifdef __SIMD_X64__
+        if (CpuLevel() >= Level::Avx2)
+            return __Detail::HslToRgbAvx2(h, s, l, r, g, b, n);
+        if (CpuLevel() == Level::Sse2)
+            return __Detail::HslToRgbSse2(h, s, l, r, g, b, n);
+#endif
+        __Detail::HslToRgbScalar(h, s, l, r, g, b, n);
+    }
+
+    // Normalizes (dx, dy, dz) for n pixels and stores them as RGB in [0, 255],
+    // alpha is copied from src. dst may alias src.
+    inline void PackNormals(const float *dx, const float *dy, const float dz,
+                            const uint8_t *src, uint8_t *dst, const size_t n)
+    {
+#ifdef __SIMD_X64__
+        if (CpuLevel() >= Level::Avx2)
+            return __Detail::PackNormalsAvx2(dx, dy, dz, src, dst, n);
+        if (CpuLevel() == Level::Sse2)
+            return __Detail::PackNormalsSse2(dx, dy, dz, src, dst, n);
+#endif
+        __Detail::PackNormalsScalar(dx, dy, dz, src, dst, n);
+    }
+
+    // acc[i] += w * x[i], the building block of separable filters
+    inline void Axpy(float *acc, const float *x, const float w, const size_t n)
+    {
+#ifdef __SIMD_X64__
+        if (CpuLevel() >= Level::Avx2)
+            return __Detail::AxpyAvx2(acc, x, w, n);
+        if (CpuLevel() == Level::Sse2)
+            return __Detail::AxpySse2(acc, x, w, n);
+#endif
+        __Detail::AxpyScalar(acc, x, w, n);
+    }
+
+    // one channel (0 ~ 3) of n RGBA8 pixels as float times scale
+    inline void ChannelToFloat(const uint8_t *px, const int channel, const float scale, float *out, const size_t n)
+    {
+#ifdef __SIMD_X64__
+        if (CpuLevel() >= Level::Avx2)
+            return __Detail::ChannelToFloatAvx2(px, channel, scale, out, n);
+        if (CpuLevel() == Level::Sse2)
+            return __Detail::ChannelToFloatSse2(px, channel, scale, out, n);
+#endif
+        __Detail::ChannelToFloatScalar(px, channel, scale, out, n);
+    }
+
+    // n RGBA8 pixels to JFIF YCbCr planes, y level shifted by -128, cb and cr centered on 0
+    inline void RgbaToYCbCr(const uint8_t *px, const size_t n, float *y, float *cb, float *cr)
+    {
+#ifdef __SIMD_X64__
+        if (CpuLevel() >= Level::Avx2)
+            return __Detail::RgbaToYCbCrAvx2(px, n, y, cb, cr);
+        if (CpuLevel() == Level::Sse2)
+            return __Detail::RgbaToYCbCrSse2(px, n, y, cb, cr);
+#endif
+        __Detail::RgbaToYCbCrScalar(px, n, y, cb, cr);
+    }
+
+    // dst[i] = sum of weights[k] * src[k * stride + i] for k < taps, the vertical
+    // pass of a resampler over taps byte rows into one float row
+    inline void FilterRows(const uint8_t *src, const size_t stride, const float *weights, const int taps,
+                           float *dst, const size_t n)
+    {
+#ifdef __SIMD_X64__
+        if (CpuLevel() >= Level::Avx2)
+            return __Detail::FilterRowsAvx2(src, stride, weights, taps, dst, n);
+        if (CpuLevel() == Level::Sse2)
+            return __Detail::FilterRowsSse2(src, stride, weights, taps, dst, n);
+#endif
+        __Detail::FilterRowsScalar(src, stride, weights, taps, dst, n);
+    }
+
+    // The horizontal pass of a resampler over n output pixels: pixel x is the sum of
+    // weights[x * taps + k] * src pixel start[x] + k for k < taps, src is RGBA float
+    // in [0, 255], the result is rounded and saturated to RGBA8.
+    inline void ResampleRow(const float *src, const int32_t *start, const float *weights, const int taps,
+                            uint8_t *dst, const size_t n)
+    {
+#ifdef __SIMD_X64__
+        if (CpuLevel() >= Level::Avx2)
+            return __Detail::ResampleRowAvx2(src, start, weights, taps, dst, n);
+        if (CpuLevel() == Level::Sse2)
+            return __Detail::ResampleRowSse2(src, start, weights, taps, dst, n);
+#endif
+        __Detail::ResampleRowScalar(src, start, weights, taps, dst, n);
+    }
+
+    // FilterRows in fixed point: pairs holds (taps + 1) / 2 packed 2.14 weight pairs,
+    // dst is 9.6 fixed point
+    inline void FilterRowsFixed(const uint8_t *src, const size_t stride, const int32_t *pairs, const int taps,
+                                int16_t *dst, const size_t n)
+    {
+#ifdef __SIMD_X64__
+        if (CpuLevel() >= Level::Avx2)
+            return __Detail::FilterRowsFixedAvx2(src, stride, pairs, taps, dst, n);
+        if (CpuLevel() == Level::Sse2)
+            return __Detail::FilterRowsFixedSse2(src, stride, pairs, taps, dst, n);
+#endif
+        __Detail::FilterRowsFixedScalar(src, stride, pairs, taps, dst, n);
+    }
+
+    // ResampleRow in fixed point over a 9.6 row from FilterRowsFixed, pairs holds
+    // (taps + 1) / 2 weight pairs per output pixel. Pixels are read in pairs, so
+    // with an odd tap count src needs one more pixel after the last tap.
+    inline void ResampleRowFixed(const int16_t *src, const int32_t *start, const int32_t *pairs, const int taps,
+                                 uint8_t *dst, const size_t n)
+    {
+#ifdef __SIMD_X64__
+        if (CpuLevel() >= Level::Avx2)
+            return __Detail::ResampleRowFixedAvx2(src, start, pairs, taps, dst, n);
+        if (CpuLevel() == Level::Sse2)
+            return __Detail::ResampleRowFixedSse2(src, start, pairs, taps, dst, n);
+#endif
+        __Detail::ResampleRowFixedScalar(src, start, pairs, taps, dst, n);
+    }
+
+    // n RGBA8 pixels, each the rounded mean of a 2x2 block of the rows a and b
+    // (2n pixels each), the 2x box reduction of a mip chain
+    inline void Halve(const uint8_t *a, const uint8_t *b, uint8_t *dst, const size_t n)
+    {
+#ifdef __SIMD_X64__
+        if (CpuLevel() >= Level::Avx2)
+            return __Detail::HalveAvx2(a, b, dst, n);
+        if (CpuLevel() == Level::Sse2)
+            return __Detail::HalveSse2(a, b, dst, n);
+#endif
+        __Detail::HalveScalar(a, b, dst, n);
+    }
+
+    // For each of 16 RGBA8 pixels the index of the closest of n RGBA8 palette entries
+    // by squared distance over all four channels, ties go to the lower index.
+    // Returns the summed squared error; the block search of the BCn encoders.
+    inline uint32_t NearestPalette(const uint8_t *px, const uint8_t *palette, const int n, uint8_t idx[16])
+    {
+#ifdef __SIMD_X64__
+        if (CpuLevel() >= Level::Avx2)
+            return __Detail::NearestPaletteAvx2(px, palette, n, idx);
+        if (CpuLevel() == Level::Sse2)
+            return __Detail::NearestPaletteSse2(px, palette, n, idx);
+#endif
+        return __Detail::NearestPaletteScalar(px, palette, n, idx);
+    }
+
+    // NearestPalette for 16 single channel values against n levels
+    inline uint32_t NearestLevel(const uint8_t *v, const uint8_t *levels, const int n, uint8_t idx[16])
+    {
+#ifdef __SIMD_X64__
+        if (CpuLevel() >= Level::Sse2)
+            return __Detail::NearestLevelSse2(v, levels, n, idx);
+#endif
+        return __Detail::NearestLevelScalar(v, levels, n, idx);
+    }
+
+    // The PNG Paeth filter of an n byte row with bpp bytes per pixel, prior is the
+    // unfiltered row above (zeros for the first row).
+    inline void PaethFilter(const uint8_t *row, const uint8_t *prior, const size_t n, const size_t bpp, uint8_t *dst)
+    {
+#ifdef __SIMD_X64__
+        if (CpuLevel() >= Level::Sse2)
+            return __Detail::PaethFilterSse2(row, prior, n, bpp, dst);
+#endif
+        __Detail::PaethFilterScalar(row, prior, 0, n, bpp, dst);
+    }
+
+    // sum of |v[i]| with the bytes read as int8, the PNG filter selection heuristic
+    inline uint64_t SumAbsSigned(const uint8_t *v, const size_t n)
+    {
+#ifdef __SIMD_X64__
+        if (CpuLevel() >= Level::Sse2)
+            return __Detail::SumAbsSignedSse2(v, n);
+#endif
+        return __Detail::SumAbsSignedScalar(v, n);
+    }
+
+    // The orthonormal 2D DCT-II of an 8x8 block of level shifted samples, each
+    // coefficient times scale[i] (the reciprocal quantizer) rounded to nearest.
+    // Everything is in natural (row major) order.
+    inline void ForwardDctQuantize(const float *in, const float *scale, int16_t *out)
+    {
+#ifdef __SIMD_X64__
+        if (CpuLevel() >= Level::Avx2)
+            return __Detail::ForwardDctQuantizeAvx2(in, scale, out);
+        if (CpuLevel() == Level::Sse2)
+            return __Detail::ForwardDctQuantizeSse2(in, scale, out);
+#endif
+        __Detail::ForwardDctQuantizeScalar(in, scale, out);
+    }
+
+    // Rearranges the bytes of n RGBA8 pixels: output channel c is input byte order[c]
+    // (0 ~ 3) or 0 when order[c] >= 4, then fill is or'ed in, e.g. 0xff000000 for
+    // opaque alpha. dst may alias src.
+    inline void Swizzle(const uint8_t *src, const uint8_t order[4], const uint32_t fill,
+                        uint8_t *dst, const size_t n)
+    {
+#ifdef __SIMD_X64__
+        static const bool ssse3 = __Detail::DetectSsse3();
+        if (CpuLevel() == Level::Avx512)
+            return __Detail::SwizzleAvx512(src, order, fill, dst, n);
+        if (CpuLevel() == Level::Avx2)
+            return __Detail::SwizzleAvx2(src, order, fill, dst, n);
+        if (ssse3)
+            return __Detail::SwizzleSsse3(src, order, fill, dst, n);
+#endif
+        __Detail::SwizzleScalar(src, order, fill, dst, n);
+    }
+}
@@ -2,6 +2,7 @@
 // std
 #include <execution>
 #include <filesystem>
+#include <functional>
 #include <queue>
 #include <thread>
 #include <span>
@@ -12,6 +13,10 @@
 
 // project
 #include "ItUtility.hpp"
+#include "ItBatch.hpp"
+#include "ItIndex.hpp"
+#include "ItJournal.hpp"
+#include "ItWatch.hpp"
 #include "ItToolUI.hpp"
 #include "ItLog.hpp"
 
@@ -44,8 +49,11 @@ static auto CurrentGlobalId = []() -> Sequence<uint64_t>
 				   LinearDodgeTool,           \
 				   GenerateNormalTextureTool, \
 				   NormalMapConvertorTool,    \
+				   ChannelSwizzleTool,        \
 				   ColorBalanceTool,          \
 				   HueSaturationTool,         \
+				   ResizeTool,                \
+				   MipmapTool,                \
 				   Waifu2xTool,               \
 				   RealsrTool
 
@@ -54,6 +62,7 @@ static auto CurrentGlobalId = []() -> Sequence<uint64_t>
 					SaveSettingEvent,    \
 					StartProcessEvent,   \
 					EndProcessEvent,     \
+					StartWatchEvent,     \
 					AlwaysEvent,         \
 					LoadImageEvent
 
@@ -63,7 +72,6 @@ EventSystem<ItEventList> Events{};
 class ImgTools
 {
 #pragma region ImgToolsType
-	using IoPath = std::pair<std::filesystem::path, std::filesystem::path>;
 	using PreviewItem = std::pair<std::filesystem::path, ImageView>;
 	using ToolType = ToolListTypes<ItToolList>::ToolType;
 	using ProcessorType = ToolListTypes<ItToolList>::ProcessorType;
@@ -78,14 +86,22 @@ class ImgTools
 		int FpsLimit = 60;
 		Processor ExportProcessor = Processor::GPU;
 		Processor PreviewProcessor = Processor::GPU;
+		bool ResumeExport = true;
+		bool IncrementalExport = false;
+		int Processes = 1;
+		BatchMode ExportBatchMode = BatchMode::Queue;
+		Image::SaveOptions Encode{};
+		// longest side previews are loaded at, 0 for full size
+		int PreviewSize = 2048;
 
 		static std::string ToJson(const SettingData &data)
 		{
 			return nlohmann::json(data).dump(4);
 		}
 
-		NLOHMANN_DEFINE_TYPE_INTRUSIVE(SettingData, Language, ClearColor, VSync,
-		                               FpsLimit, ExportProcessor, PreviewProcessor)
+		NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(SettingData, Language, ClearColor, VSync,
+		                                            FpsLimit, ExportProcessor, PreviewProcessor, ResumeExport,
+		                                            IncrementalExport, Processes, ExportBatchMode, Encode, PreviewSize)
 	};
 #pragma endregion ImgToolsStruct
 
@@ -117,9 +133,12 @@ class ImgTools
 	// proc status
 	ImageFormat imgFormat = ImageFormat::png;
 	// bool needJoin = false;
-	std::priority_queue<IoPath, std::vector<IoPath>, std::greater<>> procFiles{};
+	std::unique_ptr<FileScanner> procFiles{};
+	std::function<std::filesystem::path(const FileScanner::Entry &)> procOutput{};
+	ExportJournalSet procJournals{};
+	ExportOptions procOptions{};
 	std::atomic_int64_t processedCount = 0;
-	int64_t totalCount = 0;
+	std::atomic_int64_t totalCount = 0;
 	float procStatus = 0.f;
 	float procTimePreUpdate = 0.f;
 	U8String curFile{};
@@ -146,11 +165,8 @@ class ImgTools
 #pragma endregion ImgToolsStatus
 
 #pragma region ImgToolsHelper
-	static Image::ImageFile ProcessFile(const Image::ImageFile &img,
-										std::vector<ToolType> &tools, const bool isPreview)
+	static std::vector<ProcessorType> PrepareProcessors(std::vector<ToolType> &tools, const bool isPreview)
 	{
-		Image::ImageFile cur = img;
-
 		std::vector<ProcessorType> processors{};
 		for (auto &tool : tools)
 		{
@@ -158,7 +174,7 @@ class ImgTools
 					[&](auto &x) -> std::optional<ProcessorType>
 					{
 						x.IsPreview = isPreview;
-						return x.Processor();
+						return x.Prepare();
 					},
 					tool);
 				val.has_value())
@@ -166,11 +182,36 @@ class ImgTools
 				processors.push_back(*val);
 			}
 		}
+		return processors;
+	}
+
+	static Image::ImageFile ProcessFile(const Image::ImageFile &img,
+										std::vector<ToolType> &tools, const bool isPreview)
+	{
+		return ProcessFile(img, PrepareProcessors(tools, isPreview));
+	}
+
+	// whether the first processor takes format as decoded, see ExportItem
+	static bool AcceptsInput(const std::vector<ProcessorType> &prepared, const Image::PixelFormat &format)
+	{
+		return !prepared.empty() && std::visit([&](const auto &x)
+											   { return x.Accepts(format); },
+											   prepared.front());
+	}
+
+	// prepared processors are only read, every image binds its own copies;
+	// an image is converted to Rgba8 before the first processor that needs it
+	static Image::ImageFile ProcessFile(const Image::ImageFile &img, const std::vector<ProcessorType> &prepared)
+	{
+		Image::ImageFile cur = img;
 
-		for (auto &proc : processors)
+		for (auto proc : prepared)
 		{
 			std::visit([&](auto &x)
-					   { x.ImgRef(cur); },
+					   {
+						   if (!x.Accepts(cur.Format()))
+							   cur = cur.Converted(Image::Rgba8);
+						   x.Bind(cur); },
 					   proc);
 			const auto [w, h] = std::visit(
 				[](const auto &x) -> ImageTools::ImageSize
@@ -179,24 +220,23 @@ class ImgTools
 				},
 				proc);
 			auto buf = Image::ImageFile(w, h);
+			const auto stride = static_cast<size_t>(w) * 4;
 
 			Enumerable::Range<int64_t> rng(h);
 			std::for_each(
 				std::execution::par_unseq, rng.begin(), rng.end(),
-				[&, w = w](const auto &hIdx)
+				[&](const auto &hIdx)
 				{
-					for (int wIdx = 0; wIdx < w; ++wIdx)
-					{
-						buf.Set(hIdx, wIdx,
-								std::visit([&](auto &x)
-										   { return x(hIdx, wIdx); },
-										   proc));
-					}
+					std::visit([&](auto &x)
+							   { ImageTools::ProcessRow(x, hIdx, buf.Data() + hIdx * stride); },
+							   proc);
 				});
 
-			cur = buf;
+			cur = std::move(buf);
 		}
 
+		if (cur.Format() != Image::Rgba8)
+			cur = cur.Converted(Image::Rgba8);
 		return cur;
 	}
 
@@ -220,6 +260,205 @@ class ImgTools
 		return imgPrev;
 	}
 
+	void SetupProcOutput(const std::vector<std::filesystem::path> &paths)
+	{
+		const auto output = outputPath.GetPath();
+		if (paths.size() == 1 && is_regular_file(paths[0]))
+		{
+			procOutput = [output](const FileScanner::Entry &)
+			{
+				return output;
+			};
+		}
+		else if (paths.size() == 1)
+		{
+			procOutput = [&, output](const FileScanner::Entry &file)
+			{
+				return std::filesystem::path(output / file.Path.lexically_relative(file.Root)).replace_extension(GetExtension());
+			};
+		}
+		else
+		{
+			procOutput = [&, output](const FileScanner::Entry &file)
+			{
+				if (output == sourceDirectoryPlaceholder)
+				{
+					return std::filesystem::path(file.Path).replace_filename(String::FormatW("{}.out.{}", file.Path.stem(), GetExtension()));
+				}
+
+				auto dir = output;
+				if (const auto sub = file.Path.parent_path().lexically_relative(file.Root); !sub.empty() && sub != ".")
+					dir /= sub;
+				return dir / String::FormatW("{}.{}", file.Path.stem(), GetExtension());
+			};
+		}
+	}
+
+	ExportOptions MakeExportOptions(const Processor processor) const
+	{
+		return {
+			.Resume = settingData.ResumeExport,
+			.Incremental = settingData.IncrementalExport,
+			.PresetHash = PresetHash(processor),
+			.Save = settingData.Encode};
+	}
+
+	void ProcLocal()
+	{
+		// prepared on first use so a fully up-to-date batch never loads anything
+		std::optional<std::vector<ProcessorType>> prepared{};
+		// one file ahead of the one being exported, so its read overlaps the work
+		ReadAhead readAhead{};
+		for (auto file = procFiles->Next(), next = file ? procFiles->Next() : std::nullopt; file;
+			 file = std::move(next), next = file ? procFiles->Next() : std::nullopt)
+		{
+			if (next)
+				readAhead.Hint(next->Path);
+			totalCount = static_cast<int64_t>(procFiles->Found());
+
+			const auto &in = file->Path;
+			auto out = procOutput(*file);
+			out.replace_extension(GetExtension());
+			LogInfo(R"("{}" => "{}")", in, out);
+
+			curFile = in.u8string();
+			ExportItem(
+				procOptions, procJournals, in, out,
+				[&](const Image::ImageFile &img)
+				{
+					if (settingData.ExportProcessor == Processor::GPU)
+						return ProcessFileGpu(D3D11CSDev.Get(), D3D11CSDevCtx.Get(),
+											  img, toolList, false);
+					if (!prepared)
+						prepared = PrepareProcessors(toolList, false);
+					return ProcessFile(img, *prepared);
+				},
+				[&](const Image::PixelFormat &format)
+				{
+					if (settingData.ExportProcessor == Processor::GPU)
+						return false;
+					if (!prepared)
+						prepared = PrepareProcessors(toolList, false);
+					return AcceptsInput(*prepared, format);
+				});
+
+			++processedCount;
+		}
+	}
+
+	// Exports files dropped into the watched directories until cancelled,
+	// preparing the processors once for the whole session.
+	void ProcWatch(const std::stop_token &tk, const std::vector<std::filesystem::path> &roots)
+	{
+		const auto output = outputPath.GetPath();
+		FolderWatcher watcher(
+			roots,
+			{.Accept = [&, output](const std::filesystem::path &file)
+			 {
+				 if (output == sourceDirectoryPlaceholder)
+					 return !file.stem().wstring().ends_with(L".out");
+				 const auto rel = file.lexically_relative(output);
+				 return rel.empty() || *rel.begin() == "..";
+			 }});
+
+		auto tools = toolList;
+		std::optional<std::vector<ProcessorType>> prepared{};
+		curFile.Set(NormU8(Text::Watching()));
+
+		while (const auto file = watcher.Next(tk))
+		{
+			const auto &in = file->Path;
+			auto out = procOutput(*file);
+			out.replace_extension(GetExtension());
+			LogInfo(R"([Watch] "{}" => "{}")", in, out);
+
+			curFile = in.u8string();
+			ExportItem(
+				procOptions, procJournals, in, out,
+				[&](const Image::ImageFile &img)
+				{
+					if (settingData.ExportProcessor == Processor::GPU)
+						return ProcessFileGpu(D3D11CSDev.Get(), D3D11CSDevCtx.Get(),
+											  img, tools, false);
+					if (!prepared)
+						prepared = PrepareProcessors(tools, false);
+					return ProcessFile(img, *prepared);
+				},
+				[&](const Image::PixelFormat &format)
+				{
+					if (settingData.ExportProcessor == Processor::GPU)
+						return false;
+					if (!prepared)
+						prepared = PrepareProcessors(tools, false);
+					return AcceptsInput(*prepared, format);
+				});
+			procJournals.For(out).Sync();
+
+			++processedCount;
+			totalCount = processedCount.load() + static_cast<int64_t>(watcher.Pending());
+		}
+	}
+
+	// Hands the scanned inputs to worker processes in chunks as they are found.
+	void ProcBatch(const std::stop_token &tk)
+	{
+		BatchQueue queue(Config::TmpDir / String::FormatW("batch-{}", UUID4()));
+		queue.Create({.Preset = PresetJson(), .Options = procOptions});
+		curFile.Set(NormU8(Text::WorkerProcesses()));
+
+		bool failed = false;
+		uint64_t givenUp = 0;
+		{
+			WorkerPool pool(queue, settingData.ExportBatchMode, static_cast<size_t>(settingData.Processes));
+
+			// headers only, cached per input directory in the user cache
+			ImageIndexSet index{};
+			std::vector<BatchQueue::Item> chunk{};
+			uint64_t chunkPixels = 0;
+			while (const auto file = procFiles->Next())
+			{
+				totalCount = static_cast<int64_t>(procFiles->Found());
+
+				auto out = procOutput(*file);
+				out.replace_extension(GetExtension());
+				chunk.push_back({.Input = ToImString(file->Path), .Output = ToImString(out)});
+				if (const auto info = index.Get(file->Path))
+					chunkPixels += static_cast<uint64_t>(info->Width) * info->Height;
+				if (chunk.size() >= BatchQueue::ChunkSize || chunkPixels >= BatchQueue::ChunkPixels)
+				{
+					queue.Publish(chunk);
+					chunk.clear();
+					chunkPixels = 0;
+					pool.Poll();
+					processedCount = static_cast<int64_t>(pool.Completed());
+				}
+			}
+			if (!chunk.empty())
+				queue.Publish(chunk);
+
+			if (tk.stop_requested())
+				queue.Cancel();
+			else
+				queue.Seal();
+
+			while (pool.Poll())
+			{
+				if (tk.stop_requested() && !queue.Cancelled())
+					queue.Cancel();
+				processedCount = static_cast<int64_t>(pool.Completed());
+				std::this_thread::sleep_for(std::chrono::milliseconds(200));
+			}
+			processedCount = static_cast<int64_t>(pool.Completed());
+			failed = pool.Failed();
+			givenUp = pool.GivenUp();
+		}
+
+		std::error_code ec;
+		remove_all(queue.Dir(), ec);
+		if (failed)
+			throw Ex(ImgToolsException, "batch export incomplete, {} item(s) given up", givenUp);
+	}
+
 	static Image::ImageFile ProcessFileGpu(Dx11DevType *dev,
 										   Dx11DevCtxType *devCtx,
 										   const Image::ImageFile &input,
@@ -482,7 +721,8 @@ private:
 			{
 				previewTexture = D3D11::LoadTextureFromFile(
 					D3D11Dev.Get(),
-					ProcessFile(Image::ImageFile(rawTextures[*currentPreviewIdx].first), toolList, true));
+					ProcessFile(LoadImagePreview(rawTextures[*currentPreviewIdx].first, settingData.PreviewSize),
+								toolList, true));
 			}
 		}
 
@@ -702,79 +942,40 @@ private:
 				auto paths = ParsePathFromPaths(inputPath.GetView());
 				CheckOutputPath(paths);
 
-				const auto output = outputPath.GetPath();
-				if (paths.empty())
-				{
-				}
-				else if (paths.size() == 1)
-				{
-					if (const auto &path = paths[0]; is_regular_file(path))
-					{
-						procFiles.emplace(path, output);
-					}
-					else if (is_directory(path))
-					{
-						for (const auto &file : GetFilesFromPaths(paths))
-						{
-							procFiles.emplace(file, std::filesystem::path(output / file.filename()).replace_extension(GetExtension()));
-						}
-					}
-				}
-				else
-				{
-					for (const auto &file : GetFilesFromPaths(paths))
-					{
-						if (output == sourceDirectoryPlaceholder)
-						{
-							procFiles.emplace(file, std::filesystem::path(file).replace_filename(String::FormatW("{}.out.{}", file.stem(), GetExtension())));
-						}
-						else
-						{
-							procFiles.emplace(file, output / String::FormatW("{}.{}", file.stem(), GetExtension()));
-						}
-					}
-				}
+				SetupProcOutput(paths);
+				procFiles = std::make_unique<FileScanner>(paths, FileScanner::Options{.Recursive = true});
+				// worker processes always run the CPU processors
+				procOptions = MakeExportOptions(settingData.Processes > 1 ? Processor::CPU : settingData.ExportProcessor);
 
 				IsProcessing = true;
 				processedCount.store(0);
-				totalCount = static_cast<int64_t>(procFiles.size());
+				totalCount.store(0);
 
 				static const auto ProcHandle = [&](const std::stop_token &tk)
 				{
-					while (!procFiles.empty())
 					{
-						if (tk.stop_requested())
-						{
-							procFiles = {};
-							break;
-						}
-
-						const auto& [in, outRaw] = procFiles.top();
-						auto out = std::filesystem::path(outRaw);
-						out.replace_extension(GetExtension());
-						LogInfo(R"("{}" => "{}")", in, out);
+						std::stop_callback onStop(tk, [&]
+												  { procFiles->Stop(); });
 
-						try
+						if (settingData.Processes > 1)
 						{
-							curFile = in.u8string();
-							if (!exists(out.parent_path()))
-								create_directories(out.parent_path());
-							if (settingData.ExportProcessor == Processor::GPU)
-								ProcessFileGpu(D3D11CSDev.Get(), D3D11CSDevCtx.Get(),
-											   Image::ImageFile(in), toolList, false)
-									.Save(out);
-							else
-								ProcessFile(Image::ImageFile(in), toolList, false).Save(out);
+							try
+							{
+								ProcBatch(tk);
+							}
+							catch (const std::exception &ex)
+							{
+								LogErr("[ProcThread] batch error:\n{}",
+									   LogMsg::LogException(ex));
+							}
 						}
-						catch (const std::exception &ex)
+						else
 						{
-							LogErr("[ProcThread] processor error:\n{}",
-								   LogMsg::LogException(ex));
+							ProcLocal();
 						}
-
-						++processedCount;
-						procFiles.pop();
 					}
+					procFiles.reset();
+					procJournals.Clear();
 					curFile.Set(NormU8(Text::Finished()));
 					totalCount = 0;
 					procStatus = 0.f;
@@ -784,6 +985,45 @@ private:
 
 				ProcThread = std::jthread(ProcHandle);
 			},
+			[&](StartWatchEvent &)
+			{
+				auto paths = ParsePathFromPaths(inputPath.GetView());
+				CheckOutputPath(paths);
+				std::erase_if(paths, [](const auto &p)
+							  { return !is_directory(p); });
+				if (paths.empty())
+				{
+					GUI::ShowError(String::ToWString(Text::WatchNeedsDirectory()));
+					return;
+				}
+
+				SetupProcOutput(paths);
+				procOptions = MakeExportOptions(settingData.ExportProcessor);
+
+				IsProcessing = true;
+				processedCount.store(0);
+				totalCount.store(0);
+
+				ProcThread = std::jthread(
+					[&, paths](const std::stop_token &tk)
+					{
+						try
+						{
+							ProcWatch(tk, paths);
+						}
+						catch (const std::exception &ex)
+						{
+							LogErr("[ProcThread] watch error:\n{}",
+								   LogMsg::LogException(ex));
+						}
+						procJournals.Clear();
+						curFile.Set(NormU8(Text::Finished()));
+						totalCount = 0;
+						procStatus = 0.f;
+						IsProcessing = false;
+						Events.Emit(EndProcessEvent{});
+					});
+			},
 			[&](EndProcessEvent &)
 			{
 				ProcThread.join();
@@ -885,6 +1125,10 @@ private:
 				needUpdate = true;
 				wantToSaveSetting = true;
 			}
+			const auto previewFmt = settingData.PreviewSize == 0 ? Text::FullSize() : "%d";
+			wantToSaveSetting |= ImGui::SliderInt(Text::PreviewSize(), &settingData.PreviewSize, 0, 8192, previewFmt);
+			if (ImGui::IsItemHovered())
+				ImGui::SetTooltip("%s", Text::PreviewSizeTip());
 
 			ImGui::Separator();
 			ImGui::Text("%s", Text::ProcessorExport());
@@ -901,6 +1145,18 @@ private:
 			if (ImGui::IsItemEdited())
 				wantToSaveSetting = true;
 
+			ImGui::BeginDisabled(IsProcessing);
+			{
+				wantToSaveSetting |= ImGui::SliderInt(Text::WorkerProcesses(), &settingData.Processes, 1,
+													  std::max(1, static_cast<int>(std::thread::hardware_concurrency())));
+				if (ImGui::IsItemHovered())
+					ImGui::SetTooltip("%s", Text::WorkerProcessesTip());
+				ImGui::BeginDisabled(settingData.Processes <= 1);
+				wantToSaveSetting |= GUI::EnumCombo(Text::WorkerScheduling(), settingData.ExportBatchMode);
+				ImGui::EndDisabled();
+			}
+			ImGui::EndDisabled();
+
 			if (ImGui::Button(Text::ResetSettings()))
 			{
 				settingData = {};
@@ -1028,7 +1284,7 @@ private:
 	}
 
 	template <typename T>
-	void LoadPresetImplIdMatcherImplMatch(std::vector<ToolType> &list, const std::string_view &id, bool &update)
+	static void LoadPresetImplIdMatcherImplMatch(std::vector<ToolType> &list, const std::string_view &id, bool &update)
 	{
 		if (!update && id == T::Id())
 		{
@@ -1038,7 +1294,7 @@ private:
 	}
 
 	template <typename... Args>
-	void LoadPresetImplIdMatcher(std::vector<ToolType> &list, const std::string_view &id)
+	static void LoadPresetImplIdMatcher(std::vector<ToolType> &list, const std::string_view &id)
 	{
 		bool updated = false;
 		(LoadPresetImplIdMatcherImplMatch<Args>(list, id, updated), ...);
@@ -1136,14 +1392,6 @@ private:
 		}
 	}
 
-	static bool IsImage(const std::filesystem::path &file)
-	{
-		static std::unordered_set<std::string> extensions{
-			".jpg", ".jpeg", ".jpe", ".png", ".tga", ".bmp",
-			".psd", ".gif", ".hdr", ".pic", ".ppm", ".pgm"};
-		return extensions.contains(String::ToLower(file.extension().u8string()));
-	}
-
 	//void SetInputPath(const std::filesystem::path &buf)
 	//{
 	//	SetInputPathImpl(ParsePathFromPaths(buf.u8string()));
@@ -1190,13 +1438,43 @@ private:
 
 		std::ranges::sort(files);
 
+		std::vector<std::filesystem::path> images{};
 		for (const auto &file : files)
 		{
 			if (IsImage(file))
+				images.push_back(file);
+			else
+				LogWarn("ignore: {}", file);
+		}
+
+		// previews are decoded a batch at a time in parallel, textures are made in order
+		const auto batch = std::max<size_t>(1, std::thread::hardware_concurrency());
+		for (size_t begin = 0; begin < images.size(); begin += batch)
+		{
+			const auto end = std::min(images.size(), begin + batch);
+			std::vector<Image::ImageFile> decoded(end - begin);
+			std::vector<std::string> errors(end - begin);
+			std::vector<size_t> ids(end - begin);
+			std::iota(ids.begin(), ids.end(), size_t{0});
+			std::for_each(std::execution::par, ids.begin(), ids.end(), [&](const size_t i)
+						  {
+							  try
+							  {
+								  decoded[i] = LoadImagePreview(images[begin + i], settingData.PreviewSize);
+							  }
+							  catch (const std::exception &ex)
+							  {
+								  errors[i] = ex.what();
+							  } });
+
+			for (size_t i = 0; i < decoded.size(); ++i)
 			{
+				const auto &file = images[begin + i];
 				try
 				{
-					rawTextures.emplace_back(file, D3D11::LoadTextureFromFile(D3D11Dev.Get(), Image::ImageFile(file)));
+					if (!errors[i].empty())
+						throw std::runtime_error(errors[i]);
+					rawTextures.emplace_back(file, D3D11::LoadTextureFromFile(D3D11Dev.Get(), decoded[i]));
 				}
 				catch (const std::exception &ex)
 				{
@@ -1204,10 +1482,6 @@ private:
 					GUI::ShowError(String::FormatW("{}: {}", file, ex.what()), mainWnd);
 				}
 			}
-			else
-			{
-				LogWarn("ignore: {}", file);
-			}
 		}
 
 		if (!rawTextures.empty())
@@ -1245,13 +1519,55 @@ private:
 		{
 			ImGui::Text("%s", curFile.Buf.c_str());
 			if (totalCount)
-				procStatus = static_cast<float>(processedCount.load()) / static_cast<float>(totalCount);
+				procStatus = static_cast<float>(processedCount.load()) / static_cast<float>(totalCount.load());
 			ImGui::ProgressBar(procStatus);
 
 			ImGui::BeginDisabled(IsProcessing);
 			{
 				if (GUI::EnumCombo(Text::Format(), imgFormat))
 					ReSetOutputPathExtension();
+				if (imgFormat == ImageFormat::png)
+				{
+					auto &png = settingData.Encode.Png;
+					if (auto level = static_cast<_Png_Level>(png.Level); GUI::EnumCombo(Text::Compression(), level))
+					{
+						png.Level = static_cast<Png::Level>(level);
+						Events.Emit(SaveSettingEvent{});
+					}
+				}
+				if (imgFormat == ImageFormat::jpg)
+				{
+					auto &jpeg = settingData.Encode.Jpeg;
+					if (ImGui::SliderInt(Text::Quality(), &jpeg.Quality, 1, 100))
+						Events.Emit(SaveSettingEvent{});
+					if (auto subsampling = static_cast<_Jpeg_Subsampling>(jpeg.Subsampling); GUI::EnumCombo(Text::Subsampling(), subsampling))
+					{
+						jpeg.Subsampling = static_cast<Jpeg::Subsampling>(subsampling);
+						Events.Emit(SaveSettingEvent{});
+					}
+				}
+				if (imgFormat == ImageFormat::dds)
+				{
+					auto &dds = settingData.Encode.Dds;
+					if (auto format = static_cast<_Dds_Format>(dds.Format); GUI::EnumCombo(Text::Compression(), format))
+					{
+						dds.Format = static_cast<Dds::Format>(format);
+						Events.Emit(SaveSettingEvent{});
+					}
+					if (auto quality = static_cast<_Dds_Quality>(dds.Quality); GUI::EnumCombo(Text::Quality(), quality))
+					{
+						dds.Quality = static_cast<Dds::Quality>(quality);
+						Events.Emit(SaveSettingEvent{});
+					}
+					if (ImGui::Checkbox(Text::Mipmap(), &dds.Mipmaps))
+						Events.Emit(SaveSettingEvent{});
+				}
+				if (ImGui::Checkbox(Text::ResumeExport(), &settingData.ResumeExport))
+					Events.Emit(SaveSettingEvent{});
+				if (ImGui::Checkbox(Text::IncrementalExport(), &settingData.IncrementalExport))
+					Events.Emit(SaveSettingEvent{});
+				if (ImGui::IsItemHovered())
+					ImGui::SetTooltip("%s", Text::IncrementalExportTip());
 			}
 			ImGui::EndDisabled();
 
@@ -1259,6 +1575,14 @@ private:
 			{
 				Events.Emit(StartProcessEvent{});
 			}
+			if (!IsProcessing)
+			{
+				ImGui::SameLine();
+				if (ImGui::Button(Text::Watch()))
+					Events.Emit(StartWatchEvent{});
+				if (ImGui::IsItemHovered())
+					ImGui::SetTooltip("%s", Text::WatchTip());
+			}
 
 			if (IsProcessing && ImGui::Button(Text::Cancel()))
 				ProcThread.request_stop();
@@ -1350,24 +1674,27 @@ private:
 	MakeStr(value);
 	MakeStr(ver);
 
-	void LoadPreset(const std::filesystem::path &path)
+	static std::vector<ToolType> ParsePreset(const nlohmann::json &data)
 	{
-		try
+		std::vector<ToolType> list;
+		for (const auto &tool : data[String_data])
 		{
-			const auto data = nlohmann::json::parse(File::ReadAll(path));
-			const auto &tools = data[String_data];
+			const auto id = tool[String_id].get<std::string>();
+			const auto &val = tool[String_value];
 
-			std::vector<ToolType> list;
-			for (const auto &tool : tools)
-			{
-				const auto id = tool[String_id].get<std::string>();
-				const auto &val = tool[String_value];
+			LoadPresetImplIdMatcher<ItToolList>(list, id);
+			std::visit([&](auto &x)
+					   { x.LoadData(val); },
+					   *list.rbegin());
+		}
+		return list;
+	}
 
-				LoadPresetImplIdMatcher<ItToolList>(list, id);
-				std::visit([&](auto &x)
-						   { x.LoadData(val); },
-						   *list.rbegin());
-			}
+	void LoadPreset(const std::filesystem::path &path)
+	{
+		try
+		{
+			const auto list = ParsePreset(nlohmann::json::parse(File::ReadAll(path)));
 
 			toolList.clear();
 			toolList.shrink_to_fit();
@@ -1381,7 +1708,7 @@ private:
 		}
 	}
 
-	void SavePreset(const std::filesystem::path &path) const
+	nlohmann::json PresetJson() const
 	{
 		std::vector<nlohmann::json> tools{};
 		for (const auto &i : toolList)
@@ -1395,9 +1722,22 @@ private:
 					   i);
 			tools.push_back(tool);
 		}
-		File::WriteAll(
-			path,
-			nlohmann::json::object({{String_ver, version}, {String_data, tools}}).dump(4));
+		return nlohmann::json::object({{String_ver, version}, {String_data, tools}});
+	}
+
+	// identifies everything that affects export output, used to invalidate resume records
+	uint64_t PresetHash(const Processor processor) const
+	{
+		auto preset = PresetJson();
+		preset["format"] = ToImString(GetExtension());
+		preset["processor"] = static_cast<int>(processor);
+		preset["encode"] = settingData.Encode;
+		return XXHash64::Hash(preset.dump());
+	}
+
+	void SavePreset(const std::filesystem::path &path) const
+	{
+		File::WriteAll(path, PresetJson().dump(4));
 	}
 
 	void ShowTopMenuImplFile()
@@ -1638,6 +1978,34 @@ no help!)");
 public:
 	ImgTools() { Init(); }
 
+	// Headless export worker spawned by ProcBatch, CPU processors only.
+	static int RunWorker(const WorkerArgs &args)
+	{
+		const BatchQueue queue(args.JobDir);
+		const auto job = queue.ReadJob();
+		auto tools = ParsePreset(job.Preset);
+
+		ExportJournalSet journals{};
+		std::optional<std::vector<ProcessorType>> prepared{};
+		queue.Work(args.Shard, [&](const BatchQueue::Item &item)
+				   {
+					   ExportItem(job.Options, journals, FromImString(item.Input), FromImString(item.Output),
+								  [&](const Image::ImageFile &img)
+								  {
+									  if (!prepared)
+										  prepared = PrepareProcessors(tools, false);
+									  return ProcessFile(img, *prepared);
+								  },
+								  [&](const Image::PixelFormat &format)
+								  {
+									  if (!prepared)
+										  prepared = PrepareProcessors(tools, false);
+									  return AcceptsInput(*prepared, format);
+								  });
+				   });
+		return EXIT_SUCCESS;
+	}
+
 	void Run()
 	{
 		//decltype(std::chrono::high_resolution_clock::now()) lastFrameTime{};
@@ -1690,6 +2058,23 @@ int WINAPI WinMain(
 	_In_ LPSTR lpCmdLine,
 	_In_ int nShowCmd)
 {
+	if (const auto worker = WorkerArgs::FromCommandLine())
+	{
+		std::thread logThread(LogHandle);
+		int ret = EXIT_FAILURE;
+		try
+		{
+			ret = ImgTools::RunWorker(*worker);
+		}
+		catch (const std::exception &e)
+		{
+			LogErr("Worker error:\n{}", LogMsg::LogException(e));
+		}
+		LogNone("Worker exit.");
+		logThread.join();
+		return ret;
+	}
+
 	if (!AppInstance.Ok())
 	{
 		GUI::ShowError(L"Already running.", nullptr);
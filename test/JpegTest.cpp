@@ -0,0 +1,138 @@
+// Malformed input must make Jpeg::DecodeReduced throw, never read or write out of bounds.
+// Build with -DIMG_BUILD_TESTS=ON and run through ctest.
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include "Jpeg.hpp"
+
+namespace
+{
+    int failures = 0;
+
+    void Check(const bool ok, const char *what)
+    {
+        if (!ok)
+        {
+            std::fprintf(stderr, "FAILED: %s\n", what);
+            ++failures;
+        }
+    }
+
+    void Segment(std::vector<uint8_t> &out, const uint8_t marker, const std::vector<uint8_t> &body)
+    {
+        const auto len = body.size() + 2;
+        out.insert(out.end(), {0xff, marker, static_cast<uint8_t>(len >> 8), static_cast<uint8_t>(len)});
+        out.insert(out.end(), body.begin(), body.end());
+    }
+
+    // 16x16 gray baseline frame and scan around the given DHT body
+    std::vector<uint8_t> Gray(const std::vector<uint8_t> &dht)
+    {
+        std::vector<uint8_t> out{0xff, 0xd8};
+        std::vector<uint8_t> dqt{0x00};
+        dqt.resize(65, 1);
+        Segment(out, 0xdb, dqt);
+        Segment(out, 0xc4, dht);
+        Segment(out, 0xc0, {8, 0, 16, 0, 16, 1, 1, 0x11, 0});
+        Segment(out, 0xda, {1, 1, 0x00, 0, 63, 0});
+        out.insert(out.end(), 64, 0x00);
+        out.insert(out.end(), {0xff, 0xd9});
+        return out;
+    }
+
+    template <typename Fn>
+    bool Throws(Fn &&fn)
+    {
+        try
+        {
+            fn();
+        }
+        catch (const Jpeg::Exception &)
+        {
+            return true;
+        }
+        return false;
+    }
+
+    void OverfullHuffmanTable()
+    {
+        // 200 codes of length 1, the fast table of a decoder trusting it overflows
+        std::vector<uint8_t> dht{0x00, 200};
+        dht.resize(17, 0);
+        dht.resize(17 + 200, 0);
+        const auto file = Gray(dht);
+
+        const auto info = Jpeg::Probe(file.data(), file.size());
+        Check(info && info->Reducible, "probe finds the frame");
+        std::vector<uint8_t> rgba(16 * 16 * 4);
+        Check(Throws([&]
+                     { Jpeg::DecodeReduced(file.data(), file.size(), 2, rgba.data()); }),
+              "overfull DHT throws");
+
+        // two codes of length 1 leave no all ones code, jdhuff rejects that too
+        std::vector<uint8_t> full{0x00, 2};
+        full.resize(17 + 2, 0);
+        const auto full2 = Gray(full);
+        Check(Throws([&]
+                     { Jpeg::DecodeReduced(full2.data(), full2.size(), 2, rgba.data()); }),
+              "complete length 1 DHT throws");
+    }
+
+    void TruncatedHeaders()
+    {
+        std::vector<uint8_t> dht{0x00, 0, 1};
+        dht.resize(17 + 1, 0);
+        std::vector<uint8_t> rgba(16 * 16 * 4);
+
+        // a frame segment too short for its component count, at the end of the data
+        auto frame = Gray(dht);
+        const auto sof = std::ranges::search(frame, std::vector<uint8_t>{0xff, 0xc0}).begin() - frame.begin();
+        frame[sof + 3] = 2;
+        Check(Throws([&]
+                     { Jpeg::DecodeReduced(frame.data(), frame.size(), 2, rgba.data()); }),
+              "short frame header throws");
+
+        auto scan = Gray(dht);
+        const auto sos = std::ranges::search(scan, std::vector<uint8_t>{0xff, 0xda}).begin() - scan.begin();
+        scan.resize(sos + 4);
+        scan[sos + 3] = 2;
+        Check(Throws([&]
+                     { Jpeg::DecodeReduced(scan.data(), scan.size(), 2, rgba.data()); }),
+              "short scan header throws");
+    }
+
+    void RoundTrip()
+    {
+        constexpr int w = 37, h = 21;
+        std::vector<uint8_t> rgba(w * h * 4);
+        for (size_t i = 0; i < rgba.size(); ++i)
+            rgba[i] = static_cast<uint8_t>(i % 4 == 3 ? 255 : i * 7);
+        const auto path = std::filesystem::temp_directory_path() / "ImgToolsJpegTest.jpg";
+        Jpeg::Save(path, rgba.data(), w, h, {});
+
+        std::ifstream fs(path, std::ios::in | std::ios::binary);
+        const std::vector<uint8_t> file{std::istreambuf_iterator<char>(fs), {}};
+        fs.close();
+        std::filesystem::remove(path);
+
+        std::vector<uint8_t> out(static_cast<size_t>(Jpeg::ReducedExtent(w, 2)) * Jpeg::ReducedExtent(h, 2) * 4);
+        Check(!Throws([&]
+                      { Jpeg::DecodeReduced(file.data(), file.size(), 2, out.data()); }),
+              "own output decodes");
+    }
+}
+
+int main()
+{
+    OverfullHuffmanTable();
+    TruncatedHeaders();
+    RoundTrip();
+    if (failures == 0)
+        std::puts("ok");
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}